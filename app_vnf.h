@@ -27,16 +27,42 @@
 
 #include <stdint.h>
 
+#define APP_VNF_MAX_STAGES (8) /* Stages chained by the RX pipeline at most */
+
 /* Holder for the packed info */
 struct simple_fwd_pkt_info;
 
+/* Holder for the packets */
+struct rte_mbuf;
+
+/*
+ * Burst oriented stage of the RX pipeline. A stage gets the packets the previous one kept, along with
+ * their info, and returns how many it keeps for the next one, moved to the front of both arrays. It
+ * freed or sent the others itself.
+ */
+struct app_vnf_stage {
+	const char *name; /* Name of the stage, as reported */
+	int (*stage_init)(uint32_t lcore_id, uint16_t queue_id, void **ctx); /* A function pointer for creating the
+										 state of the stage on an RX lcore,
+										 NULL for stateless stages */
+	void (*stage_fini)(void *ctx); /* A function pointer for destroying the state of the stage, may be NULL */
+	uint16_t (*process_burst)(void *ctx,
+				  struct rte_mbuf **mbufs,
+				  struct simple_fwd_pkt_info *pinfos,
+				  uint16_t nb_pkts); /* A function pointer for processing a burst of packets */
+};
+
 /* Holder for all functions pointers needed */
 struct app_vnf {
 	int (*vnf_init)(void *p); /* A function pointer for initializing all application resources */
-	int (*vnf_process_pkt)(struct simple_fwd_pkt_info *pinfo); /* A function pointer for processing the packets */
+	uint16_t (*vnf_get_stages)(const struct app_vnf_stage **stages); /* A function pointer for getting the stages
+									    the application adds to the RX
+									    pipeline, once classified */
 	void (*vnf_flow_age)(uint32_t port_id, uint16_t queue);	   /* A function pointer for the aging handling */
 	int (*vnf_dump_stats)(uint32_t port_id);		   /* A function pointer for dumping the stats */
 	int (*vnf_destroy)(void); /* A function pointer for destroying all allocated application resources */
+	int (*vnf_set_rss)(uint16_t port_id, const uint16_t *queues, uint16_t nb_queues); /* A function pointer for
+											      updating the RSS queues */
 };
 
 #endif /* APP_VNF_H_ */
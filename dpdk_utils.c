@@ -26,6 +26,7 @@
 #include <rte_ethdev.h>
 #include <rte_ether.h>
 #include <rte_malloc.h>
+#include <rte_mbuf_dyn.h>
 
 #include <doca_log.h>
 #include <doca_mmap.h>
@@ -314,6 +315,14 @@ static doca_error_t port_init(struct rte_mempool *mbuf_pool, uint8_t port, struc
 
     port_conf.rxmode.mq_mode = rss_support ? RTE_ETH_MQ_RX_RSS : RTE_ETH_MQ_RX_NONE;
 
+    /* Stamp the received packets when the application registered the timestamp field */
+    if (rte_mbuf_dynflag_lookup(RTE_MBUF_DYNFLAG_RX_TIMESTAMP_NAME, NULL) >= 0) {
+        if (dev_info.rx_offload_capa & RTE_ETH_RX_OFFLOAD_TIMESTAMP)
+            port_conf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_TIMESTAMP;
+        else
+            DOCA_LOG_INFO("Port %u does not support RX timestamps", port);
+    }
+
     /* Configure the Ethernet device */
     ret = rte_eth_dev_configure(port, rx_rings + nb_hairpin_queues, tx_rings + nb_hairpin_queues, &port_conf);
     if (ret < 0) {
@@ -22,6 +22,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  */
+#include <errno.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,6 +30,8 @@
 #include <arpa/inet.h>
 
 #include <rte_random.h>
+#include <rte_tcp.h>
+#include <rte_telemetry.h>
 
 #include <doca_flow.h>
 #include <doca_log.h>
@@ -37,6 +40,7 @@
 #include "app_vnf.h"
 #include "simple_fwd.h"
 #include "simple_fwd_ft.h"
+#include "simple_fwd_rss.h"
 #include "utils.h"
 
 DOCA_LOG_REGISTER(SIMPLE_FWD);
@@ -73,6 +77,9 @@ DOCA_LOG_REGISTER(SIMPLE_FWD);
 #define PULL_TIME_OUT 10000 /* Maximum timeout for pulling */
 #define NB_ACTION_ARRAY (1) /* Used as the size of muti-actions array for DOCA Flow API */
 #define NB_ACTION_DESC (1)  /* Used as the size of muti-action descs array for DOCA Flow API */
+#define NB_GRE_ACTION_ARRAY (2) /* GRE pipe actions, L3 decap for IPv4 payload and L2 decap for NVGRE/TEB */
+#define GRE_ACTION_IDX_L2 (1)	/* Index of the L2 decap actions in the GRE pipe */
+#define SW_ENTRY_AGE_SEC (2) /* Aging time of software only entries, that HW pipes cannot match */
 
 static struct simple_fwd_app *simple_fwd_ins; /* Instance holding all allocated resources needed for a proper run */
 
@@ -143,7 +150,8 @@ static int simple_fwd_init_doca_flow(int nb_queues, const char *mode, uint32_t n
 		return -1;
 	}
 
-	result = doca_flow_cfg_set_pipe_queues(flow_cfg, nb_queues);
+	/* one more queue for the control updates, the RX queues ones are used by the RX lcores */
+	result = doca_flow_cfg_set_pipe_queues(flow_cfg, nb_queues + 1);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to set doca_flow_cfg pipe_queues: %s", doca_error_get_descr(result));
 		goto destroy_cfg;
@@ -313,6 +321,7 @@ static void simple_fwd_aged_flow_cb(struct simple_fwd_ft_user_ctx *ctx)
 	if (entry->is_hw) {
 		doca_flow_pipe_remove_entry(entry->pipe_queue, DOCA_FLOW_NO_WAIT, entry->hw_entry);
 		entry->hw_entry = NULL;
+		__atomic_add_fetch(&simple_fwd_ins->offload_stats.removed, 1, __ATOMIC_RELAXED);
 	}
 }
 
@@ -403,7 +412,7 @@ static int simple_fwd_build_rss_flow(uint16_t port_id)
 		((struct simple_fwd_port_cfg *)doca_flow_port_priv_data(simple_fwd_ins->ports[port_id]));
 	struct entries_status *status;
 
-	uint16_t rss_queues[port_cfg->nb_queues];
+	uint16_t rss_queues[SIMPLE_FWD_RSS_RETA_SIZE];
 	int num_of_entries = 1;
 	int i;
 	doca_error_t result;
@@ -441,15 +450,12 @@ static int simple_fwd_build_rss_flow(uint16_t port_id)
 		goto destroy_pipe_cfg;
 	}
 
-	for (i = 0; i < port_cfg->nb_queues; i++)
-		rss_queues[i] = i;
+	/* an indirection table rather than the queues list, the rebalancer moves its buckets */
+	for (i = 0; i < SIMPLE_FWD_RSS_RETA_SIZE; i++)
+		rss_queues[i] = i % port_cfg->nb_queues;
 
-
-	fwd.type = DOCA_FLOW_FWD_RSS;
-	fwd.rss_type = DOCA_FLOW_RESOURCE_TYPE_NON_SHARED;
-	fwd.rss.outer_flags = DOCA_FLOW_RSS_IPV4 | DOCA_FLOW_RSS_UDP;
-	fwd.rss.nr_queues = port_cfg->nb_queues;
-	fwd.rss.queues_array = rss_queues;
+	/* the queues are set per entry, so that they can be updated */
+	fwd.type = DOCA_FLOW_FWD_CHANGEABLE;
 
 	status = (struct entries_status *)calloc(1, sizeof(struct entries_status));
 
@@ -461,6 +467,12 @@ static int simple_fwd_build_rss_flow(uint16_t port_id)
 
 	doca_flow_pipe_cfg_destroy(pipe_cfg);
 
+	fwd.type = DOCA_FLOW_FWD_RSS;
+	fwd.rss_type = DOCA_FLOW_RESOURCE_TYPE_NON_SHARED;
+	fwd.rss.outer_flags = DOCA_FLOW_RSS_IPV4 | DOCA_FLOW_RSS_UDP;
+	fwd.rss.nr_queues = SIMPLE_FWD_RSS_RETA_SIZE;
+	fwd.rss.queues_array = rss_queues;
+
 	result = doca_flow_pipe_add_entry(0,
 					  simple_fwd_ins->pipe_rss[port_cfg->port_id],
 					  &match,
@@ -481,6 +493,8 @@ static int simple_fwd_build_rss_flow(uint16_t port_id)
 	if (status->nb_processed != num_of_entries || status->failure)
 		return -1;
 
+	simple_fwd_ins->rss_entry[port_cfg->port_id] = entry;
+	simple_fwd_ins->rss_status[port_cfg->port_id] = status;
 	return 0;
 
 destroy_pipe_cfg:
@@ -639,7 +653,7 @@ static void simple_fwd_build_pipe_common_match_fields(struct doca_flow_match *ma
 static int simple_fwd_create_match_pipe(struct simple_fwd_port_cfg *port_cfg, enum doca_flow_tun_type type)
 {
 	struct doca_flow_match match;
-	struct doca_flow_actions actions, *actions_arr[NB_ACTION_ARRAY];
+	struct doca_flow_actions actions, l2_actions, *actions_arr[NB_GRE_ACTION_ARRAY];
 	struct doca_flow_action_descs descs;
 	struct doca_flow_monitor monitor;
 	struct doca_flow_fwd fwd;
@@ -647,10 +661,12 @@ static int simple_fwd_create_match_pipe(struct simple_fwd_port_cfg *port_cfg, en
 	struct doca_flow_pipe_cfg *pipe_cfg;
 	struct doca_flow_pipe **pipe;
 	const char *pipe_name;
+	int nb_actions = NB_ACTION_ARRAY;
 	doca_error_t result;
 
 	memset(&match, 0, sizeof(match));
 	memset(&actions, 0, sizeof(actions));
+	memset(&l2_actions, 0, sizeof(l2_actions));
 	memset(&descs, 0, sizeof(descs));
 	memset(&monitor, 0, sizeof(monitor));
 	memset(&fwd, 0, sizeof(fwd));
@@ -689,6 +705,7 @@ static int simple_fwd_create_match_pipe(struct simple_fwd_port_cfg *port_cfg, en
 		break;
 	case DOCA_FLOW_TUN_GRE:
 		pipe_name = "GRE_PIPE";
+		/* key presence is changeable, so keyed and unkeyed GRE share the pipe */
 		match.tun.gre_key = UINT32_MAX;
 		match.tun.key_present = true;
 		actions.decap_type = DOCA_FLOW_RESOURCE_TYPE_NON_SHARED;
@@ -698,6 +715,12 @@ static int simple_fwd_create_match_pipe(struct simple_fwd_port_cfg *port_cfg, en
 		actions.outer.eth.type = rte_cpu_to_be_16(DOCA_FLOW_ETHER_TYPE_IPV4);
 		actions.outer.l3_type = DOCA_FLOW_L3_TYPE_IP4;
 		actions.meta.pkt_meta = DOCA_HTOBE32(1);
+		/* NVGRE and TEB carry a full frame, only the outer headers are removed */
+		l2_actions.decap_type = DOCA_FLOW_RESOURCE_TYPE_NON_SHARED;
+		l2_actions.decap_cfg.is_l2 = true;
+		l2_actions.meta.pkt_meta = DOCA_HTOBE32(1);
+		actions_arr[GRE_ACTION_IDX_L2] = &l2_actions;
+		nb_actions = NB_GRE_ACTION_ARRAY;
 		pipe = &simple_fwd_ins->pipe_gre[port_cfg->port_id];
 		break;
 	default:
@@ -734,7 +757,7 @@ static int simple_fwd_create_match_pipe(struct simple_fwd_port_cfg *port_cfg, en
 		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg match: %s", doca_error_get_descr(result));
 		goto destroy_pipe_cfg;
 	}
-	result = doca_flow_pipe_cfg_set_actions(pipe_cfg, actions_arr, NULL, NULL, NB_ACTION_ARRAY);
+	result = doca_flow_pipe_cfg_set_actions(pipe_cfg, actions_arr, NULL, NULL, nb_actions);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg actions: %s", doca_error_get_descr(result));
 		goto destroy_pipe_cfg;
@@ -808,22 +831,26 @@ destroy_pipe_cfg:
 
 /*
  * Add DOCA Flow pipe entries to the control pipe:
- * - entry with VXLAN match that forward the matched packet to VxLAN pipe
+ * - entry with UDP match that forward the matched packet to the RSS pipe
+ * - entry with TCP destination port 8888 match that forward the matched packet to the hairpin pipe
+ * - entries with GRE inner TCP FIN or RST match that forward the matched packet to the RSS pipe
  * - entry with GRE match that forward the matched packet to GRE pipe
- * - entry with GTP match that forward the matched packet to GTP pipe
+ * - entry matching the rest of the traffic that forward the matched packet to the hairpin pipe
  *
  * @port_cfg [in]: port configuration as provided by the user
  * @return: 0 on success, negative value otherwise and error is set.
  */
 static int simple_fwd_add_control_pipe_entries(struct simple_fwd_port_cfg *port_cfg)
 {
-	struct doca_flow_match match;
+	struct doca_flow_match match, match_mask;
 	struct doca_flow_fwd fwd;
 	struct doca_flow_pipe_entry *entry;
 	struct entries_status *status;
 	doca_error_t result;
+	uint8_t close_flags[] = {RTE_TCP_FIN_FLAG, RTE_TCP_RST_FLAG};
 	uint8_t priority = 0;
-	int nb_entries = 3;
+	int nb_entries = 6;
+	int i;
 
 	status = (struct entries_status *)calloc(1, sizeof(struct entries_status));
 	if (unlikely(status == NULL))
@@ -888,12 +915,80 @@ static int simple_fwd_add_control_pipe_entries(struct simple_fwd_port_cfg *port_
     }
 
 
-    //其他数据包走hairpin
+	/*
+	 * FIN and RST of offloaded GRE flows go to software, so that the flow leaves HW as soon as
+	 * the connection is closed instead of waiting for HW aging
+	 */
+	for (i = 0; i < (int)RTE_DIM(close_flags); i++) {
+		memset(&match, 0, sizeof(match));
+		memset(&match_mask, 0, sizeof(match_mask));
+		memset(&fwd, 0, sizeof(fwd));
+
+		match.parser_meta.outer_l3_type = DOCA_FLOW_L3_META_IPV4;
+		match.outer.l3_type = DOCA_FLOW_L3_TYPE_IP4;
+		match.tun.type = DOCA_FLOW_TUN_GRE;
+		match.inner.l3_type = DOCA_FLOW_L3_TYPE_IP4;
+		match.inner.l4_type_ext = DOCA_FLOW_L4_TYPE_EXT_TCP;
+		match.inner.tcp.flags = close_flags[i];
+		match_mask = match;
+
+		fwd.type = DOCA_FLOW_FWD_PIPE;
+		fwd.next_pipe = simple_fwd_ins->pipe_rss[port_cfg->port_id];
+		result = doca_flow_pipe_control_add_entry(0,
+							  priority,
+							  simple_fwd_ins->pipe_control[port_cfg->port_id],
+							  &match,
+							  &match_mask,
+							  NULL,
+							  NULL,
+							  NULL,
+							  NULL,
+							  NULL,
+							  &fwd,
+							  status,
+							  &entry);
+		if (result != DOCA_SUCCESS) {
+			free(status);
+			return -1;
+		}
+	}
 
+	/* GRE, NVGRE and ERSPAN are decapsulated and forwarded by the GRE pipe */
 	memset(&match, 0, sizeof(match));
 	memset(&fwd, 0, sizeof(fwd));
 
 	priority = 1;
+
+	match.parser_meta.outer_l3_type = DOCA_FLOW_L3_META_IPV4;
+	match.outer.l3_type = DOCA_FLOW_L3_TYPE_IP4;
+	match.tun.type = DOCA_FLOW_TUN_GRE;
+
+	fwd.type = DOCA_FLOW_FWD_PIPE;
+	fwd.next_pipe = simple_fwd_ins->pipe_gre[port_cfg->port_id];
+	result = doca_flow_pipe_control_add_entry(0,
+						  priority,
+						  simple_fwd_ins->pipe_control[port_cfg->port_id],
+						  &match,
+						  NULL,
+						  NULL,
+						  NULL,
+						  NULL,
+						  NULL,
+						  NULL,
+						  &fwd,
+						  status,
+						  &entry);
+	if (result != DOCA_SUCCESS) {
+		free(status);
+		return -1;
+	}
+
+    //其他数据包走hairpin
+
+	memset(&match, 0, sizeof(match));
+	memset(&fwd, 0, sizeof(fwd));
+
+	priority = 2;
 	fwd.type = DOCA_FLOW_FWD_PIPE;
 
     fwd.next_pipe = simple_fwd_ins->pipe_hairpin[port_cfg->port_id];
@@ -1134,6 +1229,12 @@ static int simple_fwd_init_ports_and_pipes(struct simple_fwd_port_cfg *port_cfg)
 			DOCA_LOG_ERR("Failed building RSS flow");
 			return -1;
 		}
+		result = simple_fwd_create_match_pipe(curr_port_cfg, DOCA_FLOW_TUN_GRE);
+		if (result < 0) {
+			DOCA_LOG_ERR("Failed building GRE pipe");
+			return -1;
+		}
+
 		result = simple_fwd_create_control_pipe(curr_port_cfg);
 		if (result < 0) {
 			DOCA_LOG_ERR("Failed building control pipe");
@@ -1153,6 +1254,42 @@ static int simple_fwd_init_ports_and_pipes(struct simple_fwd_port_cfg *port_cfg)
 	return 0;
 }
 
+/*
+ * Telemetry callback exporting the flow table and HW offload stats, runs on the telemetry thread
+ *
+ * @cmd [in]: telemetry command, unused
+ * @params [in]: command parameters, unused
+ * @d [out]: telemetry reply
+ * @return: 0 on success and negative value otherwise
+ */
+static int simple_fwd_telemetry_flows(const char *cmd __rte_unused,
+				      const char *params __rte_unused,
+				      struct rte_tel_data *d)
+{
+	struct simple_fwd_offload_stats *offload;
+	struct simple_fwd_ft_stats ft_stats;
+	uint64_t offloaded, removed;
+
+	if (simple_fwd_ins == NULL)
+		return -ENODEV;
+	offload = &simple_fwd_ins->offload_stats;
+	simple_fwd_ft_get_stats(simple_fwd_ins->ft, &ft_stats);
+	offloaded = __atomic_load_n(&offload->offloaded, __ATOMIC_RELAXED);
+	removed = __atomic_load_n(&offload->removed, __ATOMIC_RELAXED);
+
+	/* the counters are read one by one while lcores update them, a removal may be seen before its insertion */
+	rte_tel_data_start_dict(d);
+	rte_tel_data_add_dict_uint(d, "flows", ft_stats.add > ft_stats.rm ? ft_stats.add - ft_stats.rm : 0);
+	rte_tel_data_add_dict_uint(d, "flows_added", ft_stats.add);
+	rte_tel_data_add_dict_uint(d, "flows_removed", ft_stats.rm);
+	rte_tel_data_add_dict_uint(d, "half_open", ft_stats.half_open);
+	rte_tel_data_add_dict_uint(d, "hw_flows", offloaded > removed ? offloaded - removed : 0);
+	rte_tel_data_add_dict_uint(d, "hw_offloaded", offloaded);
+	rte_tel_data_add_dict_uint(d, "hw_removed", removed);
+	rte_tel_data_add_dict_uint(d, "hw_failed", __atomic_load_n(&offload->failed, __ATOMIC_RELAXED));
+	return 0;
+}
+
 /*
  * Initialize simple FWD application resources
  *
@@ -1168,6 +1305,10 @@ static int simple_fwd_init(void *p)
 	ret = simple_fwd_create_ins(port_cfg);
 	if (ret)
 		return ret;
+	if (rte_telemetry_register_cmd("/simple_fwd/flows",
+				       simple_fwd_telemetry_flows,
+				       "Returns the flow table and HW offload stats. Takes no parameters") != 0)
+		DOCA_LOG_WARN("Failed to register the flows telemetry command");
 	return simple_fwd_init_ports_and_pipes(port_cfg);
 }
 
@@ -1187,6 +1328,7 @@ static inline void simple_fwd_match_set_tun(struct simple_fwd_pkt_info *pinfo, s
 		match->tun.vxlan_tun_id = DOCA_HTOBE32(DOCA_BETOH32(pinfo->tun.vni) >> 8);
 		break;
 	case DOCA_FLOW_TUN_GRE:
+		match->tun.key_present = pinfo->tun.gre_key_present;
 		match->tun.gre_key = pinfo->tun.gre_key;
 		break;
 	case DOCA_FLOW_TUN_GTPU:
@@ -1286,7 +1428,8 @@ static struct doca_flow_pipe *simple_fwd_select_pipe(struct simple_fwd_pkt_info
 {
 	if (pinfo->tun_type == DOCA_FLOW_TUN_GRE)
 		return simple_fwd_ins->pipe_gre[pinfo->orig_port_id];
-	if (pinfo->tun_type == DOCA_FLOW_TUN_VXLAN)
+	/* pipe_vxlan matches UDP port 4789 and decaps to L2, VXLAN-GPE has no pipe */
+	if (pinfo->tun_type == DOCA_FLOW_TUN_VXLAN && pinfo->tun.vxlan_gpe_proto == 0)
 		return simple_fwd_ins->pipe_vxlan[pinfo->orig_port_id];
 	if (pinfo->tun_type == DOCA_FLOW_TUN_GTPU)
 		return simple_fwd_ins->pipe_gtp[pinfo->orig_port_id];
@@ -1331,7 +1474,9 @@ static struct doca_flow_pipe_entry *simple_fwd_pipe_add_entry(struct simple_fwd_
 
 	status->ft_entry = user_ctx;
 
-	if (pinfo->tun_type != DOCA_FLOW_TUN_VXLAN) {
+	if (pinfo->tun_type == DOCA_FLOW_TUN_GRE && pinfo->tun.l2)
+		actions.action_idx = GRE_ACTION_IDX_L2;
+	else if (pinfo->tun_type != DOCA_FLOW_TUN_VXLAN) {
 		simple_fwd_build_entry_actions(&actions);
 	}
 
@@ -1371,9 +1516,79 @@ error:
 }
 
 /*
- * Adds new flow, with respect to the packet info, to the flow table
+ * Checks whether or not the HW pipes are able to match the flow of the packet
+ *
+ * @pinfo [in]: the packet info as represented in the application
+ * @return: true if the flow can be offloaded and false if it has to stay in software
+ */
+static bool simple_fwd_hw_can_match(struct simple_fwd_pkt_info *pinfo)
+{
+	/* the HW parser does not look past the ERSPAN type II/III header */
+	if (pinfo->tun_type == DOCA_FLOW_TUN_GRE && pinfo->tun.erspan_ver > 1)
+		return false;
+	/* Geneve and VXLAN-GPE have no pipe */
+	if (pinfo->tun_type == DOCA_FLOW_TUN_GENEVE ||
+	    (pinfo->tun_type == DOCA_FLOW_TUN_VXLAN && pinfo->tun.vxlan_gpe_proto != 0))
+		return false;
+	return true;
+}
+
+/*
+ * Checks whether or not the flow of the packet is a TCP connection that can be tracked
+ *
+ * @pinfo [in]: the packet info as represented in the application
+ * @return: true if the flow is TCP, inner TCP for tunnels, and the packet is not a fragment
+ */
+static bool simple_fwd_is_tcp_flow(struct simple_fwd_pkt_info *pinfo)
+{
+	struct simple_fwd_pkt_format *fmt = pinfo->tun_type != DOCA_FLOW_TUN_NONE ? &pinfo->inner : &pinfo->outer;
+
+	return fmt->l4_type == DOCA_FLOW_PROTO_TCP && !fmt->frag;
+}
+
+/*
+ * Checks whether or not the TCP state of the flow is worth a HW rule, half-open and closed
+ * connections are kept in software so that SYN floods do not fill the HW table
+ *
+ * @ft_entry [in]: the flow table entry of the flow
+ * @return: true if the flow can be offloaded, false otherwise
+ */
+static bool simple_fwd_tcp_can_offload(struct simple_fwd_ft_entry *ft_entry)
+{
+	return ft_entry->tcp_state == SIMPLE_FWD_TCP_NONE || ft_entry->tcp_state == SIMPLE_FWD_TCP_ESTABLISHED;
+}
+
+/*
+ * Offloads the flow to the HW pipe selected by its tunnel type
  *
  * @pinfo [in]: the packet info as represented in the application
+ * @ctx [in]: user context of the flow
+ * @return: 0 on success and negative value otherwise
+ */
+static int simple_fwd_offload_flow(struct simple_fwd_pkt_info *pinfo, struct simple_fwd_ft_user_ctx *ctx)
+{
+	struct simple_fwd_pipe_entry *entry = (struct simple_fwd_pipe_entry *)&ctx->data[0];
+	struct simple_fwd_ft_entry *ft_entry = GET_FT_ENTRY(ctx);
+	uint32_t age_sec;
+
+	entry->hw_entry = simple_fwd_pipe_add_entry(pinfo, (void *)ctx, &age_sec);
+	if (entry->hw_entry == NULL) {
+		__atomic_add_fetch(&simple_fwd_ins->offload_stats.failed, 1, __ATOMIC_RELAXED);
+		return -1;
+	}
+	__atomic_add_fetch(&simple_fwd_ins->offload_stats.offloaded, 1, __ATOMIC_RELAXED);
+	simple_fwd_ft_update_age_sec(ft_entry, age_sec);
+	simple_fwd_ft_update_expiration(ft_entry);
+	entry->is_hw = true;
+	ft_entry->hw_off = 1;
+	return 0;
+}
+
+/*
+ * Adds new flow, with respect to the packet info, to the flow table. Flows HW pipes can match are
+ * handed to the offload stage through the packet info.
+ *
+ * @pinfo [in/out]: the packet info as represented in the application
  * @ctx [in]: user context
  * @return: 0 on success and negative value otherwise
  */
@@ -1382,7 +1597,6 @@ static int simple_fwd_handle_new_flow(struct simple_fwd_pkt_info *pinfo, struct
 	doca_error_t result;
 	struct simple_fwd_pipe_entry *entry = NULL;
 	struct simple_fwd_ft_entry *ft_entry;
-	uint32_t age_sec;
 
 	result = simple_fwd_ft_add_new(simple_fwd_ins->ft, pinfo, ctx);
 	if (result != DOCA_SUCCESS) {
@@ -1392,18 +1606,53 @@ static int simple_fwd_handle_new_flow(struct simple_fwd_pkt_info *pinfo, struct
 	ft_entry = GET_FT_ENTRY(*ctx);
 	entry = (struct simple_fwd_pipe_entry *)&(*ctx)->data[0];
 	entry->pipe_queue = pinfo->pipe_queue;
-	entry->hw_entry = simple_fwd_pipe_add_entry(pinfo, (void *)(*ctx), &age_sec);
-	if (entry->hw_entry == NULL) {
-		simple_fwd_ft_destroy_entry(simple_fwd_ins->ft, ft_entry);
-		return -1;
+	if (simple_fwd_is_tcp_flow(pinfo))
+		simple_fwd_ft_tcp_track(simple_fwd_ins->ft, ft_entry, simple_fwd_pinfo_tcp_flags(pinfo));
+	if (!simple_fwd_hw_can_match(pinfo) || !simple_fwd_tcp_can_offload(ft_entry)) {
+		/* closed flows already got their short aging time */
+		if (ft_entry->tcp_state != SIMPLE_FWD_TCP_CLOSED)
+			simple_fwd_ft_update_age_sec(ft_entry, SW_ENTRY_AGE_SEC);
+		simple_fwd_ft_update_expiration(ft_entry);
+		entry->is_hw = false;
+		return 0;
 	}
-	simple_fwd_ft_update_age_sec(ft_entry, age_sec);
-	simple_fwd_ft_update_expiration(ft_entry);
-	entry->is_hw = true;
-
+	entry->is_hw = false;
+	pinfo->flow_ctx = *ctx;
 	return 0;
 }
 
+/*
+ * Acts on a TCP state change of a tracked flow: established flows are handed to the offload stage,
+ * closed flows leave HW so that their last packets are seen and the entry expires right away
+ *
+ * @pinfo [in/out]: the packet info as represented in the application
+ * @ctx [in]: user context of the flow
+ * @state [in]: the new TCP state of the flow
+ */
+static void simple_fwd_handle_tcp_state(struct simple_fwd_pkt_info *pinfo,
+					struct simple_fwd_ft_user_ctx *ctx,
+					enum simple_fwd_ft_tcp_state state)
+{
+	struct simple_fwd_pipe_entry *entry = (struct simple_fwd_pipe_entry *)&ctx->data[0];
+	struct simple_fwd_ft_entry *ft_entry = GET_FT_ENTRY(ctx);
+
+	switch (state) {
+	case SIMPLE_FWD_TCP_ESTABLISHED:
+		if (!entry->is_hw && simple_fwd_hw_can_match(pinfo))
+			pinfo->flow_ctx = ctx;
+		break;
+	case SIMPLE_FWD_TCP_CLOSED:
+		if (entry->is_hw) {
+			simple_fwd_aged_flow_cb(ctx);
+			entry->is_hw = false;
+			ft_entry->hw_off = 0;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
 /*
  * Checks whether or not the received packet info is new.
  *
@@ -1421,32 +1670,152 @@ static bool simple_fwd_need_new_ft(struct simple_fwd_pkt_info *pinfo)
 		DOCA_LOG_WARN("The outer L4 type %u is not supported", pinfo->outer.l4_type);
 		return false;
 	}
+	/*
+	 * fragments carry no ports and every datagram has its own IP id, tracking them would take
+	 * one flow per datagram. They are forwarded untracked, or tracked once reassembled.
+	 */
+	if (pinfo->outer.frag || (pinfo->tun_type != DOCA_FLOW_TUN_NONE && pinfo->inner.frag))
+		return false;
+	/* only traffic that has a pipe to be offloaded to is tracked */
+	if (simple_fwd_select_pipe(pinfo) == NULL)
+		return false;
 	return true;
 }
 
 /*
- * Adjust the mbuf pointer, to point on the packet's raw data
+ * Looks the flow of a packet up in the flow table, tracking new flows and TCP states
  *
- * @pinfo [in]: packet info representation  in the application
+ * @pinfo [in/out]: packet info representation in the application, given the flow to offload if any
  * @return: 0 on success and negative value otherwise
  */
-static int simple_fwd_handle_packet(struct simple_fwd_pkt_info *pinfo)
+static int simple_fwd_lookup_packet(struct simple_fwd_pkt_info *pinfo)
 {
 	struct simple_fwd_ft_user_ctx *ctx = NULL;
 	struct simple_fwd_pipe_entry *entry = NULL;
+	struct simple_fwd_ft_entry *ft_entry;
+	enum simple_fwd_ft_tcp_state state, prev_state;
+	uint8_t tcp_flags = 0;
+	bool is_tcp;
 
+	pinfo->flow_ctx = NULL;
 	if (!simple_fwd_need_new_ft(pinfo))
 		return -1;
+	is_tcp = simple_fwd_is_tcp_flow(pinfo);
+	if (is_tcp)
+		tcp_flags = simple_fwd_pinfo_tcp_flags(pinfo);
 	if (simple_fwd_ft_find(simple_fwd_ins->ft, pinfo, &ctx) != DOCA_SUCCESS) {
+		/* under a SYN flood new connections are forwarded without being tracked */
+		if (is_tcp && (tcp_flags & (RTE_TCP_SYN_FLAG | RTE_TCP_ACK_FLAG)) == RTE_TCP_SYN_FLAG &&
+		    simple_fwd_ft_syn_flood(simple_fwd_ins->ft)) {
+			DOCA_LOG_DBG("Too many half-open flows, new SYN is not tracked");
+			return -1;
+		}
 		if (simple_fwd_handle_new_flow(pinfo, &ctx))
 			return -1;
+	} else if (is_tcp) {
+		ft_entry = GET_FT_ENTRY(ctx);
+		prev_state = ft_entry->tcp_state;
+		state = simple_fwd_ft_tcp_track(simple_fwd_ins->ft, ft_entry, tcp_flags);
+		if (state != prev_state)
+			simple_fwd_handle_tcp_state(pinfo, ctx, state);
 	}
 	entry = (struct simple_fwd_pipe_entry *)&ctx->data[0];
 	entry->total_pkts++;
+	/* a flow handed to the offload stage is released there */
+	if (pinfo->flow_ctx == NULL)
+		simple_fwd_ft_put(simple_fwd_ins->ft, ctx);
 
 	return 0;
 }
 
+/*
+ * Offloads the flow a packet was given by the flow lookup stage. On failure the flow stays in software
+ * until it ages out, its later packets then track it again.
+ *
+ * @pinfo [in]: packet info representation in the application
+ */
+static void simple_fwd_offload_packet(struct simple_fwd_pkt_info *pinfo)
+{
+	struct simple_fwd_ft_user_ctx *ctx = pinfo->flow_ctx;
+	struct simple_fwd_pipe_entry *entry = (struct simple_fwd_pipe_entry *)&ctx->data[0];
+	struct simple_fwd_ft_entry *ft_entry = GET_FT_ENTRY(ctx);
+
+	/* an earlier packet of the burst may have offloaded the flow already */
+	if (!entry->is_hw && simple_fwd_offload_flow(pinfo, ctx) != 0) {
+		simple_fwd_ft_update_age_sec(ft_entry, SW_ENTRY_AGE_SEC);
+		simple_fwd_ft_update_expiration(ft_entry);
+	}
+	simple_fwd_ft_put(simple_fwd_ins->ft, ctx);
+}
+
+/*
+ * Flow lookup stage of the RX pipeline, packets of untracked flows are forwarded as well
+ *
+ * @ctx [in]: unused
+ * @mbufs [in]: received packets
+ * @pinfos [in/out]: info of the packets
+ * @nb_pkts [in]: number of packets
+ * @return: number of packets kept, all of them
+ */
+static uint16_t simple_fwd_flow_lookup_burst(void *ctx __rte_unused,
+					     struct rte_mbuf **mbufs __rte_unused,
+					     struct simple_fwd_pkt_info *pinfos,
+					     uint16_t nb_pkts)
+{
+	uint16_t i;
+
+	for (i = 0; i < nb_pkts; i++)
+		simple_fwd_lookup_packet(&pinfos[i]);
+	return nb_pkts;
+}
+
+/*
+ * Offload stage of the RX pipeline, offloading the flows the flow lookup stage handed over
+ *
+ * @ctx [in]: unused
+ * @mbufs [in]: received packets
+ * @pinfos [in]: info of the packets
+ * @nb_pkts [in]: number of packets
+ * @return: number of packets kept, all of them
+ */
+static uint16_t simple_fwd_offload_burst(void *ctx __rte_unused,
+					 struct rte_mbuf **mbufs __rte_unused,
+					 struct simple_fwd_pkt_info *pinfos,
+					 uint16_t nb_pkts)
+{
+	uint16_t i;
+
+	for (i = 0; i < nb_pkts; i++) {
+		if (pinfos[i].flow_ctx != NULL)
+			simple_fwd_offload_packet(&pinfos[i]);
+	}
+	return nb_pkts;
+}
+
+/* Stages Simple Forward adds to the RX pipeline, in order */
+static const struct app_vnf_stage simple_fwd_stages[] = {
+	{
+		.name = "flow_lookup",
+		.process_burst = &simple_fwd_flow_lookup_burst,
+	},
+	{
+		.name = "offload",
+		.process_burst = &simple_fwd_offload_burst,
+	},
+};
+
+/*
+ * Returns the stages Simple Forward adds to the RX pipeline
+ *
+ * @stages [out]: stages, in order
+ * @return: number of stages
+ */
+static uint16_t simple_fwd_get_stages(const struct app_vnf_stage **stages)
+{
+	*stages = simple_fwd_stages;
+	return RTE_DIM(simple_fwd_stages);
+}
+
 /*
  * Handles aged flows
  *
@@ -1462,6 +1831,45 @@ static void simple_fwd_handle_aging(uint32_t port_id, uint16_t queue)
 	doca_flow_aging_handle(simple_fwd_ins->ports[port_id], queue, MAX_HANDLING_TIME_MS, 0);
 }
 
+/*
+ * Updates the queues of the RSS pipe entry of a port, from the control pipe queue
+ *
+ * @port_id [in]: port identifier
+ * @queues [in]: queue of every hash bucket
+ * @nb_queues [in]: number of entries in queues
+ * @return: 0 on success and negative value otherwise
+ */
+static int simple_fwd_set_rss(uint16_t port_id, const uint16_t *queues, uint16_t nb_queues)
+{
+	struct doca_flow_pipe_entry *entry = simple_fwd_ins->rss_entry[port_id];
+	uint16_t ctrl_queue = simple_fwd_ins->nb_queues;
+	uint16_t rss_queues[nb_queues];
+	struct doca_flow_fwd fwd;
+	struct entries_status *status = simple_fwd_ins->rss_status[port_id];
+	doca_error_t result;
+
+	memcpy(rss_queues, queues, sizeof(rss_queues));
+	memset(&fwd, 0, sizeof(fwd));
+	fwd.type = DOCA_FLOW_FWD_RSS;
+	fwd.rss_type = DOCA_FLOW_RESOURCE_TYPE_NON_SHARED;
+	fwd.rss.outer_flags = DOCA_FLOW_RSS_IPV4 | DOCA_FLOW_RSS_UDP;
+	fwd.rss.nr_queues = nb_queues;
+	fwd.rss.queues_array = rss_queues;
+
+	status->failure = false;
+	result = doca_flow_pipe_update_entry(ctrl_queue, simple_fwd_ins->pipe_rss[port_id], NULL, NULL, &fwd, 0, entry);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to update RSS entry: %s", doca_error_get_descr(result));
+		return -1;
+	}
+	result = doca_flow_entries_process(simple_fwd_ins->ports[port_id], ctrl_queue, PULL_TIME_OUT, 1);
+	if (result != DOCA_SUCCESS || status->failure) {
+		DOCA_LOG_ERR("Failed to process RSS entry update: %s", doca_error_get_descr(result));
+		return -1;
+	}
+	return 0;
+}
+
 /*
  * Dump stats of the given port identifier
  *
@@ -1476,10 +1884,11 @@ static int simple_fwd_dump_stats(uint32_t port_id)
 /* Stores all functions pointers used by the application */
 static struct app_vnf simple_fwd_vnf = {
 	.vnf_init = &simple_fwd_init,		      /* Simple Forward initialization resources function pointer */
-	.vnf_process_pkt = &simple_fwd_handle_packet, /* Simple Forward packet processing function pointer */
+	.vnf_get_stages = &simple_fwd_get_stages,     /* Simple Forward RX pipeline stages function pointer */
 	.vnf_flow_age = &simple_fwd_handle_aging,     /* Simple Forward aging handling function pointer */
 	.vnf_dump_stats = &simple_fwd_dump_stats,     /* Simple Forward dumping stats function pointer */
 	.vnf_destroy = &simple_fwd_destroy,	      /* Simple Forward destroy allocated resources function pointer */
+	.vnf_set_rss = &simple_fwd_set_rss,	      /* Simple Forward RSS queues update function pointer */
 };
 
 /*
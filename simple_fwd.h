@@ -37,6 +37,13 @@
 #define SIMPLE_FWD_PORTS (2)	    /* Number of ports used by the application */
 #define SIMPLE_FWD_MAX_FLOWS (8096) /* Maximum number of flows used/added by the application at a given time */
 
+/* HW offload counters of the flows, updated by the RX lcores and the aging */
+struct simple_fwd_offload_stats {
+	uint64_t offloaded; /* Flows added to HW */
+	uint64_t failed;    /* Flows HW refused */
+	uint64_t removed;   /* Flows removed from HW, aged or closed */
+};
+
 /* Application resources, such as flow table, pipes and hairpin peers */
 struct simple_fwd_app {
 	struct simple_fwd_ft *ft;			       /* Flow table, used for stprng flows */
@@ -48,7 +55,10 @@ struct simple_fwd_app {
 	struct doca_flow_pipe *pipe_control[SIMPLE_FWD_PORTS]; /* control pipe of each port */
 	struct doca_flow_pipe *pipe_hairpin[SIMPLE_FWD_PORTS]; /* hairpin pipe for non-VxLAN/GRE/GTP traffic */
 	struct doca_flow_pipe *pipe_rss[SIMPLE_FWD_PORTS];     /* RSS pipe, matches every packet and forwards to SW */
+	struct doca_flow_pipe_entry *rss_entry[SIMPLE_FWD_PORTS]; /* RSS pipe entry, its queues change at runtime */
+	struct entries_status *rss_status[SIMPLE_FWD_PORTS];	  /* Processing status of the RSS pipe entry */
 	struct doca_flow_pipe *vxlan_encap_pipe[SIMPLE_FWD_PORTS]; /* vxlan encap pipe on the egress domain */
+	struct simple_fwd_offload_stats offload_stats;		   /* HW offload counters of the flows */
 	uint16_t nb_queues;					   /* flow age query item buffer */
 	struct doca_flow_aged_query *query_array[0];		   /* buffer for flow aged query items */
 };
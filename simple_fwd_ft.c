@@ -27,6 +27,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <rte_tcp.h>
+
 #include <doca_flow.h>
 #include <doca_log.h>
 
@@ -35,25 +37,22 @@
 
 DOCA_LOG_REGISTER(SIMPLE_FWD_FT);
 
+#define FT_TCP_CLOSED_AGE_SEC (1) /* Aging time of TCP flows once FIN or RST was seen */
+#define FT_HALF_OPEN_RATIO (4)	  /* At most 1/FT_HALF_OPEN_RATIO of the table holds half-open TCP flows */
+
 /* Bucket is a struct encomassing the list and the synchronization mechanism used for accessing the flows list */
 struct simple_fwd_ft_bucket {
 	struct simple_fwd_ft_entry_head head; /* The head of the list of the flows */
 	rte_spinlock_t lock;		      /* Lock, a synchronization mechanism */
 };
 
-/* Stats for the flow table */
-struct simple_fwd_ft_stats {
-	uint64_t add;	 /* Number of insertions to the flow table */
-	uint64_t rm;	 /* Number of removals from the flow table */
-	uint64_t memuse; /* Memory ysage of the flow table */
-};
-
 /* Flow table configuration */
 struct simple_fwd_ft_cfg {
 	uint32_t size;		 /* Number of maximum flows in a given time while the application is running */
 	uint32_t mask;		 /* Masking; */
 	uint32_t user_data_size; /* User data size needed for allocation */
 	uint32_t entry_size;	 /* Size needed for storing a single entry flow */
+	uint32_t max_half_open;	 /* Maximum number of half-open TCP flows */
 };
 
 /* Flow table as represented in the application */
@@ -93,6 +92,9 @@ static bool simple_fwd_ft_update_counter(struct simple_fwd_ft_entry *e)
 	struct doca_flow_resource_query query_stats = {0};
 	bool update = 0;
 
+	/* software only entries are kept alive by lookups refreshing their expiration */
+	if (!entry->is_hw)
+		return false;
 	if (doca_flow_resource_query_entry(entry->hw_entry, &query_stats) == DOCA_SUCCESS) {
 		update = !!(query_stats.counter.total_pkts - e->last_counter);
 		e->last_counter = query_stats.counter.total_pkts;
@@ -101,17 +103,37 @@ static bool simple_fwd_ft_update_counter(struct simple_fwd_ft_entry *e)
 }
 
 /*
- * Destroy flow entry in the flow table
+ * Drop a reference to a flow entry, the last one releases the flow and frees the entry
+ *
+ * @ft [in]: the flow table the entry belongs to
+ * @ft_entry [in]: entry flow to release, as represented in the application
+ */
+static void ft_entry_put(struct simple_fwd_ft *ft, struct simple_fwd_ft_entry *ft_entry)
+{
+	if (__atomic_sub_fetch(&ft_entry->refcnt, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+	ft->simple_fwd_aging_cb(&ft_entry->user_ctx);
+	free(ft_entry);
+}
+
+/*
+ * Destroy flow entry in the flow table, the bucket lock of the entry must be held.
+ * The entry is freed once the lcores still using it release it.
  *
  * @ft [in]: the flow table to remove the entry from
  * @ft_entry [in]: entry flow to remove, as represented in the application
  */
 static void _ft_destroy_entry(struct simple_fwd_ft *ft, struct simple_fwd_ft_entry *ft_entry)
 {
+	/* an entry aged by HW may have been removed by the aging thread or a lookup already */
+	if (ft_entry->next.le_prev == NULL)
+		return;
+	if (ft_entry->tcp_state == SIMPLE_FWD_TCP_SYN)
+		__atomic_sub_fetch(&ft->stats.half_open, 1, __ATOMIC_RELAXED);
 	LIST_REMOVE(ft_entry, next);
-	ft->simple_fwd_aging_cb(&ft_entry->user_ctx);
-	free(ft_entry);
-	ft->stats.rm++;
+	ft_entry->next.le_prev = NULL;
+	__atomic_add_fetch(&ft->stats.rm, 1, __ATOMIC_RELAXED);
+	ft_entry_put(ft, ft_entry);
 }
 
 void simple_fwd_ft_destroy_entry(struct simple_fwd_ft *ft, struct simple_fwd_ft_entry *ft_entry)
@@ -140,7 +162,8 @@ static bool simple_fwd_ft_aging_ft_entry(struct simple_fwd_ft *ft, unsigned int
 		node = LIST_FIRST(&ft->buckets[i].head);
 		while (node) {
 			ptr = LIST_NEXT(node, next);
-			if (node->age_sec && node->expiration < t && !simple_fwd_ft_update_counter(node)) {
+			if (node->age_sec && node->expiration < t &&
+			    (node->tcp_state == SIMPLE_FWD_TCP_CLOSED || !simple_fwd_ft_update_counter(node))) {
 				DOCA_LOG_DBG("Aging removing flow");
 				_ft_destroy_entry(ft, node);
 				still_aging = true;
@@ -227,14 +250,14 @@ static int simple_fwd_ft_key_fill(struct simple_fwd_pkt_info *pinfo, struct simp
 	key->protocol = inner ? pinfo->inner.l4_type : pinfo->outer.l4_type;
 	key->ipv4_1 = simple_fwd_ft_key_get_ipv4_src(inner, pinfo);
 	key->ipv4_2 = simple_fwd_ft_key_get_ipv4_dst(inner, pinfo);
+	key->port_id = pinfo->orig_port_id;
 	key->port_1 = simple_fwd_ft_key_get_src_port(inner, pinfo);
 	key->port_2 = simple_fwd_ft_key_get_dst_port(inner, pinfo);
-	key->port_id = pinfo->orig_port_id;
 
-	/* in case of tunnel , use tun type and vni */
+	/* in case of tunnel , use tun type and tunnel id (VNI, GRE key or TEID) */
 	if (pinfo->tun_type != DOCA_FLOW_TUN_NONE) {
 		key->tun_type = pinfo->tun_type;
-		key->vni = pinfo->tun.vni;
+		key->vni = simple_fwd_pinfo_tun_id(pinfo);
 	}
 	return 0;
 }
@@ -288,6 +311,7 @@ struct simple_fwd_ft *simple_fwd_ft_create(int nb_flows,
 	ft->cfg.entry_size = sizeof(struct simple_fwd_ft_entry) + user_data_size;
 	ft->cfg.user_data_size = user_data_size;
 	ft->cfg.size = nb_flows_aligned;
+	ft->cfg.max_half_open = nb_flows / FT_HALF_OPEN_RATIO;
 	ft->cfg.mask = nb_flows_aligned - 1;
 	ft->simple_fwd_aging_cb = simple_fwd_aging_cb;
 	ft->simple_fwd_aging_hw_cb = simple_fwd_aging_hw_cb;
@@ -308,25 +332,34 @@ struct simple_fwd_ft *simple_fwd_ft_create(int nb_flows,
  *
  * @ft [in]: flow table to search in
  * @key [in]: the packet generated key used for search in the flow table
- * @return: pointer to the flow entry if found, NULL otherwise
+ * @return: pointer to the flow entry if found, referenced until ft_entry_put(), NULL otherwise
  */
 static struct simple_fwd_ft_entry *_simple_fwd_ft_find(struct simple_fwd_ft *ft, struct simple_fwd_ft_key *key)
 {
 	uint32_t idx;
+	uint64_t t = rte_rdtsc();
 	struct simple_fwd_ft_entry_head *first;
-	struct simple_fwd_ft_entry *node;
+	struct simple_fwd_ft_entry *node, *ptr;
 
 	idx = key->rss_hash & ft->cfg.mask;
 	DOCA_LOG_TRC("Looking for index %d", idx);
 	first = &ft->buckets[idx].head;
-	LIST_FOREACH(node, first, next)
-	{
+	rte_spinlock_lock(&ft->buckets[idx].lock);
+	node = LIST_FIRST(first);
+	while (node) {
+		ptr = LIST_NEXT(node, next);
 		if (simple_fwd_ft_key_equal(&node->key, key)) {
 			simple_fwd_ft_update_expiration(node);
-			return node;
+			__atomic_add_fetch(&node->refcnt, 1, __ATOMIC_RELAXED);
+			break;
 		}
+		/* software only entries are not aged by HW, unlink expired ones on the way */
+		if (!node->hw_off && node->age_sec && node->expiration < t)
+			_ft_destroy_entry(ft, node);
+		node = ptr;
 	}
-	return NULL;
+	rte_spinlock_unlock(&ft->buckets[idx].lock);
+	return node;
 }
 
 doca_error_t simple_fwd_ft_find(struct simple_fwd_ft *ft,
@@ -381,22 +414,76 @@ doca_error_t simple_fwd_ft_add_new(struct simple_fwd_ft *ft,
 	}
 
 	simple_fwd_ft_update_expiration(new_e);
+	/* one reference for the table and one for the caller */
+	new_e->refcnt = 2;
 	new_e->user_ctx.fid = ft->fid_ctr++;
 	*ctx = &new_e->user_ctx;
 
 	DOCA_LOG_TRC("Defined new flow %llu", (unsigned int long long)new_e->user_ctx.fid);
 	memcpy(&new_e->key, &key, sizeof(struct simple_fwd_ft_key));
-	idx = pinfo->rss_hash & ft->cfg.mask;
+	idx = key.rss_hash & ft->cfg.mask;
 	new_e->buckets_index = idx;
 	first = &ft->buckets[idx].head;
 
 	rte_spinlock_lock(&ft->buckets[idx].lock);
 	LIST_INSERT_HEAD(first, new_e, next);
 	rte_spinlock_unlock(&ft->buckets[idx].lock);
-	ft->stats.add++;
+	__atomic_add_fetch(&ft->stats.add, 1, __ATOMIC_RELAXED);
 	return result;
 }
 
+void simple_fwd_ft_put(struct simple_fwd_ft *ft, struct simple_fwd_ft_user_ctx *ctx)
+{
+	ft_entry_put(ft, container_of(ctx, struct simple_fwd_ft_entry, user_ctx));
+}
+
+enum simple_fwd_ft_tcp_state simple_fwd_ft_tcp_track(struct simple_fwd_ft *ft,
+						     struct simple_fwd_ft_entry *e,
+						     uint8_t tcp_flags)
+{
+	rte_spinlock_t *lock = &ft->buckets[e->buckets_index].lock;
+	enum simple_fwd_ft_tcp_state state;
+
+	/* serialized with the aging of the entry, which reads the state and the half-open count */
+	rte_spinlock_lock(lock);
+	state = e->tcp_state;
+	if (tcp_flags & (RTE_TCP_FIN_FLAG | RTE_TCP_RST_FLAG))
+		state = SIMPLE_FWD_TCP_CLOSED;
+	else if (tcp_flags & RTE_TCP_SYN_FLAG) {
+		/* a retransmitted SYN does not move an established flow back */
+		if (state == SIMPLE_FWD_TCP_NONE)
+			state = SIMPLE_FWD_TCP_SYN;
+	} else if (state == SIMPLE_FWD_TCP_NONE || state == SIMPLE_FWD_TCP_SYN)
+		state = SIMPLE_FWD_TCP_ESTABLISHED;
+
+	if (state != e->tcp_state) {
+		if (e->tcp_state == SIMPLE_FWD_TCP_SYN)
+			__atomic_sub_fetch(&ft->stats.half_open, 1, __ATOMIC_RELAXED);
+		else if (state == SIMPLE_FWD_TCP_SYN)
+			__atomic_add_fetch(&ft->stats.half_open, 1, __ATOMIC_RELAXED);
+		if (state == SIMPLE_FWD_TCP_CLOSED) {
+			simple_fwd_ft_update_age_sec(e, FT_TCP_CLOSED_AGE_SEC);
+			simple_fwd_ft_update_expiration(e);
+		}
+		e->tcp_state = state;
+	}
+	rte_spinlock_unlock(lock);
+	return state;
+}
+
+bool simple_fwd_ft_syn_flood(struct simple_fwd_ft *ft)
+{
+	return __atomic_load_n(&ft->stats.half_open, __ATOMIC_RELAXED) >= ft->cfg.max_half_open;
+}
+
+void simple_fwd_ft_get_stats(struct simple_fwd_ft *ft, struct simple_fwd_ft_stats *stats)
+{
+	stats->add = __atomic_load_n(&ft->stats.add, __ATOMIC_RELAXED);
+	stats->rm = __atomic_load_n(&ft->stats.rm, __ATOMIC_RELAXED);
+	stats->memuse = __atomic_load_n(&ft->stats.memuse, __ATOMIC_RELAXED);
+	stats->half_open = __atomic_load_n(&ft->stats.half_open, __ATOMIC_RELAXED);
+}
+
 doca_error_t simple_fwd_ft_destroy(struct simple_fwd_ft *ft)
 {
 	uint32_t i;
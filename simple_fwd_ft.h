@@ -37,12 +37,28 @@
 struct simple_fwd_ft;	  /* Flow table */
 struct simple_fwd_ft_key; /* Keys flow table */
 
+/* Stats for the flow table */
+struct simple_fwd_ft_stats {
+	uint64_t add;	 /* Number of insertions to the flow table */
+	uint64_t rm;	 /* Number of removals from the flow table */
+	uint64_t memuse; /* Memory ysage of the flow table */
+	uint32_t half_open; /* Number of TCP flows in SYN state */
+};
+
 /* Flow table user context */
 struct simple_fwd_ft_user_ctx {
 	uint32_t fid;	 /* Forwarding id, used for flow table */
 	uint8_t data[0]; /* A pointer to the flow entry in the flow table as represented in the application */
 };
 
+/* TCP connection state of a flow, tracked per direction from the TCP flags seen in software */
+enum simple_fwd_ft_tcp_state {
+	SIMPLE_FWD_TCP_NONE,	    /* Not a TCP flow */
+	SIMPLE_FWD_TCP_SYN,	    /* SYN or SYN-ACK seen, the handshake is not completed */
+	SIMPLE_FWD_TCP_ESTABLISHED, /* Handshake completed, or flow picked up in the middle */
+	SIMPLE_FWD_TCP_CLOSED,	    /* FIN or RST seen, the flow expires shortly */
+};
+
 /* Simple FWD flow entry representation in flow table */
 struct simple_fwd_ft_entry {
 	LIST_ENTRY(simple_fwd_ft_entry) next;	/* Entry pointers in the list */
@@ -52,7 +68,9 @@ struct simple_fwd_ft_entry {
 	uint64_t last_counter;			/* Last HW counter of matched packets */
 	uint64_t sw_ctr;			/* SW counter of matched packets */
 	uint8_t hw_off;				/* Whether or not the entry was HW offloaded */
+	uint8_t tcp_state;			/* TCP connection state, see enum simple_fwd_ft_tcp_state */
 	uint16_t buckets_index;			/* The index of the entry in the buckets */
+	uint32_t refcnt;			/* References held by the table while listed and by lcores using it */
 	struct simple_fwd_ft_user_ctx user_ctx; /* A context that can be stored and used */
 };
 LIST_HEAD(simple_fwd_ft_entry_head, simple_fwd_ft_entry); /* Head of the list of the flows as represented in the
@@ -103,7 +121,7 @@ doca_error_t simple_fwd_ft_destroy(struct simple_fwd_ft *ft);
  *
  * @ft [in]: flow table to add the entry to
  * @pinfo [in]: the packet info for generating the key for the new entry to add
- * @ctx [in]: simple fwd user context
+ * @ctx [in]: simple fwd user context, referenced until simple_fwd_ft_put()
  * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
  */
 doca_error_t simple_fwd_ft_add_new(struct simple_fwd_ft *ft,
@@ -115,13 +133,21 @@ doca_error_t simple_fwd_ft_add_new(struct simple_fwd_ft *ft,
  *
  * @ft [in]: flow table to search in
  * @pinfo [in]: the packet info for generating the key for the search
- * @ctx [in]: simple fwd user context
+ * @ctx [in]: simple fwd user context, referenced until simple_fwd_ft_put()
  * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
  */
 doca_error_t simple_fwd_ft_find(struct simple_fwd_ft *ft,
 				struct simple_fwd_pkt_info *pinfo,
 				struct simple_fwd_ft_user_ctx **ctx);
 
+/*
+ * Releases the entry a lookup or an insertion returned, the entry may be freed once it is aged
+ *
+ * @ft [in]: flow table the entry belongs to
+ * @ctx [in]: simple fwd user context of the entry
+ */
+void simple_fwd_ft_put(struct simple_fwd_ft *ft, struct simple_fwd_ft_user_ctx *ctx);
+
 /*
  * Remove entry from flow table if found
  *
@@ -130,6 +156,35 @@ doca_error_t simple_fwd_ft_find(struct simple_fwd_ft *ft,
  */
 void simple_fwd_ft_destroy_entry(struct simple_fwd_ft *ft, struct simple_fwd_ft_entry *ft_entry);
 
+/*
+ * Moves the TCP state machine of the entry according to the flags of a packet of the flow.
+ * Closed flows get a short aging time and are removed right after it, regardless of HW counters.
+ *
+ * @ft [in]: flow table the entry belongs to
+ * @e [in]: the entry of the flow
+ * @tcp_flags [in]: TCP flags of the packet
+ * @return: the new TCP state of the entry
+ */
+enum simple_fwd_ft_tcp_state simple_fwd_ft_tcp_track(struct simple_fwd_ft *ft,
+						     struct simple_fwd_ft_entry *e,
+						     uint8_t tcp_flags);
+
+/*
+ * Checks whether or not the flow table holds too many half-open TCP flows to accept new ones
+ *
+ * @ft [in]: flow table to check
+ * @return: true if new SYN flows should not be tracked, false otherwise
+ */
+bool simple_fwd_ft_syn_flood(struct simple_fwd_ft *ft);
+
+/*
+ * Reads the stats of the flow table while the lcores keep updating them
+ *
+ * @ft [in]: flow table to read the stats of
+ * @stats [out]: stats of the flow table
+ */
+void simple_fwd_ft_get_stats(struct simple_fwd_ft *ft, struct simple_fwd_ft_stats *stats);
+
 /*
  * Update aging time of entry in the flow table
  *
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+
+#include <doca_log.h>
+
+#include "simple_fwd_latency.h"
+
+DOCA_LOG_REGISTER(SIMPLE_FWD_LATENCY);
+
+#define LATENCY_NS_PER_S 1E9 /* Nanoseconds per second */
+#define LATENCY_HW_CALIBRATE_MS 100 /* Time between the two clock readings of the initial calibration */
+#define LATENCY_HW_SYNC_S 1	    /* Seconds between two synchronizations of the device clocks by an lcore */
+
+/* Names of the latency segments, as reported */
+static const char *const latency_seg_names[SIMPLE_FWD_LATENCY_SEG_MAX] = {
+	[SIMPLE_FWD_LATENCY_SEG_RX] = "rx",
+	[SIMPLE_FWD_LATENCY_SEG_RING] = "ring",
+	[SIMPLE_FWD_LATENCY_SEG_TX] = "tx",
+	[SIMPLE_FWD_LATENCY_SEG_TOTAL] = "total",
+};
+
+/* Histograms of the lcores recording latencies, NULL for the others */
+static struct simple_fwd_latency_lcore *latency_lcores[RTE_MAX_LCORE];
+
+/* Hardware RX timestamps as calibrated at startup, copied by every lcore */
+static struct simple_fwd_latency_hw latency_hw = {
+	.ts_offset = -1,
+};
+
+int simple_fwd_latency_hw_register(void)
+{
+	int ret;
+
+	ret = rte_mbuf_dyn_rx_timestamp_register(&latency_hw.ts_offset, &latency_hw.ts_flag);
+	if (ret < 0) {
+		DOCA_LOG_ERR("Failed to register the RX timestamp field: %s", rte_strerror(rte_errno));
+		latency_hw.ts_offset = -1;
+		return ret;
+	}
+	return 0;
+}
+
+/*
+ * Reads the device clock of a port along with the TSC, taken as the middle of the reading
+ *
+ * @port_id [in]: port identifier
+ * @dev [out]: device clock
+ * @tsc [out]: TSC at the device clock reading
+ * @return: 0 on success and negative value otherwise
+ */
+static int latency_read_clock(uint16_t port_id, uint64_t *dev, uint64_t *tsc)
+{
+	uint64_t before = rte_rdtsc();
+	int ret;
+
+	ret = rte_eth_read_clock(port_id, dev);
+	if (ret < 0)
+		return ret;
+	*tsc = before + (rte_rdtsc() - before) / 2;
+	return 0;
+}
+
+void simple_fwd_latency_hw_init(uint16_t nb_ports)
+{
+	struct simple_fwd_latency_clock *clock;
+	struct rte_eth_conf conf;
+	uint64_t dev, tsc;
+	uint16_t port_id;
+
+	if (latency_hw.ts_offset < 0)
+		return;
+	for (port_id = 0; port_id < nb_ports && port_id < NUM_OF_PORTS; port_id++) {
+		clock = &latency_hw.clock[port_id];
+		if (rte_eth_dev_conf_get(port_id, &conf) != 0 ||
+		    !(conf.rxmode.offloads & RTE_ETH_RX_OFFLOAD_TIMESTAMP) ||
+		    latency_read_clock(port_id, &clock->dev_ref, &clock->tsc_ref) != 0) {
+			DOCA_LOG_WARN("Port %u does not stamp the packets it receives, falling back to software timestamps",
+				      port_id);
+			continue;
+		}
+		rte_delay_ms(LATENCY_HW_CALIBRATE_MS);
+		if (latency_read_clock(port_id, &dev, &tsc) != 0 || dev <= clock->dev_ref) {
+			DOCA_LOG_WARN("Port %u clock does not advance, falling back to software timestamps", port_id);
+			continue;
+		}
+		clock->tsc_per_tick = (double)(tsc - clock->tsc_ref) / (double)(dev - clock->dev_ref);
+		clock->dev_ref = dev;
+		clock->tsc_ref = tsc;
+		clock->hw = true;
+		DOCA_LOG_INFO("Port %u RX timestamps from hardware, %.4f TSC cycles per device clock tick",
+			      port_id,
+			      clock->tsc_per_tick);
+	}
+}
+
+void simple_fwd_latency_hw_get(struct simple_fwd_latency_hw *hw)
+{
+	*hw = latency_hw;
+	hw->next_sync = rte_rdtsc() + rte_get_tsc_hz() * LATENCY_HW_SYNC_S;
+}
+
+void simple_fwd_latency_hw_sync(struct simple_fwd_latency_hw *hw, uint64_t now)
+{
+	struct simple_fwd_latency_clock *clock;
+	uint64_t dev, tsc;
+	uint16_t port_id;
+
+	hw->next_sync = now + rte_get_tsc_hz() * LATENCY_HW_SYNC_S;
+	for (port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+		clock = &hw->clock[port_id];
+		if (!clock->hw || latency_read_clock(port_id, &dev, &tsc) != 0 || dev <= clock->dev_ref)
+			continue;
+		/* the rate over the last period corrects the drift, the new reference the offset */
+		clock->tsc_per_tick = (double)(tsc - clock->tsc_ref) / (double)(dev - clock->dev_ref);
+		clock->dev_ref = dev;
+		clock->tsc_ref = tsc;
+	}
+}
+
+struct simple_fwd_latency_lcore *simple_fwd_latency_lcore_init(unsigned int lcore_id)
+{
+	struct simple_fwd_latency_lcore *lat;
+
+	lat = rte_zmalloc_socket("latency",
+				 sizeof(*lat),
+				 RTE_CACHE_LINE_SIZE,
+				 (int)rte_lcore_to_socket_id(lcore_id));
+	if (lat == NULL) {
+		DOCA_LOG_ERR("Failed to allocate the latency histograms of core %u", lcore_id);
+		return NULL;
+	}
+	__atomic_store_n(&latency_lcores[lcore_id], lat, __ATOMIC_RELEASE);
+	return lat;
+}
+
+struct simple_fwd_latency_lcore *simple_fwd_latency_lcore_get(unsigned int lcore_id)
+{
+	return __atomic_load_n(&latency_lcores[lcore_id], __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Adds a histogram to a sum, reading every counter atomically while its lcore keeps recording
+ *
+ * @total [in/out]: sum of the histograms
+ * @hist [in]: histogram of an lcore
+ */
+static void latency_hist_add(struct simple_fwd_latency_hist *total, const struct simple_fwd_latency_hist *hist)
+{
+	uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+	uint32_t i;
+
+	total->count += __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+	total->sum += __atomic_load_n(&hist->sum, __ATOMIC_RELAXED);
+	if (max > total->max)
+		total->max = max;
+	for (i = 0; i < SIMPLE_FWD_LATENCY_NB_BUCKETS; i++)
+		total->buckets[i] += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+}
+
+const char *simple_fwd_latency_seg_name(enum simple_fwd_latency_seg seg)
+{
+	return latency_seg_names[seg];
+}
+
+void simple_fwd_latency_merge(uint16_t port_id,
+			      uint8_t tc,
+			      enum simple_fwd_latency_seg seg,
+			      struct simple_fwd_latency_hist *total)
+{
+	struct simple_fwd_latency_lcore *lat;
+	unsigned int lcore_id;
+
+	memset(total, 0, sizeof(*total));
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		lat = __atomic_load_n(&latency_lcores[lcore_id], __ATOMIC_ACQUIRE);
+		if (lat != NULL)
+			latency_hist_add(total, &lat->hist[port_id][tc][seg]);
+	}
+}
+
+/*
+ * Returns the highest latency a bucket holds
+ *
+ * @bucket [in]: bucket index
+ * @return: highest latency of the bucket, in TSC cycles
+ */
+static uint64_t latency_bucket_upper(uint32_t bucket)
+{
+	uint32_t shift;
+
+	if (bucket < SIMPLE_FWD_LATENCY_SUB_COUNT)
+		return bucket;
+	shift = (bucket >> SIMPLE_FWD_LATENCY_SUB_BITS) - 1;
+	return (((uint64_t)SIMPLE_FWD_LATENCY_SUB_COUNT + (bucket & (SIMPLE_FWD_LATENCY_SUB_COUNT - 1)) + 1) << shift) -
+	       1;
+}
+
+uint64_t simple_fwd_latency_percentile(const struct simple_fwd_latency_hist *hist, double quantile)
+{
+	double exact_rank = quantile * hist->count;
+	uint64_t rank, seen = 0;
+	uint32_t i;
+
+	if (hist->count == 0)
+		return 0;
+	/* rank of the percentile, rounded up, and at least the first latency */
+	rank = (uint64_t)exact_rank;
+	if (rank < exact_rank || rank == 0)
+		rank++;
+	for (i = 0; i < SIMPLE_FWD_LATENCY_NB_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank)
+			return RTE_MIN(latency_bucket_upper(i), hist->max);
+	}
+	/* the counters are read one by one, the buckets may lag behind the count */
+	return hist->max;
+}
+
+uint64_t simple_fwd_latency_cycles_to_ns(uint64_t cycles)
+{
+	return (uint64_t)((double)cycles * LATENCY_NS_PER_S / rte_get_tsc_hz());
+}
+
+void simple_fwd_latency_dump(void)
+{
+	struct simple_fwd_latency_hist hist;
+	uint16_t port_id;
+	uint8_t tc;
+	int seg;
+
+	for (port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+		for (tc = 0; tc < SIMPLE_FWD_QOS_NB_TC; tc++) {
+			for (seg = 0; seg < SIMPLE_FWD_LATENCY_SEG_MAX; seg++) {
+				simple_fwd_latency_merge(port_id, tc, seg, &hist);
+				/* run to completion classes have no ring segment */
+				if (hist.count == 0)
+					continue;
+				DOCA_LOG_INFO("Latency port %u class %u %s: %lu samples, avg %lu ns, p50 %lu ns, p99 %lu ns, p99.9 %lu ns, max %lu ns",
+					      port_id,
+					      tc,
+					      latency_seg_names[seg],
+					      hist.count,
+					      simple_fwd_latency_cycles_to_ns(hist.sum / hist.count),
+					      simple_fwd_latency_cycles_to_ns(simple_fwd_latency_percentile(&hist, 0.5)),
+					      simple_fwd_latency_cycles_to_ns(simple_fwd_latency_percentile(&hist, 0.99)),
+					      simple_fwd_latency_cycles_to_ns(simple_fwd_latency_percentile(&hist, 0.999)),
+					      simple_fwd_latency_cycles_to_ns(hist.max));
+			}
+		}
+	}
+}
+
+void simple_fwd_latency_destroy(void)
+{
+	unsigned int lcore_id;
+
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		rte_free(latency_lcores[lcore_id]);
+		latency_lcores[lcore_id] = NULL;
+	}
+}
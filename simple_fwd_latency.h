@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SIMPLE_FWD_LATENCY_H_
+#define SIMPLE_FWD_LATENCY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+
+#include "simple_fwd_port.h"
+#include "simple_fwd_qos.h"
+
+#define SIMPLE_FWD_LATENCY_SUB_BITS 5 /* Linear sub-buckets per power of 2, as log2, bounding the error to 1/32 */
+#define SIMPLE_FWD_LATENCY_SUB_COUNT (1 << SIMPLE_FWD_LATENCY_SUB_BITS)
+#define SIMPLE_FWD_LATENCY_MAX_BITS 40 /* Latencies of 2^40 TSC cycles and more land in the last bucket */
+#define SIMPLE_FWD_LATENCY_NB_BUCKETS \
+	((SIMPLE_FWD_LATENCY_MAX_BITS - SIMPLE_FWD_LATENCY_SUB_BITS + 1) << SIMPLE_FWD_LATENCY_SUB_BITS)
+
+/* Segments of the latency of a packet */
+enum simple_fwd_latency_seg {
+	SIMPLE_FWD_LATENCY_SEG_RX,    /* RX timestamp to enqueue: RX burst and the RX pipeline stages */
+	SIMPLE_FWD_LATENCY_SEG_RING,  /* Enqueue to scheduling: QoS ring residency */
+	SIMPLE_FWD_LATENCY_SEG_TX,    /* Scheduling, or enqueue stage of run to completion classes, to TX burst return */
+	SIMPLE_FWD_LATENCY_SEG_TOTAL, /* RX timestamp to TX burst return */
+	SIMPLE_FWD_LATENCY_SEG_MAX,
+};
+
+/* Timestamps carried by the mbufs in a dynamic field, in TSC cycles */
+struct simple_fwd_latency_ts {
+	uint64_t rx;  /* RX timestamp, 0 when the packet is not sampled */
+	uint64_t enq; /* Enqueue stage, set on every packet as CoDel measures the sojourn time from it */
+	uint64_t deq; /* Scheduling by a TX lcore, 0 for run to completion classes */
+};
+
+/* Conversion of the device clock of a port to TSC, refreshed by every lcore on its own copy */
+struct simple_fwd_latency_clock {
+	bool hw;	     /* The port stamps the packets it receives */
+	uint64_t dev_ref;    /* Device clock at the last synchronization */
+	uint64_t tsc_ref;    /* TSC at the last synchronization */
+	double tsc_per_tick; /* TSC cycles per device clock tick */
+};
+
+/* Hardware RX timestamps of the ports, as seen by an lcore */
+struct simple_fwd_latency_hw {
+	int ts_offset;						/* Dynamic field of the timestamp, -1 when disabled */
+	uint64_t ts_flag;					/* Flag of the mbufs holding a timestamp */
+	uint64_t next_sync;					/* TSC of the next clocks synchronization */
+	struct simple_fwd_latency_clock clock[NUM_OF_PORTS];	/* Per RX port */
+};
+
+/*
+ * Log-linear histogram of latencies in TSC cycles, HDR style: every power of 2 is split in
+ * SIMPLE_FWD_LATENCY_SUB_COUNT linear buckets. Written by a single lcore, read by the reporter
+ * without locking.
+ */
+struct simple_fwd_latency_hist {
+	uint64_t count;					       /* Recorded latencies */
+	uint64_t sum;					       /* Sum of the recorded latencies */
+	uint64_t max;					       /* Highest recorded latency */
+	uint64_t buckets[SIMPLE_FWD_LATENCY_NB_BUCKETS];       /* Recorded latencies per bucket */
+};
+
+/* Latency histograms of an lcore */
+struct simple_fwd_latency_lcore {
+	struct simple_fwd_latency_hist hist[NUM_OF_PORTS][SIMPLE_FWD_QOS_NB_TC]
+					   [SIMPLE_FWD_LATENCY_SEG_MAX]; /* Per RX port, class and segment */
+} __rte_cache_aligned;
+
+/*
+ * Returns the histogram bucket of a latency
+ *
+ * @cycles [in]: latency in TSC cycles
+ * @return: bucket index
+ */
+static inline uint32_t simple_fwd_latency_bucket(uint64_t cycles)
+{
+	uint32_t msb;
+
+	if (cycles < SIMPLE_FWD_LATENCY_SUB_COUNT)
+		return cycles;
+	msb = 63 - __builtin_clzll(cycles);
+	if (unlikely(msb >= SIMPLE_FWD_LATENCY_MAX_BITS))
+		return SIMPLE_FWD_LATENCY_NB_BUCKETS - 1;
+	return ((msb - SIMPLE_FWD_LATENCY_SUB_BITS + 1) << SIMPLE_FWD_LATENCY_SUB_BITS) +
+	       ((cycles >> (msb - SIMPLE_FWD_LATENCY_SUB_BITS)) & (SIMPLE_FWD_LATENCY_SUB_COUNT - 1));
+}
+
+/*
+ * Records a latency, from the lcore owning the histogram only
+ *
+ * @hist [in/out]: histogram of the calling lcore
+ * @cycles [in]: latency in TSC cycles
+ */
+static inline void simple_fwd_latency_record(struct simple_fwd_latency_hist *hist, uint64_t cycles)
+{
+	uint64_t *bucket = &hist->buckets[simple_fwd_latency_bucket(cycles)];
+
+	/* single writer, the atomic stores only keep the reporter from seeing torn values */
+	__atomic_store_n(bucket, *bucket + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&hist->count, hist->count + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&hist->sum, hist->sum + cycles, __ATOMIC_RELAXED);
+	if (cycles > hist->max)
+		__atomic_store_n(&hist->max, cycles, __ATOMIC_RELAXED);
+}
+
+/*
+ * Records the latency segments of a sampled packet once sent, from the lcore owning the histograms
+ *
+ * @lat [in/out]: histograms of the calling lcore
+ * @port_id [in]: RX port of the packet
+ * @tc [in]: traffic class of the packet
+ * @ts [in]: timestamps of the packet
+ * @tx_tsc [in]: TSC at the return of the TX burst that sent the packet
+ */
+static inline void simple_fwd_latency_record_pkt(struct simple_fwd_latency_lcore *lat,
+						 uint16_t port_id,
+						 uint8_t tc,
+						 const struct simple_fwd_latency_ts *ts,
+						 uint64_t tx_tsc)
+{
+	struct simple_fwd_latency_hist *hist = lat->hist[port_id][tc];
+
+	simple_fwd_latency_record(&hist[SIMPLE_FWD_LATENCY_SEG_RX], ts->enq - ts->rx);
+	if (ts->deq != 0) {
+		simple_fwd_latency_record(&hist[SIMPLE_FWD_LATENCY_SEG_RING], ts->deq - ts->enq);
+		simple_fwd_latency_record(&hist[SIMPLE_FWD_LATENCY_SEG_TX], tx_tsc - ts->deq);
+	} else
+		simple_fwd_latency_record(&hist[SIMPLE_FWD_LATENCY_SEG_TX], tx_tsc - ts->enq);
+	simple_fwd_latency_record(&hist[SIMPLE_FWD_LATENCY_SEG_TOTAL], tx_tsc - ts->rx);
+}
+
+/*
+ * Returns the RX timestamp of a packet: the NIC one converted to TSC when the port stamped it, the software
+ * one otherwise
+ *
+ * @hw [in]: hardware timestamps state of the calling lcore
+ * @m [in]: received packet
+ * @sw_tsc [in]: TSC at the return of the RX burst
+ * @return: RX timestamp in TSC cycles
+ */
+static inline uint64_t simple_fwd_latency_rx_tsc(const struct simple_fwd_latency_hw *hw,
+						 const struct rte_mbuf *m,
+						 uint64_t sw_tsc)
+{
+	const struct simple_fwd_latency_clock *clock;
+	int64_t ticks;
+	uint64_t tsc;
+
+	if (hw->ts_offset < 0 || !(m->ol_flags & hw->ts_flag))
+		return sw_tsc;
+	clock = &hw->clock[m->port];
+	if (unlikely(!clock->hw))
+		return sw_tsc;
+	ticks = (int64_t)(*RTE_MBUF_DYNFIELD(m, hw->ts_offset, rte_mbuf_timestamp_t *) - clock->dev_ref);
+	tsc = clock->tsc_ref + (int64_t)((double)ticks * clock->tsc_per_tick);
+	/* the conversion error must not stamp a packet after its RX burst, nor mark it as not sampled */
+	return tsc != 0 && tsc <= sw_tsc ? tsc : sw_tsc;
+}
+
+/*
+ * Registers the RX timestamp dynamic field, before the ports are configured so they enable the timestamp
+ * offload
+ *
+ * @return: 0 on success and negative value otherwise
+ */
+int simple_fwd_latency_hw_register(void);
+
+/*
+ * Checks which ports stamp the packets they receive and calibrates their clocks, once the ports started.
+ * The other ports fall back to software timestamps.
+ *
+ * @nb_ports [in]: number of ports
+ */
+void simple_fwd_latency_hw_init(uint16_t nb_ports);
+
+/*
+ * Copies the hardware timestamps state, for an lcore to convert and synchronize on its own
+ *
+ * @hw [out]: hardware timestamps state of the calling lcore
+ */
+void simple_fwd_latency_hw_get(struct simple_fwd_latency_hw *hw);
+
+/*
+ * Synchronizes the device clocks of an lcore with the TSC again, correcting their drift
+ *
+ * @hw [in/out]: hardware timestamps state of the calling lcore
+ * @now [in]: current TSC
+ */
+void simple_fwd_latency_hw_sync(struct simple_fwd_latency_hw *hw, uint64_t now);
+
+/*
+ * Allocates the latency histograms of an lcore on its NUMA node, from the main lcore before the launch
+ *
+ * @lcore_id [in]: lcore identifier
+ * @return: histograms of the lcore, NULL on failure
+ */
+struct simple_fwd_latency_lcore *simple_fwd_latency_lcore_init(unsigned int lcore_id);
+
+/*
+ * Returns the latency histograms of an lcore
+ *
+ * @lcore_id [in]: lcore identifier
+ * @return: histograms of the lcore, NULL when not allocated
+ */
+struct simple_fwd_latency_lcore *simple_fwd_latency_lcore_get(unsigned int lcore_id);
+
+/*
+ * Sums the histograms of a port, class and segment over all the lcores, while the lcores keep recording
+ *
+ * @port_id [in]: RX port identifier
+ * @tc [in]: traffic class
+ * @seg [in]: latency segment
+ * @total [out]: merged histogram
+ */
+void simple_fwd_latency_merge(uint16_t port_id,
+			      uint8_t tc,
+			      enum simple_fwd_latency_seg seg,
+			      struct simple_fwd_latency_hist *total);
+
+/*
+ * Returns the name of a latency segment
+ *
+ * @seg [in]: latency segment
+ * @return: name of the segment
+ */
+const char *simple_fwd_latency_seg_name(enum simple_fwd_latency_seg seg);
+
+/*
+ * Returns a percentile of a histogram, the upper bound of the bucket holding it
+ *
+ * @hist [in]: histogram
+ * @quantile [in]: quantile, between 0 and 1
+ * @return: percentile in TSC cycles, 0 for an empty histogram
+ */
+uint64_t simple_fwd_latency_percentile(const struct simple_fwd_latency_hist *hist, double quantile);
+
+/*
+ * Converts TSC cycles to nanoseconds
+ *
+ * @cycles [in]: TSC cycles
+ * @return: nanoseconds
+ */
+uint64_t simple_fwd_latency_cycles_to_ns(uint64_t cycles);
+
+/*
+ * Logs the p50, p99, p99.9 and max latencies of every segment, for every port and class that recorded
+ * any
+ */
+void simple_fwd_latency_dump(void);
+
+/*
+ * Frees the histograms of all the lcores, once they stopped
+ */
+void simple_fwd_latency_destroy(void);
+
+#endif /* SIMPLE_FWD_LATENCY_H_ */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <doca_log.h>
+
+#include "simple_fwd_pipeline.h"
+
+DOCA_LOG_REGISTER(SIMPLE_FWD_PIPELINE);
+
+/* Stages chained by the RX lcores, set before the launch and read only afterwards */
+struct pipeline_chain {
+	uint16_t nb_stages;					  /* Chained stages */
+	const struct app_vnf_stage *stages[APP_VNF_MAX_STAGES]; /* Stages, in order */
+};
+
+static struct pipeline_chain pipeline_chain;
+
+int simple_fwd_pipeline_add(const struct app_vnf_stage *stage)
+{
+	if (stage->process_burst == NULL) {
+		DOCA_LOG_ERR("Stage %s does not process packets", stage->name);
+		return -1;
+	}
+	if (pipeline_chain.nb_stages == APP_VNF_MAX_STAGES) {
+		DOCA_LOG_ERR("Cannot chain stage %s, at most %d stages", stage->name, APP_VNF_MAX_STAGES);
+		return -1;
+	}
+	pipeline_chain.stages[pipeline_chain.nb_stages++] = stage;
+	DOCA_LOG_DBG("Stage %u: %s", pipeline_chain.nb_stages, stage->name);
+	return 0;
+}
+
+uint16_t simple_fwd_pipeline_nb_stages(void)
+{
+	return pipeline_chain.nb_stages;
+}
+
+const char *simple_fwd_pipeline_stage_name(uint16_t idx)
+{
+	return pipeline_chain.stages[idx]->name;
+}
+
+int simple_fwd_pipeline_lcore_init(struct simple_fwd_pipeline *pipeline, uint32_t lcore_id, uint16_t queue_id)
+{
+	const struct app_vnf_stage *stage;
+	uint16_t i;
+
+	pipeline->nb_stages = 0;
+	pipeline->stats = simple_fwd_stats_get(lcore_id);
+	for (i = 0; i < pipeline_chain.nb_stages; i++) {
+		stage = pipeline_chain.stages[i];
+		pipeline->stages[i] = stage;
+		pipeline->ctx[i] = NULL;
+		if (stage->stage_init != NULL && stage->stage_init(lcore_id, queue_id, &pipeline->ctx[i]) != 0) {
+			DOCA_LOG_ERR("Core %u failed to init stage %s", lcore_id, stage->name);
+			simple_fwd_pipeline_lcore_fini(pipeline);
+			return -1;
+		}
+		pipeline->nb_stages++;
+	}
+	return 0;
+}
+
+void simple_fwd_pipeline_lcore_fini(struct simple_fwd_pipeline *pipeline)
+{
+	uint16_t i;
+
+	for (i = pipeline->nb_stages; i > 0; i--) {
+		if (pipeline->stages[i - 1]->stage_fini != NULL)
+			pipeline->stages[i - 1]->stage_fini(pipeline->ctx[i - 1]);
+	}
+	pipeline->nb_stages = 0;
+}
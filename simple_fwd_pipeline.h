@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SIMPLE_FWD_PIPELINE_H_
+#define SIMPLE_FWD_PIPELINE_H_
+
+#include <stdint.h>
+
+#include <rte_cycles.h>
+
+#include "app_vnf.h"
+#include "simple_fwd_stats.h"
+
+/* Stages chained by an RX lcore, with their state on the lcore */
+struct simple_fwd_pipeline {
+	uint16_t nb_stages;					  /* Chained stages */
+	const struct app_vnf_stage *stages[APP_VNF_MAX_STAGES]; /* Stages, in order */
+	void *ctx[APP_VNF_MAX_STAGES];				  /* State of every stage on the lcore */
+	struct simple_fwd_lcore_stats *stats;			  /* Counters of the lcore */
+};
+
+/*
+ * Appends a stage to the chain of the RX lcores, from the main lcore before the launch
+ *
+ * @stage [in]: stage, kept by reference
+ * @return: 0 on success and negative value otherwise
+ */
+int simple_fwd_pipeline_add(const struct app_vnf_stage *stage);
+
+/*
+ * Returns the number of chained stages
+ *
+ * @return: number of stages
+ */
+uint16_t simple_fwd_pipeline_nb_stages(void);
+
+/*
+ * Returns the name of a chained stage
+ *
+ * @idx [in]: position of the stage in the chain
+ * @return: name of the stage
+ */
+const char *simple_fwd_pipeline_stage_name(uint16_t idx);
+
+/*
+ * Creates the state of every chained stage on an RX lcore
+ *
+ * @pipeline [out]: stages of the lcore
+ * @lcore_id [in]: lcore identifier
+ * @queue_id [in]: RX queue of the lcore
+ * @return: 0 on success and negative value otherwise
+ */
+int simple_fwd_pipeline_lcore_init(struct simple_fwd_pipeline *pipeline, uint32_t lcore_id, uint16_t queue_id);
+
+/*
+ * Destroys the state of the stages of an RX lcore
+ *
+ * @pipeline [in]: stages of the lcore
+ */
+void simple_fwd_pipeline_lcore_fini(struct simple_fwd_pipeline *pipeline);
+
+/*
+ * Runs a burst through the chained stages, timing each of them, until a stage keeps no packet
+ *
+ * @pipeline [in]: stages of the calling lcore
+ * @mbufs [in/out]: received packets
+ * @pinfos [out]: info of the packets, filled by the stages
+ * @nb_pkts [in]: number of packets
+ * @start [in]: TSC at the start of the first stage
+ */
+static inline void simple_fwd_pipeline_run(struct simple_fwd_pipeline *pipeline,
+					   struct rte_mbuf **mbufs,
+					   struct simple_fwd_pkt_info *pinfos,
+					   uint16_t nb_pkts,
+					   uint64_t start)
+{
+	struct simple_fwd_lcore_stats *stats = pipeline->stats;
+	uint64_t now;
+	uint16_t i;
+
+	for (i = 0; i < pipeline->nb_stages && nb_pkts != 0; i++) {
+		stats->pipeline_pkts[i] += nb_pkts;
+		nb_pkts = pipeline->stages[i]->process_burst(pipeline->ctx[i], mbufs, pinfos, nb_pkts);
+		now = rte_rdtsc();
+		stats->pipeline_cycles[i] += now - start;
+		start = now;
+	}
+}
+
+#endif /* SIMPLE_FWD_PIPELINE_H_ */
@@ -31,6 +31,7 @@
 #include <rte_gre.h>
 #include <rte_gtp.h>
 #include <rte_vxlan.h>
+#include <rte_geneve.h>
 
 #include <doca_log.h>
 
@@ -40,6 +41,28 @@ DOCA_LOG_REGISTER(SIMPLE_FWD_PKT);
 
 #define GTP_ESPN_FLAGS_ON(p) (p & 0x7) /* A macro for setting GTP ESPN flags on */
 #define GTP_EXT_FLAGS_ON(p) (p & 0x4)  /* A macro for setting GTP EXT flags on */
+#define GTP_MSG_TYPE_GPDU (0xff)       /* GTP-U G-PDU message type, carrying a user packet */
+#define GTP_OPT_LEN (4)                /* Length of the GTP-U sequence, N-PDU and next extension type fields */
+#define GTP_EXT_HDR_NONE (0x00)        /* No more GTP-U extension headers */
+#define GTP_EXT_HDR_PDU_SESSION (0x85) /* GTP-U PDU session container extension header type */
+#define GTP_EXT_HDR_MAX (8)            /* Maximum number of chained GTP-U extension headers to walk */
+#define GTP_QFI_MASK (0x3f)            /* QFI bits of the PDU session container */
+#define VXLAN_FLAGS_VNI (0x08)         /* VXLAN I flag, the VNI field is valid */
+#define VXLAN_GPE_FLAGS_NP (0x04)      /* VXLAN-GPE P flag, the next protocol field is valid */
+#define GRE_OPT_LEN (4)                /* Length of each of the GRE checksum, key and sequence fields */
+#define GRE_PROTO_ERSPAN_II (0x88be)   /* GRE protocol type of ERSPAN type I and II */
+#define GRE_PROTO_ERSPAN_III (0x22eb)  /* GRE protocol type of ERSPAN type III */
+#define ERSPAN_II_HDR_LEN (8)          /* Length of the ERSPAN type II header */
+#define ERSPAN_III_HDR_LEN (12)        /* Length of the ERSPAN type III header */
+#define ERSPAN_III_PLATFORM_LEN (8)    /* Length of the ERSPAN type III platform specific sub-header */
+#define ERSPAN_III_FLAGS_O (0x01)      /* ERSPAN type III O flag, the platform sub-header is present */
+#define ERSPAN_SESSION_MASK (0x3ff)    /* ERSPAN session ID bits */
+#define VLAN_MAX_TAGS (2)              /* Maximum number of stacked VLAN tags walked, QinQ */
+#define VLAN_PCP_SHIFT (13)            /* Offset of the priority code point in the VLAN TCI */
+
+/* A macro that checks whether the IPv4 packet is a fragment, either the MF flag or an offset is set */
+#define SIMPLE_FWD_IPV4_IS_FRAG(h) \
+	(((h)->fragment_offset & RTE_BE16(RTE_IPV4_HDR_MF_FLAG | RTE_IPV4_HDR_OFFSET_MASK)) != 0)
 
 uint8_t *simple_fwd_pinfo_outer_mac_dst(struct simple_fwd_pkt_info *pinfo)
 {
@@ -131,6 +154,40 @@ doca_be16_t simple_fwd_pinfo_outer_dst_port(struct simple_fwd_pkt_info *pinfo)
 	return simple_fwd_pinfo_dst_port(&pinfo->outer);
 }
 
+/*
+ * Walks the Ethernet header and up to two VLAN tags (802.1Q and QinQ)
+ *
+ * @data [in]: packet raw data, starting at the Ethernet header
+ * @len [in]: length of the packet raw data in bytes
+ * @ether_type [out]: ether type following the VLAN tags, in CPU order
+ * @pcp [out]: priority of the outermost VLAN tag, 0 if untagged
+ * @return: offset of the L3 header on success, negative value if the frame is truncated
+ */
+static int simple_fwd_parse_l2(uint8_t *data, int len, uint16_t *ether_type, uint8_t *pcp)
+{
+	struct rte_ether_hdr *eth = (struct rte_ether_hdr *)data;
+	struct rte_vlan_hdr *vlan;
+	int off = sizeof(*eth);
+	int nb_tags;
+
+	if (len < off)
+		return -1;
+	*ether_type = rte_be_to_cpu_16(eth->ether_type);
+	*pcp = 0;
+	for (nb_tags = 0; nb_tags < VLAN_MAX_TAGS; nb_tags++) {
+		if (*ether_type != RTE_ETHER_TYPE_VLAN && *ether_type != RTE_ETHER_TYPE_QINQ)
+			break;
+		if (len < off + (int)sizeof(*vlan))
+			return -1;
+		vlan = (struct rte_vlan_hdr *)(data + off);
+		if (nb_tags == 0)
+			*pcp = rte_be_to_cpu_16(vlan->vlan_tci) >> VLAN_PCP_SHIFT;
+		*ether_type = rte_be_to_cpu_16(vlan->eth_proto);
+		off += sizeof(*vlan);
+	}
+	return off;
+}
+
 /*
  * Parse the packet and set the packet format as represented in the application
  *
@@ -142,28 +199,28 @@ doca_be16_t simple_fwd_pinfo_outer_dst_port(struct simple_fwd_pkt_info *pinfo)
  */
 static int simple_fwd_parse_pkt_format(uint8_t *data, int len, bool l2, struct simple_fwd_pkt_format *fmt)
 {
-	struct rte_ether_hdr *eth = NULL;
 	struct rte_ipv4_hdr *iphdr;
+	uint16_t ether_type;
 	int l3_off = 0;
 	int l4_off = 0;
 	int l7_off = 0;
 
 	fmt->l2 = data;
+	fmt->pcp = 0;
 	if (l2) {
-		eth = (struct rte_ether_hdr *)data;
-		fmt->l2 = data;
-		switch (rte_be_to_cpu_16(eth->ether_type)) {
+		l3_off = simple_fwd_parse_l2(data, len, &ether_type, &fmt->pcp);
+		if (l3_off < 0)
+			return -1;
+		switch (ether_type) {
 		case RTE_ETHER_TYPE_IPV4:
-			l3_off = sizeof(struct rte_ether_hdr);
 			break;
 		case RTE_ETHER_TYPE_IPV6:
-			l3_off = sizeof(struct rte_ether_hdr);
 			fmt->l3_type = IPV6;
 			return -1;
 		case RTE_ETHER_TYPE_ARP:
 			return -1;
 		default:
-			DOCA_LOG_WARN("Unsupported L2 type 0x%x", eth->ether_type);
+			DOCA_LOG_WARN("Unsupported L2 type 0x%x", ether_type);
 			return -1;
 		}
 	}
@@ -177,6 +234,14 @@ static int simple_fwd_parse_pkt_format(uint8_t *data, int len, bool l2, struct s
 	fmt->l3_type = IPV4;
 	l4_off = l3_off + rte_ipv4_hdr_len(iphdr);
 	fmt->l4 = data + l4_off;
+	fmt->frag = SIMPLE_FWD_IPV4_IS_FRAG(iphdr);
+	fmt->tcp_flags = 0;
+	if (fmt->frag) {
+		/* only the first fragment has an L4 header, all fragments are classified by L3 */
+		fmt->l4_type = iphdr->next_proto_id;
+		fmt->l7 = NULL;
+		return 0;
+	}
 	switch (iphdr->next_proto_id) {
 	case DOCA_FLOW_PROTO_TCP: {
 		struct rte_tcp_hdr *tcphdr = (struct rte_tcp_hdr *)(data + l4_off);
@@ -185,6 +250,7 @@ static int simple_fwd_parse_pkt_format(uint8_t *data, int len, bool l2, struct s
 		if (l7_off > len)
 			return -1;
 		fmt->l4_type = DOCA_FLOW_PROTO_TCP;
+		fmt->tcp_flags = tcphdr->tcp_flags;
 		fmt->l7 = (data + l7_off);
 		break;
 	}
@@ -212,32 +278,133 @@ static int simple_fwd_parse_pkt_format(uint8_t *data, int len, bool l2, struct s
 }
 
 /*
- * Parse the packet tunneling info
+ * Walk the GTP-U extension headers chain
  *
+ * @ext [in]: pointer to the first extension header
+ * @end [in]: pointer to the end of the packet raw data
+ * @next_type [in]: type of the first extension header, as found in the GTP-U optional fields
  * @pinfo [in/out]: the packet representation in the application
- * @return: 0 on success, negative value otherwise
+ * @return: total length of the extension headers in bytes, negative value otherwise
  */
-static int simple_fwd_parse_is_tun(struct simple_fwd_pkt_info *pinfo)
+static int simple_fwd_parse_gtp_ext(uint8_t *ext, uint8_t *end, uint8_t next_type, struct simple_fwd_pkt_info *pinfo)
 {
-	if (pinfo->outer.l3_type != IPV4)
+	int off = 0;
+	int hdr_len;
+	int i;
+
+	for (i = 0; next_type != GTP_EXT_HDR_NONE && i < GTP_EXT_HDR_MAX; i++) {
+		if (ext + off + 1 > end)
+			return -1;
+		/* extension header length is in 4 bytes units, and includes the next type byte */
+		hdr_len = ext[off] * 4;
+		if (hdr_len == 0 || ext + off + hdr_len > end)
+			return -1;
+		if (next_type == GTP_EXT_HDR_PDU_SESSION && hdr_len >= 4)
+			pinfo->tun.gtp_qfi = ext[off + 2] & GTP_QFI_MASK;
+		next_type = ext[off + hdr_len - 1];
+		off += hdr_len;
+	}
+	if (next_type != GTP_EXT_HDR_NONE)
+		return -1;
+	return off;
+}
+
+/*
+ * Parse the GRE header, its optional checksum, key and sequence fields in any combination and
+ * the ERSPAN header when the GRE payload is a mirrored frame
+ *
+ * @pinfo [in/out]: the packet representation in the application
+ * @end [in]: pointer to the end of the packet raw data
+ * @return: offset of the inner packet from the outer layer 4 on success, 0 if not a tunnel, negative value otherwise
+ */
+static int simple_fwd_parse_gre(struct simple_fwd_pkt_info *pinfo, uint8_t *end)
+{
+	struct rte_gre_hdr *gre_hdr = (struct rte_gre_hdr *)pinfo->outer.l4;
+	uint8_t *gre = pinfo->outer.l4;
+	int off = sizeof(*gre_hdr);
+
+	if (gre + off > end)
+		return -1;
+	/* version 1 is the PPTP enhanced GRE, which has no inner packet to forward */
+	if (gre_hdr->ver != 0)
 		return 0;
 
-	if (pinfo->outer.l4_type == DOCA_FLOW_PROTO_GRE) {
-		int optional_off = 0;
-		struct rte_gre_hdr *gre_hdr = (struct rte_gre_hdr *)pinfo->outer.l4;
-		if (gre_hdr->c)
+	/* optional fields are always ordered checksum, key, sequence, each 4 bytes long */
+	if (gre_hdr->c)
+		off += GRE_OPT_LEN;
+	pinfo->tun.gre_key = 0;
+	pinfo->tun.gre_key_present = gre_hdr->k;
+	if (gre_hdr->k) {
+		if (gre + off + GRE_OPT_LEN > end)
 			return -1;
-		if (gre_hdr->k) {
-			optional_off += 4;
-			pinfo->tun.gre_key = *(uint32_t *)(pinfo->outer.l4 + sizeof(struct rte_gre_hdr));
-			pinfo->tun.l2 = true;
+		pinfo->tun.gre_key = *(doca_be32_t *)(gre + off);
+		off += GRE_OPT_LEN;
+	}
+	if (gre_hdr->s)
+		off += GRE_OPT_LEN;
+	if (gre + off > end)
+		return -1;
+
+	pinfo->tun.proto = gre_hdr->proto;
+	pinfo->tun.erspan_ver = 0;
+	pinfo->tun.erspan_session = 0;
+	switch (rte_be_to_cpu_16(gre_hdr->proto)) {
+	case RTE_ETHER_TYPE_IPV4:
+		pinfo->tun.l2 = false;
+		break;
+	case RTE_ETHER_TYPE_TEB:
+		/* NVGRE and L2 GRE, the key holds the VSID and flow ID for NVGRE */
+		pinfo->tun.l2 = true;
+		break;
+	case GRE_PROTO_ERSPAN_II:
+		pinfo->tun.l2 = true;
+		/* type I has no sequence number and no ERSPAN header */
+		if (!gre_hdr->s) {
+			pinfo->tun.erspan_ver = 1;
+			break;
 		}
-		if (gre_hdr->s)
-			optional_off += 4;
-		pinfo->tun_type = DOCA_FLOW_TUN_GRE;
-		pinfo->tun.proto = gre_hdr->proto;
-		return sizeof(struct rte_gre_hdr) + optional_off;
+		if (gre + off + ERSPAN_II_HDR_LEN > end)
+			return -1;
+		pinfo->tun.erspan_ver = 2;
+		pinfo->tun.erspan_session = rte_be_to_cpu_16(*(doca_be16_t *)(gre + off + 2)) & ERSPAN_SESSION_MASK;
+		off += ERSPAN_II_HDR_LEN;
+		break;
+	case GRE_PROTO_ERSPAN_III:
+		if (gre + off + ERSPAN_III_HDR_LEN > end)
+			return -1;
+		pinfo->tun.l2 = true;
+		pinfo->tun.erspan_ver = 3;
+		pinfo->tun.erspan_session = rte_be_to_cpu_16(*(doca_be16_t *)(gre + off + 2)) & ERSPAN_SESSION_MASK;
+		/* the O flag announces the optional platform specific sub-header */
+		if (gre[off + ERSPAN_III_HDR_LEN - 1] & ERSPAN_III_FLAGS_O)
+			off += ERSPAN_III_PLATFORM_LEN;
+		off += ERSPAN_III_HDR_LEN;
+		if (gre + off > end)
+			return -1;
+		break;
+	default:
+		DOCA_LOG_DBG("Unsupported GRE protocol 0x%x", rte_be_to_cpu_16(gre_hdr->proto));
+		return 0;
 	}
+	pinfo->tun_type = DOCA_FLOW_TUN_GRE;
+	return off;
+}
+
+/*
+ * Parse the packet tunneling info
+ *
+ * @pinfo [in/out]: the packet representation in the application
+ * @return: offset of the inner packet from the outer layer 4 on success, 0 if not a tunnel, negative value otherwise
+ */
+static int simple_fwd_parse_is_tun(struct simple_fwd_pkt_info *pinfo)
+{
+	uint8_t *end = pinfo->outer.l2 + pinfo->len;
+
+	if (pinfo->outer.l3_type != IPV4)
+		return 0;
+
+	if (pinfo->outer.l4_type == DOCA_FLOW_PROTO_GRE)
+		return simple_fwd_parse_gre(pinfo, end);
 
 	if (pinfo->outer.l4_type == DOCA_FLOW_PROTO_UDP) {
 		struct rte_udp_hdr *udphdr = (struct rte_udp_hdr *)pinfo->outer.l4;
@@ -247,26 +414,107 @@ static int simple_fwd_parse_is_tun(struct simple_fwd_pkt_info *pinfo)
 		case DOCA_FLOW_VXLAN_DEFAULT_PORT: {
 			struct rte_vxlan_gpe_hdr *vxlanhdr = (struct rte_vxlan_gpe_hdr *)udp_data;
 
-			if (vxlanhdr->vx_flags & 0x08) {
-				/*need to check if this gpe*/
+			if (udp_data + sizeof(*vxlanhdr) > end)
+				return -1;
+			if (vxlanhdr->vx_flags & VXLAN_FLAGS_VNI) {
 				pinfo->tun_type = DOCA_FLOW_TUN_VXLAN;
 				pinfo->tun.vni = vxlanhdr->vx_vni;
+				pinfo->tun.vxlan_gpe_proto = 0;
 				pinfo->tun.l2 = true;
 			}
 			return sizeof(struct rte_vxlan_gpe_hdr) + sizeof(struct rte_udp_hdr);
 		}
+		case RTE_VXLAN_GPE_DEFAULT_PORT: {
+			struct rte_vxlan_gpe_hdr *gpehdr = (struct rte_vxlan_gpe_hdr *)udp_data;
+			bool l2;
+
+			if (udp_data + sizeof(*gpehdr) > end)
+				return -1;
+			if (!(gpehdr->vx_flags & VXLAN_FLAGS_VNI) || !(gpehdr->vx_flags & VXLAN_GPE_FLAGS_NP))
+				return 0;
+			switch (gpehdr->proto) {
+			case RTE_VXLAN_GPE_TYPE_ETH:
+				l2 = true;
+				break;
+			case RTE_VXLAN_GPE_TYPE_IPV4:
+				l2 = false;
+				break;
+			default:
+				DOCA_LOG_DBG("Unsupported VXLAN-GPE next protocol %u", gpehdr->proto);
+				return 0;
+			}
+			pinfo->tun_type = DOCA_FLOW_TUN_VXLAN;
+			pinfo->tun.vni = gpehdr->vx_vni;
+			pinfo->tun.vxlan_gpe_proto = gpehdr->proto;
+			pinfo->tun.l2 = l2;
+			return sizeof(struct rte_vxlan_gpe_hdr) + sizeof(struct rte_udp_hdr);
+		}
+		case RTE_GENEVE_DEFAULT_PORT: {
+			struct rte_geneve_hdr *genevehdr = (struct rte_geneve_hdr *)udp_data;
+			int opt_len;
+			bool l2;
+
+			if (udp_data + sizeof(*genevehdr) > end)
+				return -1;
+			if (genevehdr->ver != 0)
+				return 0;
+			/* options length is in 4 bytes units, the options TLVs are skipped as a whole */
+			opt_len = genevehdr->opt_len * 4;
+			if (udp_data + sizeof(*genevehdr) + opt_len > end)
+				return -1;
+			switch (rte_be_to_cpu_16(genevehdr->proto)) {
+			case RTE_ETHER_TYPE_TEB:
+				l2 = true;
+				break;
+			case RTE_ETHER_TYPE_IPV4:
+				l2 = false;
+				break;
+			default:
+				DOCA_LOG_DBG("Unsupported Geneve protocol type 0x%x", rte_be_to_cpu_16(genevehdr->proto));
+				return 0;
+			}
+			pinfo->tun_type = DOCA_FLOW_TUN_GENEVE;
+			pinfo->tun.geneve_vni = rte_cpu_to_be_32(((uint32_t)genevehdr->vni[0] << 24) |
+								 ((uint32_t)genevehdr->vni[1] << 16) |
+								 ((uint32_t)genevehdr->vni[2] << 8));
+			pinfo->tun.geneve_proto = genevehdr->proto;
+			pinfo->tun.geneve_opt_len = opt_len;
+			pinfo->tun.l2 = l2;
+			return sizeof(struct rte_geneve_hdr) + opt_len + sizeof(struct rte_udp_hdr);
+		}
 		case DOCA_FLOW_GTPU_DEFAULT_PORT: {
 			int off = sizeof(struct rte_gtp_hdr) + sizeof(struct rte_udp_hdr);
 			struct rte_gtp_hdr *gtphdr = (struct rte_gtp_hdr *)udp_data;
-
-			pinfo->tun_type = DOCA_FLOW_TUN_GTPU;
+			uint8_t *opt = udp_data + sizeof(struct rte_gtp_hdr);
+			int ext_len;
+
+			if (udp_data + sizeof(*gtphdr) > end)
+				return -1;
+			/* only G-PDU messages carry a user packet */
+			if (gtphdr->msg_type != GTP_MSG_TYPE_GPDU)
+				return 0;
 			pinfo->tun.teid = gtphdr->teid;
 			pinfo->tun.gtp_msg_type = gtphdr->msg_type;
 			pinfo->tun.gtp_flags = gtphdr->gtp_hdr_info;
+			pinfo->tun.gtp_qfi = 0;
 			pinfo->tun.l2 = false;
-			if (GTP_ESPN_FLAGS_ON(pinfo->tun.gtp_flags))
-				off += 4;
-			DOCA_LOG_DBG("GTP tun = %u", rte_cpu_to_be_32(pinfo->tun.teid));
+			if (GTP_ESPN_FLAGS_ON(pinfo->tun.gtp_flags)) {
+				/* sequence number, N-PDU number and next extension header type */
+				if (opt + GTP_OPT_LEN > end)
+					return -1;
+				off += GTP_OPT_LEN;
+				if (GTP_EXT_FLAGS_ON(pinfo->tun.gtp_flags)) {
+					ext_len = simple_fwd_parse_gtp_ext(opt + GTP_OPT_LEN,
+									   end,
+									   opt[GTP_OPT_LEN - 1],
+									   pinfo);
+					if (ext_len < 0)
+						return -1;
+					off += ext_len;
+				}
+			}
+			pinfo->tun_type = DOCA_FLOW_TUN_GTPU;
+			DOCA_LOG_DBG("GTP tun = %u qfi = %u", rte_cpu_to_be_32(pinfo->tun.teid), pinfo->tun.gtp_qfi);
 			return off;
 		}
 		default:
@@ -276,7 +524,41 @@ static int simple_fwd_parse_is_tun(struct simple_fwd_pkt_info *pinfo)
 	return 0;
 }
 
-int simple_fwd_parse_packet(uint8_t *data, int len, struct simple_fwd_pkt_info *pinfo)
+/*
+ * Parses the outer L2 and, if requested, the outer IPv4 header without looking at L4
+ *
+ * @data [in]: packet raw data
+ * @len [in]: the length of the packet's raw data in bytes
+ * @level [in]: depth at which the parsing stops, SIMPLE_FWD_PARSE_L2 or SIMPLE_FWD_PARSE_L3_DSCP
+ * @pinfo [out]: extracted packet's info
+ * @return: 0 on success and negative value otherwise
+ */
+static int simple_fwd_parse_outer_l3(uint8_t *data, int len, enum simple_fwd_parse_level level, struct simple_fwd_pkt_info *pinfo)
+{
+	struct rte_ipv4_hdr *iphdr;
+	uint16_t ether_type;
+	int l3_off;
+
+	l3_off = simple_fwd_parse_l2(data, len, &ether_type, &pinfo->outer.pcp);
+	if (l3_off < 0)
+		return -1;
+	pinfo->outer.l2 = data;
+	if (ether_type != RTE_ETHER_TYPE_IPV4)
+		return 0;
+	pinfo->outer.l3 = data + l3_off;
+	pinfo->outer.l3_type = IPV4;
+	if (level == SIMPLE_FWD_PARSE_L2)
+		return 0;
+
+	iphdr = (struct rte_ipv4_hdr *)pinfo->outer.l3;
+	if (len < l3_off + (int)sizeof(*iphdr) || (iphdr->version_ihl >> 4) != 4)
+		return -1;
+	pinfo->tos = iphdr->type_of_service;
+	pinfo->outer.frag = SIMPLE_FWD_IPV4_IS_FRAG(iphdr);
+	return 0;
+}
+
+int simple_fwd_parse_packet_level(uint8_t *data, int len, enum simple_fwd_parse_level level, struct simple_fwd_pkt_info *pinfo)
 {
 	int off = 0;
 	int inner_off = 0;
@@ -286,8 +568,18 @@ int simple_fwd_parse_packet(uint8_t *data, int len, struct simple_fwd_pkt_info *
 		return -1;
 	}
 	pinfo->len = len;
+	pinfo->tun_type = DOCA_FLOW_TUN_NONE;
+	pinfo->outer.l3_type = 0;
+	pinfo->outer.frag = false;
+	if (level <= SIMPLE_FWD_PARSE_L3_DSCP)
+		return simple_fwd_parse_outer_l3(data, len, level, pinfo);
+
 	if (simple_fwd_parse_pkt_format(data, len, true, &pinfo->outer))
 		return -1;
+	pinfo->tos = ((struct rte_ipv4_hdr *)pinfo->outer.l3)->type_of_service;
+	/* the tunnel header is only in the first fragment, keep all of them on the outer flow */
+	if (level == SIMPLE_FWD_PARSE_5TUPLE || pinfo->outer.frag)
+		return 0;
 
 	off = simple_fwd_parse_is_tun(pinfo);
 	if (pinfo->tun_type == DOCA_FLOW_TUN_NONE || off < 0)
@@ -295,17 +587,12 @@ int simple_fwd_parse_packet(uint8_t *data, int len, struct simple_fwd_pkt_info *
 
 	switch (pinfo->tun_type) {
 	case DOCA_FLOW_TUN_GRE:
-		inner_off = (pinfo->outer.l4 - data) + off;
-		if (simple_fwd_parse_pkt_format(data + inner_off, len - inner_off, false, &pinfo->inner))
-			return -1;
-		break;
 	case DOCA_FLOW_TUN_VXLAN:
-		inner_off = (pinfo->outer.l4 - data) + off;
-		if (simple_fwd_parse_pkt_format(data + inner_off, len - inner_off, pinfo->tun.l2, &pinfo->inner))
-			return -1;
-		break;
 	case DOCA_FLOW_TUN_GTPU:
+	case DOCA_FLOW_TUN_GENEVE:
 		inner_off = (pinfo->outer.l4 - data) + off;
+		if (inner_off >= len)
+			return -1;
 		if (simple_fwd_parse_pkt_format(data + inner_off, len - inner_off, pinfo->tun.l2, &pinfo->inner))
 			return -1;
 		break;
@@ -315,6 +602,37 @@ int simple_fwd_parse_packet(uint8_t *data, int len, struct simple_fwd_pkt_info *
 	return 0;
 }
 
+int simple_fwd_parse_packet(uint8_t *data, int len, struct simple_fwd_pkt_info *pinfo)
+{
+	return simple_fwd_parse_packet_level(data, len, SIMPLE_FWD_PARSE_TUNNEL, pinfo);
+}
+
+doca_be32_t simple_fwd_pinfo_tun_id(struct simple_fwd_pkt_info *pinfo)
+{
+	switch (pinfo->tun_type) {
+	case DOCA_FLOW_TUN_VXLAN:
+		return pinfo->tun.vni;
+	case DOCA_FLOW_TUN_GRE:
+		/* ERSPAN sessions are usually not keyed, tell them apart by the session ID */
+		if (!pinfo->tun.gre_key_present)
+			return rte_cpu_to_be_32(pinfo->tun.erspan_session);
+		return pinfo->tun.gre_key;
+	case DOCA_FLOW_TUN_GTPU:
+		return pinfo->tun.teid;
+	case DOCA_FLOW_TUN_GENEVE:
+		return pinfo->tun.geneve_vni;
+	default:
+		return 0;
+	}
+}
+
+uint8_t simple_fwd_pinfo_tcp_flags(struct simple_fwd_pkt_info *pinfo)
+{
+	if (pinfo->tun_type != DOCA_FLOW_TUN_NONE)
+		return pinfo->inner.tcp_flags;
+	return pinfo->outer.tcp_flags;
+}
+
 void simple_fwd_pinfo_decap(struct simple_fwd_pkt_info *pinfo)
 {
 	switch (pinfo->tun_type) {
@@ -46,6 +46,9 @@ struct simple_fwd_pkt_format {
 
 	uint8_t l3_type; /* Layer 2 protocol type */
 	uint8_t l4_type; /* Layer 3 protocol type */
+	bool frag;	 /* IPv4 fragment, L4 header is not parsed and l4 points to the L3 payload */
+	uint8_t tcp_flags; /* TCP flags, 0 if not TCP */
+	uint8_t pcp;	   /* Priority of the outermost VLAN tag, 0 if untagged */
 
 	/* if tunnel it is the internal, if no tunnel then outer*/
 	uint8_t *l7;
@@ -58,22 +61,32 @@ struct simple_fwd_pkt_format {
  */
 struct simple_fwd_pkt_tun_format {
 	bool l2;		      /* Flag representing whether or not layer 2 is found */
-	enum doca_flow_tun_type type; /* Tunneling type (GRE, GTP or VXLAN) */
+	enum doca_flow_tun_type type; /* Tunneling type (GRE, GTP, VXLAN or Geneve) */
 
-	/* Packet's tunneling parsing result represented as either GTP, GRE or VXLAN tunneling */
+	/* Packet's tunneling parsing result represented as either GTP, GRE, VXLAN or Geneve tunneling */
 	union {
 		struct {
-			doca_be32_t vni; /* VXLAN VNI */
+			doca_be32_t vni;	 /* VXLAN VNI */
+			uint8_t vxlan_gpe_proto; /* VXLAN-GPE next protocol, 0 for plain VXLAN */
 		};
 		struct {
-			doca_be32_t gre_key; /* GRE key value */
-			doca_be16_t proto;   /* GRE protocol type */
+			doca_be32_t gre_key;	 /* GRE key value, 0 if absent */
+			doca_be16_t proto;	 /* GRE protocol type */
+			bool gre_key_present;	 /* Whether or not the GRE K bit is set */
+			uint8_t erspan_ver;	 /* ERSPAN type (1, 2 or 3), 0 if not ERSPAN */
+			uint16_t erspan_session; /* ERSPAN session ID, 0 if absent */
 		};
 		struct {
 			uint8_t gtp_msg_type; /* GTP message type */
 			uint8_t gtp_flags;    /* GTP flags */
+			uint8_t gtp_qfi;      /* QoS flow identifier of the PDU session container, 0 if absent */
 			doca_be32_t teid;     /* GTP tied */
 		};
+		struct {
+			doca_be32_t geneve_vni;	/* Geneve VNI, laid out like the VXLAN VNI */
+			doca_be16_t geneve_proto; /* Geneve protocol type of the inner header */
+			uint8_t geneve_opt_len;	/* Length of the Geneve options in bytes */
+		};
 	};
 };
 
@@ -89,11 +102,23 @@ struct simple_fwd_pkt_info {
 	uint32_t rss_hash;   /* RSS hash value */
 
 	struct simple_fwd_pkt_format outer;   /* Outer packet parsing result */
-	enum doca_flow_tun_type tun_type;     /* Tunneling type (GRE, GTP or VXLAN) */
+	enum doca_flow_tun_type tun_type;     /* Tunneling type (GRE, GTP, VXLAN or Geneve) */
 	struct simple_fwd_pkt_tun_format tun; /* Tunneling parsing result*/
 	struct simple_fwd_pkt_format inner;   /* Inner packet parsing result */
 	int len;			      /* Length, in bytes, of the packet */
-    uint8_t tos;
+	uint8_t tos;			      /* Outer IPv4 TOS byte, filled from SIMPLE_FWD_PARSE_L3_DSCP level */
+	void *flow_ctx;			      /* Flow to offload, set by the flow lookup stage, NULL for none */
+};
+
+/*
+ * Depth at which packet parsing stops, ordered from the cheapest to the most expensive.
+ * Each level includes the work of all the levels below it.
+ */
+enum simple_fwd_parse_level {
+	SIMPLE_FWD_PARSE_L2,	  /* Ethernet header only, the outer L3 type is resolved */
+	SIMPLE_FWD_PARSE_L3_DSCP, /* Outer IPv4 header, enough to read the TOS/DSCP byte */
+	SIMPLE_FWD_PARSE_5TUPLE,  /* Outer L3 and L4 headers, tunnels are not looked into */
+	SIMPLE_FWD_PARSE_TUNNEL,  /* Outer, tunnel and inner headers */
 };
 
 /*
@@ -123,6 +148,19 @@ struct simple_fwd_ft_key {
  */
 int simple_fwd_parse_packet(uint8_t *data, int len, struct simple_fwd_pkt_info *pinfo);
 
+/*
+ * Parses the packet only up to the requested depth.
+ * Fields of the packet's info that belong to deeper levels are left untouched, except for the
+ * tunnel type which is always reset, so the same info can be reused between packets.
+ *
+ * @data [in]: packet raw data
+ * @len [in]: the length of the packet's raw data in bytes
+ * @level [in]: depth at which the parsing stops
+ * @pinfo [out]: extracted packet's info
+ * @return: 0 on success and negative value otherwise
+ */
+int simple_fwd_parse_packet_level(uint8_t *data, int len, enum simple_fwd_parse_level level, struct simple_fwd_pkt_info *pinfo);
+
 /*
  * Extracts the outer destination MAC address from the packet's info
  *
@@ -219,6 +257,25 @@ doca_be16_t simple_fwd_pinfo_outer_src_port(struct simple_fwd_pkt_info *pinfo);
  */
 doca_be16_t simple_fwd_pinfo_outer_dst_port(struct simple_fwd_pkt_info *pinfo);
 
+/*
+ * Extracts the tunnel identifier from the packet's info, based on the tunneling type:
+ * VNI for VXLAN and Geneve, key for GRE (ERSPAN session ID when unkeyed) and TEID for GTP
+ *
+ * @pinfo [in]: the packet's info
+ * @return: tunnel identifier, 0 if the packet is not tunneled
+ *
+ * @NOTE: the returned value is converted to big endian
+ */
+doca_be32_t simple_fwd_pinfo_tun_id(struct simple_fwd_pkt_info *pinfo);
+
+/*
+ * Extracts the TCP flags of the flow carried by the packet, the inner one if tunneled
+ *
+ * @pinfo [in]: the packet's info
+ * @return: TCP flags, 0 if the flow is not TCP or the packet is a fragment
+ */
+uint8_t simple_fwd_pinfo_tcp_flags(struct simple_fwd_pkt_info *pinfo);
+
 /*
  * Decap the packet's header if the tunneling is VXLAN
  *
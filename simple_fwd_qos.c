@@ -0,0 +1,955 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_random.h>
+
+#include <doca_log.h>
+
+#include "simple_fwd_qos.h"
+
+DOCA_LOG_REGISTER(SIMPLE_FWD_QOS);
+
+#define DSCP_CLASS_SELECTOR_SHIFT (3) /* DSCP bits dropped to get the class selector (precedence) */
+#define QOS_QUANTUM (RTE_ETHER_MAX_LEN) /* DRR bytes per round of a weight 1 class, at least one full frame */
+#define QOS_WFQ_SCALE (1 << 8)		/* Fixed point scale of the WFQ virtual time */
+#define QOS_DEFAULT_WEIGHT (1)		/* Weight of the classes not configured */
+#define QOS_DEFAULT_STRICT_TC (1)	/* The top class carries voice, never delay it behind bulk traffic */
+#define QOS_BURST_US (1000)		/* Bucket sizes, in microseconds of traffic at the bucket rate */
+#define QOS_MIN_BURST (2 * RTE_ETHER_MAX_LEN) /* Smallest bucket size, a full frame always fits */
+#define QOS_BYTES_PER_MBIT (1000000 / 8) /* Bytes per second of a 1 Mbps rate */
+#define QOS_DEFAULT_RED_MIN_TH (50)	/* Default RED min threshold, percents of the ring */
+#define QOS_DEFAULT_RED_MAX_TH (90)	/* Default RED max threshold, percents of the ring */
+#define QOS_DEFAULT_RED_MAX_P (10)	/* Default RED drop probability at the max threshold, percents */
+#define QOS_DEFAULT_CODEL_TARGET_US (100) /* Default CoDel target, scaled down from RFC 8289 to a DPU hop */
+#define QOS_DEFAULT_CODEL_INTERVAL_US (2000) /* Default CoDel interval, 20 times the target as in RFC 8289 */
+#define QOS_RED_SCALE_SHIFT (10)	/* RED occupancies and probabilities are in 1/1024 */
+#define QOS_RED_WQ_SHIFT (2)		/* RED average weight, 1/4 per burst */
+#define QOS_CODEL_SCALE_SHIFT (16)	/* Fixed point shift of the CoDel control law square root */
+
+/* Names of the drop policies, as given in the configuration */
+static const char *const qos_drop_policy_names[] = {
+	[SIMPLE_FWD_QOS_DROP_TAIL] = "tail",
+	[SIMPLE_FWD_QOS_DROP_HEAD] = "head",
+	[SIMPLE_FWD_QOS_DROP_RED] = "red",
+	[SIMPLE_FWD_QOS_DROP_CODEL] = "codel",
+};
+
+/* Names of the drop reasons, as logged */
+static const char *const qos_drop_reason_names[] = {
+	[SIMPLE_FWD_QOS_DROP_REASON_TAIL] = "tail",
+	[SIMPLE_FWD_QOS_DROP_REASON_HEAD] = "head",
+	[SIMPLE_FWD_QOS_DROP_REASON_RED] = "red",
+	[SIMPLE_FWD_QOS_DROP_REASON_CODEL] = "codel",
+};
+
+/* Drop counters of all the lcores */
+static struct simple_fwd_qos_drop_stats qos_drop_stats[RTE_MAX_LCORE];
+
+/* Shapers of all the classes, shared between the rate limiter and the TX lcores */
+static struct simple_fwd_qos_shaper qos_shapers[NUM_OF_PORTS][SIMPLE_FWD_QOS_NB_TC];
+
+/* Set once a rate limiter lcore refills the shapers, classes cannot be shaped at runtime without it */
+static bool qos_shaper_started;
+
+void simple_fwd_qos_cfg_init(struct simple_fwd_qos_cfg *cfg)
+{
+	int i;
+
+	cfg->source = SIMPLE_FWD_QOS_SRC_DSCP;
+	for (i = 0; i < SIMPLE_FWD_QOS_NB_DSCP; i++)
+		cfg->dscp_to_tc[i] = i >> DSCP_CLASS_SELECTOR_SHIFT;
+	for (i = 0; i < SIMPLE_FWD_QOS_NB_PCP; i++)
+		cfg->pcp_to_tc[i] = i;
+	cfg->sched_mode = SIMPLE_FWD_QOS_SCHED_DRR;
+	cfg->nb_strict_tc = QOS_DEFAULT_STRICT_TC;
+	memset(cfg->weights, QOS_DEFAULT_WEIGHT, sizeof(cfg->weights));
+	for (i = 0; i < SIMPLE_FWD_QOS_NB_TC; i++)
+		cfg->drop_policy[i] = SIMPLE_FWD_QOS_DROP_TAIL;
+	cfg->red.min_th = QOS_DEFAULT_RED_MIN_TH;
+	cfg->red.max_th = QOS_DEFAULT_RED_MAX_TH;
+	cfg->red.max_p = QOS_DEFAULT_RED_MAX_P;
+	cfg->codel.target_us = QOS_DEFAULT_CODEL_TARGET_US;
+	cfg->codel.interval_us = QOS_DEFAULT_CODEL_INTERVAL_US;
+}
+
+doca_error_t simple_fwd_qos_parse_map(const char *map_str, uint8_t *map, int map_size, int max_value)
+{
+	const char *ptr = map_str;
+	char *end;
+	long code_point;
+	long tc;
+
+	while (*ptr != '\0') {
+		errno = 0;
+		code_point = strtol(ptr, &end, 0);
+		if (errno != 0 || end == ptr || *end != ':') {
+			DOCA_LOG_ERR("Invalid QoS mapping \"%s\", expected <index>:<value>", ptr);
+			return DOCA_ERROR_INVALID_VALUE;
+		}
+		ptr = end + 1;
+		tc = strtol(ptr, &end, 0);
+		if (errno != 0 || end == ptr || (*end != ',' && *end != '\0')) {
+			DOCA_LOG_ERR("Invalid QoS mapping value \"%s\"", ptr);
+			return DOCA_ERROR_INVALID_VALUE;
+		}
+		if (code_point < 0 || code_point >= map_size) {
+			DOCA_LOG_ERR("QoS mapping index %ld out of range [0, %d)", code_point, map_size);
+			return DOCA_ERROR_INVALID_VALUE;
+		}
+		if (tc < 0 || tc > max_value) {
+			DOCA_LOG_ERR("QoS mapping value %ld out of range [0, %d]", tc, max_value);
+			return DOCA_ERROR_INVALID_VALUE;
+		}
+		map[code_point] = tc;
+		ptr = (*end == ',') ? end + 1 : end;
+	}
+	return DOCA_SUCCESS;
+}
+
+enum simple_fwd_parse_level simple_fwd_qos_parse_level(const struct simple_fwd_qos_cfg *cfg)
+{
+	switch (cfg->source) {
+	case SIMPLE_FWD_QOS_SRC_PCP:
+		return SIMPLE_FWD_PARSE_L2;
+	case SIMPLE_FWD_QOS_SRC_INNER_DSCP:
+		return SIMPLE_FWD_PARSE_TUNNEL;
+	default:
+		return SIMPLE_FWD_PARSE_L3_DSCP;
+	}
+}
+
+doca_error_t simple_fwd_qos_parse_weights(const char *weights_str, struct simple_fwd_qos_cfg *cfg)
+{
+	char *str, *port_str, *save_ptr;
+	doca_error_t result = DOCA_SUCCESS;
+	int port_id = 0;
+	int tc;
+
+	str = strdup(weights_str);
+	if (str == NULL) {
+		DOCA_LOG_ERR("Failed to allocate QoS weights string");
+		return DOCA_ERROR_NO_MEMORY;
+	}
+	for (port_str = strtok_r(str, ";", &save_ptr); port_str != NULL; port_str = strtok_r(NULL, ";", &save_ptr)) {
+		if (port_id >= NUM_OF_PORTS) {
+			DOCA_LOG_ERR("QoS weights given for more than %d ports", NUM_OF_PORTS);
+			result = DOCA_ERROR_INVALID_VALUE;
+			break;
+		}
+		result = simple_fwd_qos_parse_map(port_str, cfg->weights[port_id], SIMPLE_FWD_QOS_NB_TC, UINT8_MAX);
+		if (result != DOCA_SUCCESS)
+			break;
+		port_id++;
+	}
+	free(str);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	/* a single list applies to all the ports */
+	if (port_id == 1) {
+		for (port_id = 1; port_id < NUM_OF_PORTS; port_id++)
+			memcpy(cfg->weights[port_id], cfg->weights[0], sizeof(cfg->weights[0]));
+	}
+	for (port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+		for (tc = 0; tc < SIMPLE_FWD_QOS_NB_TC; tc++) {
+			if (cfg->weights[port_id][tc] == 0) {
+				DOCA_LOG_ERR("QoS weight of port %d class %d should be >= 1", port_id, tc);
+				return DOCA_ERROR_INVALID_VALUE;
+			}
+		}
+	}
+	return DOCA_SUCCESS;
+}
+
+doca_error_t simple_fwd_qos_parse_rate(const char *entry, uint8_t *class_id, struct simple_fwd_qos_rate *rate)
+{
+	unsigned long tc, cir, pir;
+	char *end;
+
+	errno = 0;
+	tc = strtoul(entry, &end, 0);
+	if (errno != 0 || end == entry || *end != ':' || tc >= SIMPLE_FWD_QOS_NB_TC) {
+		DOCA_LOG_ERR("Invalid QoS rate \"%s\", expected <class>:<cir>[:<pir>]", entry);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	entry = end + 1;
+	cir = strtoul(entry, &end, 0);
+	if (errno != 0 || end == entry || (*end != ':' && *end != '\0')) {
+		DOCA_LOG_ERR("Invalid QoS committed rate \"%s\"", entry);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	pir = cir;
+	if (*end == ':') {
+		entry = end + 1;
+		pir = strtoul(entry, &end, 0);
+		if (errno != 0 || end == entry || *end != '\0' || pir < cir) {
+			DOCA_LOG_ERR("Invalid QoS peak rate \"%s\", should be >= the committed rate", entry);
+			return DOCA_ERROR_INVALID_VALUE;
+		}
+	}
+	*class_id = tc;
+	rate->cir = (uint64_t)cir * QOS_BYTES_PER_MBIT;
+	rate->pir = (uint64_t)pir * QOS_BYTES_PER_MBIT;
+	return DOCA_SUCCESS;
+}
+
+doca_error_t simple_fwd_qos_parse_rates(const char *rates_str, struct simple_fwd_qos_cfg *cfg)
+{
+	char *str, *port_str, *entry, *port_save_ptr, *entry_save_ptr;
+	doca_error_t result = DOCA_SUCCESS;
+	struct simple_fwd_qos_rate rate;
+	int port_id = 0;
+	uint8_t tc;
+
+	str = strdup(rates_str);
+	if (str == NULL) {
+		DOCA_LOG_ERR("Failed to allocate QoS rates string");
+		return DOCA_ERROR_NO_MEMORY;
+	}
+	for (port_str = strtok_r(str, ";", &port_save_ptr); port_str != NULL && result == DOCA_SUCCESS;
+	     port_str = strtok_r(NULL, ";", &port_save_ptr)) {
+		if (port_id >= NUM_OF_PORTS) {
+			DOCA_LOG_ERR("QoS rates given for more than %d ports", NUM_OF_PORTS);
+			result = DOCA_ERROR_INVALID_VALUE;
+			break;
+		}
+		for (entry = strtok_r(port_str, ",", &entry_save_ptr); entry != NULL && result == DOCA_SUCCESS;
+		     entry = strtok_r(NULL, ",", &entry_save_ptr)) {
+			result = simple_fwd_qos_parse_rate(entry, &tc, &rate);
+			if (result == DOCA_SUCCESS)
+				cfg->rates[port_id][tc] = rate;
+		}
+		port_id++;
+	}
+	free(str);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	/* a single list applies to all the ports */
+	if (port_id == 1) {
+		for (port_id = 1; port_id < NUM_OF_PORTS; port_id++)
+			memcpy(cfg->rates[port_id], cfg->rates[0], sizeof(cfg->rates[0]));
+	}
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Looks up a drop policy by name
+ *
+ * @name [in]: policy name
+ * @len [in]: length of the name
+ * @policy [out]: drop policy
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t qos_drop_policy_lookup(const char *name, size_t len, enum simple_fwd_qos_drop_policy *policy)
+{
+	int i;
+
+	for (i = 0; i < (int)RTE_DIM(qos_drop_policy_names); i++) {
+		if (strlen(qos_drop_policy_names[i]) == len && strncmp(name, qos_drop_policy_names[i], len) == 0) {
+			*policy = i;
+			return DOCA_SUCCESS;
+		}
+	}
+	DOCA_LOG_ERR("Invalid drop policy \"%.*s\", should be tail, head, red or codel", (int)len, name);
+	return DOCA_ERROR_INVALID_VALUE;
+}
+
+doca_error_t simple_fwd_qos_parse_drop_policy(const char *policy_str, struct simple_fwd_qos_cfg *cfg)
+{
+	enum simple_fwd_qos_drop_policy policy;
+	const char *ptr = policy_str;
+	doca_error_t result;
+	unsigned long tc;
+	size_t len;
+	char *end;
+	int i;
+
+	/* a single policy applies to all the classes */
+	if (strchr(policy_str, ':') == NULL) {
+		result = qos_drop_policy_lookup(policy_str, strlen(policy_str), &policy);
+		if (result != DOCA_SUCCESS)
+			return result;
+		for (i = 0; i < SIMPLE_FWD_QOS_NB_TC; i++)
+			cfg->drop_policy[i] = policy;
+		return DOCA_SUCCESS;
+	}
+	while (*ptr != '\0') {
+		errno = 0;
+		tc = strtoul(ptr, &end, 0);
+		if (errno != 0 || end == ptr || *end != ':' || tc >= SIMPLE_FWD_QOS_NB_TC) {
+			DOCA_LOG_ERR("Invalid drop policy \"%s\", expected <class>:<policy>", ptr);
+			return DOCA_ERROR_INVALID_VALUE;
+		}
+		ptr = end + 1;
+		len = strcspn(ptr, ",");
+		result = qos_drop_policy_lookup(ptr, len, &cfg->drop_policy[tc]);
+		if (result != DOCA_SUCCESS)
+			return result;
+		ptr += len;
+		if (*ptr == ',')
+			ptr++;
+	}
+	return DOCA_SUCCESS;
+}
+
+doca_error_t simple_fwd_qos_parse_red(const char *red_str, struct simple_fwd_qos_cfg *cfg)
+{
+	unsigned int min_th, max_th, max_p;
+	char extra;
+
+	if (sscanf(red_str, "%u:%u:%u%c", &min_th, &max_th, &max_p, &extra) != 3 || min_th >= max_th ||
+	    max_th > 100 || max_p > 100) {
+		DOCA_LOG_ERR("Invalid RED parameters \"%s\", expected <min>:<max>:<max_p> with min < max <= 100", red_str);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	cfg->red.min_th = min_th;
+	cfg->red.max_th = max_th;
+	cfg->red.max_p = max_p;
+	return DOCA_SUCCESS;
+}
+
+doca_error_t simple_fwd_qos_parse_codel(const char *codel_str, struct simple_fwd_qos_cfg *cfg)
+{
+	unsigned int target_us, interval_us;
+	char extra;
+
+	if (sscanf(codel_str, "%u:%u%c", &target_us, &interval_us, &extra) != 2 || target_us == 0 ||
+	    interval_us < target_us) {
+		DOCA_LOG_ERR("Invalid CoDel parameters \"%s\", expected <target>:<interval> with target <= interval",
+			     codel_str);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	cfg->codel.target_us = target_us;
+	cfg->codel.interval_us = interval_us;
+	return DOCA_SUCCESS;
+}
+
+struct simple_fwd_qos_drop_stats *simple_fwd_qos_drop_stats_get(unsigned int lcore_id)
+{
+	return &qos_drop_stats[lcore_id];
+}
+
+const char *simple_fwd_qos_drop_reason_name(enum simple_fwd_qos_drop_reason reason)
+{
+	return qos_drop_reason_names[reason];
+}
+
+void simple_fwd_qos_dump_drops(void)
+{
+	uint64_t total;
+	int lcore_id, reason;
+
+	for (reason = 0; reason < SIMPLE_FWD_QOS_DROP_REASON_MAX; reason++) {
+		total = 0;
+		for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++)
+			total += __atomic_load_n(&qos_drop_stats[lcore_id].pkts[reason], __ATOMIC_RELAXED);
+		DOCA_LOG_INFO("QoS %s drops: %lu", qos_drop_reason_names[reason], total);
+	}
+}
+
+void simple_fwd_qos_enq_init(struct simple_fwd_qos_enq *enq, const struct simple_fwd_qos_cfg *cfg)
+{
+	memset(enq, 0, sizeof(*enq));
+	memcpy(enq->policy, cfg->drop_policy, sizeof(enq->policy));
+	enq->red_min_th = ((uint32_t)cfg->red.min_th << QOS_RED_SCALE_SHIFT) / 100;
+	enq->red_max_th = ((uint32_t)cfg->red.max_th << QOS_RED_SCALE_SHIFT) / 100;
+	enq->red_max_p = ((uint32_t)cfg->red.max_p << QOS_RED_SCALE_SHIFT) / 100;
+	enq->drops = simple_fwd_qos_drop_stats_get(rte_lcore_id());
+}
+
+/*
+ * Counts dropped packets of the calling lcore
+ *
+ * @drops [in]: drop counters of the calling lcore
+ * @reason [in]: drop reason
+ * @nb [in]: number of dropped packets
+ */
+static inline void qos_count_drops(struct simple_fwd_qos_drop_stats *drops,
+				   enum simple_fwd_qos_drop_reason reason,
+				   uint64_t nb)
+{
+	/* single writer, the atomic store only keeps the readers from seeing torn values */
+	__atomic_store_n(&drops->pkts[reason], drops->pkts[reason] + nb, __ATOMIC_RELAXED);
+}
+
+/*
+ * Drops packets of a burst early, with a probability growing linearly from 0 at the min threshold
+ * to max_p at the max threshold of the ring average occupancy, and all of them above it
+ *
+ * @enq [in]: enqueue state of the calling lcore
+ * @port_id [in]: port the ring belongs to
+ * @tc [in]: traffic class of the packets
+ * @ring [in]: ring of the class
+ * @mbufs [in/out]: packets to filter, compacted in place
+ * @nb [in]: number of packets
+ * @return: number of packets kept
+ */
+static uint16_t qos_red_filter(struct simple_fwd_qos_enq *enq,
+			       uint16_t port_id,
+			       uint8_t tc,
+			       struct rte_ring *ring,
+			       struct rte_mbuf **mbufs,
+			       uint16_t nb)
+{
+	uint32_t occupancy = (rte_ring_count(ring) << QOS_RED_SCALE_SHIFT) / rte_ring_get_capacity(ring);
+	uint32_t *avg = &enq->red_avg[port_id][tc];
+	uint16_t nb_kept = 0;
+	uint32_t prob;
+	uint16_t i;
+
+	*avg = (int32_t)*avg + (((int32_t)occupancy - (int32_t)*avg) >> QOS_RED_WQ_SHIFT);
+	if (*avg < enq->red_min_th)
+		return nb;
+	if (*avg >= enq->red_max_th) {
+		rte_pktmbuf_free_bulk(mbufs, nb);
+		qos_count_drops(enq->drops, SIMPLE_FWD_QOS_DROP_REASON_RED, nb);
+		return 0;
+	}
+	prob = enq->red_max_p * (*avg - enq->red_min_th) / (enq->red_max_th - enq->red_min_th);
+	for (i = 0; i < nb; i++) {
+		if ((rte_rand() & ((1 << QOS_RED_SCALE_SHIFT) - 1)) < prob) {
+			rte_pktmbuf_free(mbufs[i]);
+			continue;
+		}
+		mbufs[nb_kept++] = mbufs[i];
+	}
+	qos_count_drops(enq->drops, SIMPLE_FWD_QOS_DROP_REASON_RED, nb - nb_kept);
+	return nb_kept;
+}
+
+void simple_fwd_qos_enqueue(struct simple_fwd_qos_enq *enq,
+			    uint16_t port_id,
+			    uint8_t tc,
+			    struct rte_ring *ring,
+			    struct rte_mbuf **mbufs,
+			    uint16_t nb)
+{
+	struct rte_mbuf *old_mbufs[SIMPLE_FWD_QOS_STAGE_SIZE];
+	unsigned int nb_enq, nb_old;
+
+	if (enq->policy[tc] == SIMPLE_FWD_QOS_DROP_RED) {
+		nb = qos_red_filter(enq, port_id, tc, ring, mbufs, nb);
+		if (nb == 0)
+			return;
+	}
+	nb_enq = rte_ring_enqueue_burst(ring, (void **)mbufs, nb, NULL);
+	if (likely(nb_enq == nb))
+		return;
+
+	/* head drop costs an extra dequeue, only pay it when asked to */
+	if (enq->policy[tc] == SIMPLE_FWD_QOS_DROP_HEAD) {
+		nb_old = rte_ring_dequeue_burst(ring, (void **)old_mbufs, RTE_MIN(nb - nb_enq, RTE_DIM(old_mbufs)), NULL);
+		rte_pktmbuf_free_bulk(old_mbufs, nb_old);
+		qos_count_drops(enq->drops, SIMPLE_FWD_QOS_DROP_REASON_HEAD, nb_old);
+		nb_enq += rte_ring_enqueue_burst(ring, (void **)&mbufs[nb_enq], nb - nb_enq, NULL);
+		if (nb_enq == nb)
+			return;
+	}
+	rte_pktmbuf_free_bulk(&mbufs[nb_enq], nb - nb_enq);
+	qos_count_drops(enq->drops, SIMPLE_FWD_QOS_DROP_REASON_TAIL, nb - nb_enq);
+}
+
+/*
+ * Sets the rate of a token bucket, and its size from the rate
+ *
+ * @tb [in]: token bucket
+ * @rate [in]: rate in bytes per second, 0 to stop using the bucket
+ */
+static void qos_tb_set_rate(struct simple_fwd_qos_tb *tb, uint64_t rate)
+{
+	int64_t size = RTE_MAX((int64_t)(rate * QOS_BURST_US / US_PER_S), (int64_t)QOS_MIN_BURST);
+
+	__atomic_store_n(&tb->size, size, __ATOMIC_RELAXED);
+	__atomic_store_n(&tb->rate, rate, __ATOMIC_RELEASE);
+}
+
+bool simple_fwd_qos_shaper_init(const struct simple_fwd_qos_cfg *cfg)
+{
+	struct simple_fwd_qos_shaper *shaper;
+	uint64_t now = rte_rdtsc();
+	bool shaping = false;
+	int port_id, tc;
+
+	for (port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+		for (tc = 0; tc < SIMPLE_FWD_QOS_NB_TC; tc++) {
+			shaper = &qos_shapers[port_id][tc];
+			qos_tb_set_rate(&shaper->committed, cfg->rates[port_id][tc].cir);
+			qos_tb_set_rate(&shaper->peak, cfg->rates[port_id][tc].pir);
+			shaper->committed.tokens = shaper->committed.size;
+			shaper->peak.tokens = shaper->peak.size;
+			shaper->committed.last = now;
+			shaper->peak.last = now;
+			if (cfg->rates[port_id][tc].pir != 0)
+				shaping = true;
+		}
+	}
+	return shaping;
+}
+
+doca_error_t simple_fwd_qos_set_rate(uint16_t port_id, uint8_t tc, const struct simple_fwd_qos_rate *rate)
+{
+	struct simple_fwd_qos_shaper *shaper;
+
+	if (port_id >= NUM_OF_PORTS || tc >= SIMPLE_FWD_QOS_NB_TC || rate->pir < rate->cir) {
+		DOCA_LOG_ERR("Invalid QoS rate of port %u class %u", port_id, tc);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	if (rate->pir != 0 && !__atomic_load_n(&qos_shaper_started, __ATOMIC_ACQUIRE)) {
+		DOCA_LOG_ERR("No rate limiter lcore refills the shapers, set rate-limiter-lcore to shape classes at runtime");
+		return DOCA_ERROR_BAD_STATE;
+	}
+	shaper = &qos_shapers[port_id][tc];
+	qos_tb_set_rate(&shaper->committed, rate->cir);
+	qos_tb_set_rate(&shaper->peak, rate->pir);
+	DOCA_LOG_INFO("Port %u class %u shaped to cir %lu pir %lu bytes/s", port_id, tc, rate->cir, rate->pir);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Adds the tokens earned since the last refill, up to the bucket size
+ *
+ * @tb [in]: token bucket
+ * @now [in]: current TSC
+ * @hz [in]: TSC frequency
+ */
+static void qos_tb_refill(struct simple_fwd_qos_tb *tb, uint64_t now, uint64_t hz)
+{
+	uint64_t rate = __atomic_load_n(&tb->rate, __ATOMIC_ACQUIRE);
+	int64_t size = __atomic_load_n(&tb->size, __ATOMIC_RELAXED);
+	int64_t tokens, new_tokens, add;
+
+	if (rate == 0) {
+		tb->last = now;
+		return;
+	}
+	add = (now - tb->last) * rate / hz;
+	/* keep the remainder for the next refill instead of losing it on slow rates */
+	if (add == 0)
+		return;
+	tb->last = now;
+	tokens = __atomic_load_n(&tb->tokens, __ATOMIC_RELAXED);
+	do {
+		new_tokens = RTE_MIN(tokens + add, size);
+	} while (!__atomic_compare_exchange_n(&tb->tokens, &tokens, new_tokens, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void simple_fwd_qos_shaper_start(void)
+{
+	__atomic_store_n(&qos_shaper_started, true, __ATOMIC_RELEASE);
+}
+
+void simple_fwd_qos_shaper_refill(uint64_t now)
+{
+	uint64_t hz = rte_get_tsc_hz();
+	int port_id, tc;
+
+	for (port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+		for (tc = 0; tc < SIMPLE_FWD_QOS_NB_TC; tc++) {
+			qos_tb_refill(&qos_shapers[port_id][tc].committed, now, hz);
+			qos_tb_refill(&qos_shapers[port_id][tc].peak, now, hz);
+		}
+	}
+}
+
+void simple_fwd_qos_sched_init(struct simple_fwd_qos_sched *sched,
+			       const struct simple_fwd_qos_cfg *cfg,
+			       uint16_t port_id,
+			       struct rte_ring **rings,
+			       int ts_offset)
+{
+	uint64_t hz = rte_get_tsc_hz();
+	int tc;
+
+	memset(sched, 0, sizeof(*sched));
+	sched->rings = rings;
+	sched->ts_offset = ts_offset;
+	sched->flush_mask = cfg->flush_classes;
+	sched->codel_target = hz * cfg->codel.target_us / US_PER_S;
+	sched->codel_interval = hz * cfg->codel.interval_us / US_PER_S;
+	sched->drops = simple_fwd_qos_drop_stats_get(rte_lcore_id());
+	sched->shapers = qos_shapers[port_id];
+	sched->mode = cfg->sched_mode;
+	sched->nb_strict_tc = cfg->sched_mode == SIMPLE_FWD_QOS_SCHED_STRICT ? SIMPLE_FWD_QOS_NB_TC : cfg->nb_strict_tc;
+	for (tc = 0; tc < SIMPLE_FWD_QOS_NB_TC; tc++) {
+		sched->weight[tc] = cfg->weights[port_id][tc];
+		sched->quantum[tc] = sched->weight[tc] * QOS_QUANTUM;
+		if (cfg->drop_policy[tc] == SIMPLE_FWD_QOS_DROP_CODEL)
+			sched->codel_mask |= 1 << tc;
+	}
+}
+
+/*
+ * Integer square root
+ *
+ * @x [in]: value
+ * @return: largest integer whose square is not above x
+ */
+static uint64_t qos_isqrt(uint64_t x)
+{
+	uint64_t res = 0;
+	uint64_t bit = 1ULL << 62;
+
+	while (bit > x)
+		bit >>= 2;
+	while (bit != 0) {
+		if (x >= res + bit) {
+			x -= res + bit;
+			res = (res >> 1) + bit;
+		} else
+			res >>= 1;
+		bit >>= 2;
+	}
+	return res;
+}
+
+/*
+ * CoDel control law, the drops get closer as the square root of their number
+ *
+ * @t [in]: time of the last drop
+ * @interval [in]: CoDel interval
+ * @count [in]: number of drops since entering the dropping state
+ * @return: time of the next drop
+ */
+static inline uint64_t qos_codel_control_law(uint64_t t, uint64_t interval, uint32_t count)
+{
+	return t + (interval << (QOS_CODEL_SCALE_SHIFT / 2)) / qos_isqrt((uint64_t)count << QOS_CODEL_SCALE_SHIFT);
+}
+
+/*
+ * Decides whether the head packet of a class has to be dropped, following RFC 8289
+ *
+ * @sched [in]: scheduler of the port
+ * @codel [in]: CoDel state of the class
+ * @m [in]: head packet of the class
+ * @now [in]: current TSC
+ * @return: true if the packet has to be dropped
+ */
+static bool qos_codel_drop(struct simple_fwd_qos_sched *sched,
+			   struct simple_fwd_qos_codel *codel,
+			   struct rte_mbuf *m,
+			   uint64_t now)
+{
+	uint64_t sojourn = now - *RTE_MBUF_DYNFIELD(m, sched->ts_offset, uint64_t *);
+	bool ok_to_drop = false;
+	uint32_t delta;
+
+	if (sojourn < sched->codel_target)
+		codel->first_above = 0;
+	else if (codel->first_above == 0)
+		codel->first_above = now + sched->codel_interval;
+	else
+		ok_to_drop = now >= codel->first_above;
+
+	if (codel->dropping) {
+		if (!ok_to_drop) {
+			codel->dropping = false;
+			return false;
+		}
+		if (now < codel->drop_next)
+			return false;
+		codel->count++;
+		codel->drop_next = qos_codel_control_law(codel->drop_next, sched->codel_interval, codel->count);
+		return true;
+	}
+	if (!ok_to_drop)
+		return false;
+	codel->dropping = true;
+	/* resume close to the previous drop rate if the last dropping state ended recently */
+	delta = codel->count - codel->last_count;
+	codel->count = (delta > 1 && now - codel->drop_next < 16 * sched->codel_interval) ? delta : 1;
+	codel->last_count = codel->count;
+	codel->drop_next = qos_codel_control_law(now, sched->codel_interval, codel->count);
+	return true;
+}
+
+/*
+ * Returns the next packet of a class without scheduling it, refilling the class stage from its
+ * ring once empty. Classes managed with CoDel drop their head packets here while the control
+ * law asks for it.
+ *
+ * @sched [in]: scheduler of the port
+ * @tc [in]: traffic class
+ * @return: head packet of the class, NULL if the class is empty
+ */
+static inline struct rte_mbuf *qos_stage_peek(struct simple_fwd_qos_sched *sched, uint8_t tc)
+{
+	struct simple_fwd_qos_stage *stage = &sched->stage[tc];
+	uint64_t now;
+
+	for (;;) {
+		if (stage->cnt == 0) {
+			stage->head = 0;
+			stage->cnt = rte_ring_dequeue_burst(sched->rings[tc],
+							    (void **)stage->pkts,
+							    SIMPLE_FWD_QOS_STAGE_SIZE,
+							    NULL);
+			if (stage->cnt == 0) {
+				/* an empty queue has no standing delay */
+				sched->codel[tc].first_above = 0;
+				return NULL;
+			}
+		}
+		if (likely(!(sched->codel_mask & (1 << tc))))
+			return stage->pkts[stage->head];
+		now = rte_rdtsc();
+		if (!qos_codel_drop(sched, &sched->codel[tc], stage->pkts[stage->head], now))
+			return stage->pkts[stage->head];
+		rte_pktmbuf_free(stage->pkts[stage->head++]);
+		stage->cnt--;
+		qos_count_drops(sched->drops, SIMPLE_FWD_QOS_DROP_REASON_CODEL, 1);
+	}
+}
+
+/*
+ * Returns the head packet of a class if the class shaper lets it go in the current pass. In the
+ * committed pass a shaped class only sends within its committed rate, in the excess pass it sends
+ * up to its peak rate. Unshaped classes are always eligible.
+ *
+ * @sched [in]: scheduler of the port
+ * @tc [in]: traffic class
+ * @excess [in]: whether this is the excess pass
+ * @return: head packet of the class, NULL if the class is empty or has no tokens left
+ */
+static inline struct rte_mbuf *qos_ready(struct simple_fwd_qos_sched *sched, uint8_t tc, bool excess)
+{
+	struct simple_fwd_qos_shaper *shaper = &sched->shapers[tc];
+	struct rte_mbuf *m = qos_stage_peek(sched, tc);
+
+	if (m == NULL || __atomic_load_n(&shaper->peak.rate, __ATOMIC_RELAXED) == 0)
+		return m;
+	if (__atomic_load_n(&shaper->peak.tokens, __ATOMIC_RELAXED) < (int64_t)m->pkt_len)
+		return NULL;
+	if (!excess && __atomic_load_n(&shaper->committed.tokens, __ATOMIC_RELAXED) < (int64_t)m->pkt_len)
+		return NULL;
+	return m;
+}
+
+/*
+ * Removes the head packet of a class, which qos_ready() returned, and charges it to the class shaper
+ *
+ * @sched [in]: scheduler of the port
+ * @tc [in]: traffic class
+ * @excess [in]: whether this is the excess pass, which does not use the committed tokens
+ * @return: head packet of the class
+ */
+static inline struct rte_mbuf *qos_stage_pop(struct simple_fwd_qos_sched *sched, uint8_t tc, bool excess)
+{
+	struct simple_fwd_qos_stage *stage = &sched->stage[tc];
+	struct simple_fwd_qos_shaper *shaper = &sched->shapers[tc];
+	struct rte_mbuf *m = stage->pkts[stage->head++];
+
+	stage->cnt--;
+	sched->flush |= (sched->flush_mask >> tc) & 1;
+	if (__atomic_load_n(&shaper->peak.rate, __ATOMIC_RELAXED) != 0) {
+		__atomic_fetch_sub(&shaper->peak.tokens, m->pkt_len, __ATOMIC_RELAXED);
+		if (!excess)
+			__atomic_fetch_sub(&shaper->committed.tokens, m->pkt_len, __ATOMIC_RELAXED);
+	}
+	return m;
+}
+
+/*
+ * Serves the weighted classes in deficit round robin, a class sends as long as its head packet
+ * fits in the bytes credited to it, and moves on to the next class otherwise
+ *
+ * @sched [in]: scheduler of the port
+ * @nb_tc [in]: number of weighted classes, the lowest ones
+ * @excess [in]: whether this is the excess pass
+ * @pkts [out]: scheduled packets
+ * @nb_pkts [in]: maximum number of packets to schedule
+ * @return: number of packets scheduled
+ */
+static uint16_t qos_sched_drr(struct simple_fwd_qos_sched *sched,
+			      uint8_t nb_tc,
+			      bool excess,
+			      struct rte_mbuf **pkts,
+			      uint16_t nb_pkts)
+{
+	struct rte_mbuf *m;
+	uint16_t n = 0;
+	uint8_t nb_idle = 0;
+	uint8_t tc;
+
+	while (n < nb_pkts && nb_idle < nb_tc) {
+		tc = sched->drr_tc;
+		m = qos_ready(sched, tc, excess);
+		if (m == NULL || (sched->drr_credited && (int32_t)m->pkt_len > sched->deficit[tc])) {
+			/* an empty or shaped out class does not keep credits for later */
+			if (m == NULL) {
+				sched->deficit[tc] = 0;
+				nb_idle++;
+			}
+			sched->drr_tc = sched->drr_tc + 1 < nb_tc ? sched->drr_tc + 1 : 0;
+			sched->drr_credited = false;
+			continue;
+		}
+		if (!sched->drr_credited) {
+			sched->deficit[tc] += sched->quantum[tc];
+			sched->drr_credited = true;
+			if ((int32_t)m->pkt_len > sched->deficit[tc])
+				continue;
+		}
+		sched->deficit[tc] -= m->pkt_len;
+		pkts[n++] = qos_stage_pop(sched, tc, excess);
+		nb_idle = 0;
+	}
+	return n;
+}
+
+/*
+ * Serves the weighted classes in self-clocked fair queuing order: each head packet gets a finish
+ * tag of its length over the class weight past the current virtual time, and the smallest tag is
+ * sent first
+ *
+ * @sched [in]: scheduler of the port
+ * @nb_tc [in]: number of weighted classes, the lowest ones
+ * @excess [in]: whether this is the excess pass
+ * @pkts [out]: scheduled packets
+ * @nb_pkts [in]: maximum number of packets to schedule
+ * @return: number of packets scheduled
+ */
+static uint16_t qos_sched_wfq(struct simple_fwd_qos_sched *sched,
+			      uint8_t nb_tc,
+			      bool excess,
+			      struct rte_mbuf **pkts,
+			      uint16_t nb_pkts)
+{
+	struct rte_mbuf *m;
+	uint16_t n = 0;
+	int best;
+	uint8_t tc;
+
+	while (n < nb_pkts) {
+		best = -1;
+		for (tc = 0; tc < nb_tc; tc++) {
+			m = qos_ready(sched, tc, excess);
+			if (m == NULL)
+				continue;
+			if (!(sched->finish_valid & (1 << tc))) {
+				sched->finish[tc] = RTE_MAX(sched->vtime, sched->finish[tc]) +
+						    (uint64_t)m->pkt_len * QOS_WFQ_SCALE / sched->weight[tc];
+				sched->finish_valid |= 1 << tc;
+			}
+			if (best < 0 || sched->finish[tc] < sched->finish[best])
+				best = tc;
+		}
+		if (best < 0)
+			break;
+		sched->vtime = sched->finish[best];
+		sched->finish_valid &= ~(1 << best);
+		pkts[n++] = qos_stage_pop(sched, best, excess);
+	}
+	return n;
+}
+
+/*
+ * Schedules the strict priority classes, then the weighted ones, in one shaping pass
+ *
+ * @sched [in]: scheduler of the port
+ * @excess [in]: whether this is the excess pass
+ * @pkts [out]: scheduled packets
+ * @nb_pkts [in]: maximum number of packets to schedule
+ * @return: number of packets scheduled
+ */
+static uint16_t qos_sched_pass(struct simple_fwd_qos_sched *sched, bool excess, struct rte_mbuf **pkts, uint16_t nb_pkts)
+{
+	uint8_t nb_weighted_tc = SIMPLE_FWD_QOS_NB_TC - sched->nb_strict_tc;
+	uint16_t n = 0;
+	int tc;
+
+	for (tc = SIMPLE_FWD_QOS_NB_TC - 1; tc >= nb_weighted_tc && n < nb_pkts; tc--) {
+		while (n < nb_pkts && qos_ready(sched, tc, excess) != NULL)
+			pkts[n++] = qos_stage_pop(sched, tc, excess);
+	}
+	if (n == nb_pkts || nb_weighted_tc == 0)
+		return n;
+
+	switch (sched->mode) {
+	case SIMPLE_FWD_QOS_SCHED_WFQ:
+		return n + qos_sched_wfq(sched, nb_weighted_tc, excess, pkts + n, nb_pkts - n);
+	case SIMPLE_FWD_QOS_SCHED_DRR:
+		return n + qos_sched_drr(sched, nb_weighted_tc, excess, pkts + n, nb_pkts - n);
+	default:
+		return n;
+	}
+}
+
+uint16_t simple_fwd_qos_sched_dequeue(struct simple_fwd_qos_sched *sched, struct rte_mbuf **pkts, uint16_t nb_pkts)
+{
+	uint16_t n;
+
+	/* the committed rates of all the classes are served before any traffic in excess */
+	n = qos_sched_pass(sched, false, pkts, nb_pkts);
+	if (n < nb_pkts)
+		n += qos_sched_pass(sched, true, pkts + n, nb_pkts - n);
+	return n;
+}
+
+bool simple_fwd_qos_sched_empty(const struct simple_fwd_qos_sched *sched)
+{
+	int tc;
+
+	for (tc = 0; tc < SIMPLE_FWD_QOS_NB_TC; tc++) {
+		if (sched->stage[tc].cnt != 0)
+			return false;
+	}
+	return true;
+}
+
+uint16_t simple_fwd_qos_steal(struct rte_ring **rings, uint16_t port_id, struct rte_mbuf **pkts, uint16_t nb_pkts)
+{
+	uint16_t n = 0;
+	int tc;
+
+	for (tc = SIMPLE_FWD_QOS_NB_TC - 1; tc >= 0 && n < nb_pkts; tc--) {
+		if (__atomic_load_n(&qos_shapers[port_id][tc].peak.rate, __ATOMIC_RELAXED) != 0)
+			continue;
+		n += rte_ring_dequeue_burst(rings[tc], (void **)&pkts[n], nb_pkts - n, NULL);
+	}
+	return n;
+}
+
+void simple_fwd_qos_sched_flush(struct simple_fwd_qos_sched *sched)
+{
+	struct simple_fwd_qos_stage *stage;
+	int tc;
+
+	for (tc = 0; tc < SIMPLE_FWD_QOS_NB_TC; tc++) {
+		stage = &sched->stage[tc];
+		if (stage->cnt == 0)
+			continue;
+		rte_pktmbuf_free_bulk(&stage->pkts[stage->head], stage->cnt);
+		stage->cnt = 0;
+	}
+}
@@ -0,0 +1,422 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SIMPLE_FWD_QOS_H_
+#define SIMPLE_FWD_QOS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_ring.h>
+
+#include <doca_error.h>
+#include <doca_flow.h>
+
+#include "simple_fwd_pkt.h"
+#include "simple_fwd_port.h"
+
+#define SIMPLE_FWD_QOS_NB_TC (8)    /* Number of traffic classes, one QoS ring per class and port */
+#define SIMPLE_FWD_QOS_NB_DSCP (64) /* Number of DSCP code points */
+#define SIMPLE_FWD_QOS_NB_PCP (8)   /* Number of VLAN priority code points */
+#define SIMPLE_FWD_QOS_STAGE_SIZE (32) /* Packets taken at once from a class ring by the scheduler */
+
+/* Packet field the traffic class is derived from */
+enum simple_fwd_qos_source {
+	SIMPLE_FWD_QOS_SRC_DSCP,       /* Outer IPv4 DSCP */
+	SIMPLE_FWD_QOS_SRC_PCP,	       /* Outer VLAN PCP, untagged packets are PCP 0 */
+	SIMPLE_FWD_QOS_SRC_INNER_DSCP, /* Inner IPv4 DSCP of tunneled packets, outer DSCP otherwise */
+};
+
+/* Scheduling discipline of the classes served by a TX lcore */
+enum simple_fwd_qos_sched_mode {
+	SIMPLE_FWD_QOS_SCHED_STRICT, /* Highest class first, lower classes may starve */
+	SIMPLE_FWD_QOS_SCHED_DRR,    /* Deficit round robin with byte quanta proportional to the weights */
+	SIMPLE_FWD_QOS_SCHED_WFQ,    /* Self-clocked weighted fair queuing on the packet lengths */
+};
+
+/* Queue management of a class ring */
+enum simple_fwd_qos_drop_policy {
+	SIMPLE_FWD_QOS_DROP_TAIL,  /* Drop the arriving packets when the ring is full */
+	SIMPLE_FWD_QOS_DROP_HEAD,  /* Drop the oldest packets of a full ring to make room for the arriving ones */
+	SIMPLE_FWD_QOS_DROP_RED,   /* Drop arriving packets early, with a probability rising with the ring occupancy */
+	SIMPLE_FWD_QOS_DROP_CODEL, /* Drop at dequeue while the packets sojourn time stays above the target */
+};
+
+/* Reasons packets are dropped by the QoS stages */
+enum simple_fwd_qos_drop_reason {
+	SIMPLE_FWD_QOS_DROP_REASON_TAIL,  /* Ring full, arriving packet dropped */
+	SIMPLE_FWD_QOS_DROP_REASON_HEAD,  /* Ring full, oldest packet dropped */
+	SIMPLE_FWD_QOS_DROP_REASON_RED,	  /* Early drop on the ring occupancy */
+	SIMPLE_FWD_QOS_DROP_REASON_CODEL, /* Sojourn time above the CoDel target for too long */
+	SIMPLE_FWD_QOS_DROP_REASON_MAX,	  /* Number of drop reasons */
+};
+
+/* Packets dropped by one lcore, only written by that lcore */
+struct simple_fwd_qos_drop_stats {
+	uint64_t pkts[SIMPLE_FWD_QOS_DROP_REASON_MAX]; /* Dropped packets per reason */
+} __rte_cache_aligned;
+
+/* RED parameters, relative to the ring capacity */
+struct simple_fwd_qos_red_cfg {
+	uint8_t min_th; /* Average occupancy percentage from which packets start being dropped */
+	uint8_t max_th; /* Average occupancy percentage from which all packets are dropped */
+	uint8_t max_p;	/* Drop probability percentage reached at max_th */
+};
+
+/* CoDel parameters */
+struct simple_fwd_qos_codel_cfg {
+	uint32_t target_us;   /* Acceptable standing sojourn time */
+	uint32_t interval_us; /* Time the sojourn time may stay above the target before dropping */
+};
+
+/* Shaping rates of a class, in bytes per second */
+struct simple_fwd_qos_rate {
+	uint64_t cir; /* Committed rate, served ahead of the traffic in excess of other classes, 0 for none */
+	uint64_t pir; /* Peak rate the class never exceeds, 0 for an unshaped class */
+};
+
+/* Traffic classification, scheduling and shaping configuration */
+struct simple_fwd_qos_cfg {
+	enum simple_fwd_qos_source source;	    /* Field the traffic class is derived from */
+	uint8_t dscp_to_tc[SIMPLE_FWD_QOS_NB_DSCP]; /* Traffic class of each DSCP code point */
+	uint8_t pcp_to_tc[SIMPLE_FWD_QOS_NB_PCP];   /* Traffic class of each VLAN priority */
+	enum simple_fwd_qos_sched_mode sched_mode;  /* Scheduling discipline of the weighted classes */
+	uint8_t nb_strict_tc; /* Number of highest classes always served first, whatever the mode */
+	uint8_t weights[NUM_OF_PORTS][SIMPLE_FWD_QOS_NB_TC]; /* Share of each class of a port, DRR and WFQ */
+	struct simple_fwd_qos_rate rates[NUM_OF_PORTS][SIMPLE_FWD_QOS_NB_TC]; /* Shaping rates of each class */
+	enum simple_fwd_qos_drop_policy drop_policy[SIMPLE_FWD_QOS_NB_TC];	/* Queue management of each class */
+	struct simple_fwd_qos_red_cfg red;					/* RED parameters */
+	struct simple_fwd_qos_codel_cfg codel;					/* CoDel parameters */
+	uint32_t flush_classes; /* Classes sent without waiting for a TX burst to fill */
+};
+
+/* Enqueue side of the class rings, owned by a single RX lcore */
+struct simple_fwd_qos_enq {
+	enum simple_fwd_qos_drop_policy policy[SIMPLE_FWD_QOS_NB_TC]; /* Queue management of each class */
+	uint32_t red_min_th;					       /* RED min threshold, in 1/1024 of the ring */
+	uint32_t red_max_th;					       /* RED max threshold, in 1/1024 of the ring */
+	uint32_t red_max_p;					       /* RED max probability, in 1/1024 */
+	uint32_t red_avg[NUM_OF_PORTS][SIMPLE_FWD_QOS_NB_TC]; /* Average occupancy seen by this lcore, in 1/1024 */
+	struct simple_fwd_qos_drop_stats *drops;	       /* Drop counters of the lcore */
+};
+
+/* CoDel state of a class, per dequeuing lcore */
+struct simple_fwd_qos_codel {
+	uint64_t first_above; /* TSC from which the sojourn time is above target for a whole interval, 0 if below */
+	uint64_t drop_next;   /* TSC of the next drop while dropping */
+	uint32_t count;	      /* Packets dropped since entering the dropping state */
+	uint32_t last_count;  /* Value of count when the dropping state was last entered */
+	bool dropping;	      /* Whether or not the class is in the dropping state */
+};
+
+/* Token bucket, in bytes, refilled by the rate limiter lcore and drained by the TX lcores */
+struct simple_fwd_qos_tb {
+	int64_t tokens;	 /* Available bytes, may go below 0 when TX lcores race on the last tokens */
+	int64_t size;	 /* Maximum number of tokens, the burst allowed after an idle period */
+	uint64_t rate;	 /* Refill rate in bytes per second, 0 if the bucket is not used */
+	uint64_t last;	 /* TSC of the last refill, only read and written by the rate limiter lcore */
+};
+
+/* Two rate shaper of a class of a port */
+struct simple_fwd_qos_shaper {
+	struct simple_fwd_qos_tb committed; /* Bucket of the committed rate */
+	struct simple_fwd_qos_tb peak;	    /* Bucket of the peak rate */
+} __rte_cache_aligned;
+
+/* Packets taken from a class ring and not scheduled yet */
+struct simple_fwd_qos_stage {
+	struct rte_mbuf *pkts[SIMPLE_FWD_QOS_STAGE_SIZE]; /* Staged packets */
+	uint16_t head;					  /* Index of the next packet to schedule */
+	uint16_t cnt;					  /* Number of staged packets left */
+};
+
+/* Scheduler of the class rings of one port, owned by a single TX lcore */
+struct simple_fwd_qos_sched {
+	struct rte_ring **rings;			/* Class rings of the port, indexed by class */
+	uint8_t nb_strict_tc;				/* Number of highest classes served in strict priority */
+	enum simple_fwd_qos_sched_mode mode;		/* Discipline of the other classes */
+	uint32_t quantum[SIMPLE_FWD_QOS_NB_TC];		/* DRR bytes credited per round */
+	int32_t deficit[SIMPLE_FWD_QOS_NB_TC];		/* DRR bytes the class may still send this round */
+	uint8_t drr_tc;					/* DRR class being served */
+	bool drr_credited;				/* Whether drr_tc already got its quantum this round */
+	uint32_t weight[SIMPLE_FWD_QOS_NB_TC];		/* WFQ weights */
+	uint64_t finish[SIMPLE_FWD_QOS_NB_TC];		/* WFQ finish tag of the head, or of the last sent packet */
+	uint32_t finish_valid;				/* WFQ classes whose head finish tag is computed */
+	uint64_t vtime;					/* WFQ virtual time, finish tag of the last sent packet */
+	struct simple_fwd_qos_stage stage[SIMPLE_FWD_QOS_NB_TC]; /* Per class staged packets */
+	struct simple_fwd_qos_shaper *shapers;		/* Shapers of the port, indexed by class */
+	uint32_t codel_mask;				/* Classes managed with CoDel */
+	uint64_t codel_target;				/* CoDel target, in TSC cycles */
+	uint64_t codel_interval;			/* CoDel interval, in TSC cycles */
+	int ts_offset;					/* Offset of the RX timestamp dynfield of the mbufs */
+	struct simple_fwd_qos_codel codel[SIMPLE_FWD_QOS_NB_TC]; /* Per class CoDel state */
+	struct simple_fwd_qos_drop_stats *drops;	/* Drop counters of the lcore */
+	uint32_t flush_mask;				/* Classes whose packets are sent right away */
+	bool flush;					/* Set when a packet of flush_mask is scheduled, cleared by TX */
+};
+
+/*
+ * Fills the default configuration: DSCP class selector (DSCP >> 3), PCP as is, and DRR with equal
+ * weights below a strict priority top class
+ *
+ * @cfg [out]: QoS configuration to initialize
+ */
+void simple_fwd_qos_cfg_init(struct simple_fwd_qos_cfg *cfg);
+
+/*
+ * Overrides entries of a mapping table from a "<index>:<value>[,...]" list, e.g. "46:7,34:5,26:4"
+ *
+ * @map_str [in]: comma separated list of index to value pairs
+ * @map [out]: mapping table to update
+ * @map_size [in]: number of entries in the table
+ * @max_value [in]: highest value accepted
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+doca_error_t simple_fwd_qos_parse_map(const char *map_str, uint8_t *map, int map_size, int max_value);
+
+/*
+ * Sets the class weights from a "<class>:<weight>[,...]" list, applied to every port, or from one
+ * such list per port separated by ';', e.g. "7:4,0:1;7:2"
+ *
+ * @weights_str [in]: class weights
+ * @cfg [out]: QoS configuration to set the weights of
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+doca_error_t simple_fwd_qos_parse_weights(const char *weights_str, struct simple_fwd_qos_cfg *cfg);
+
+/*
+ * Sets the class shaping rates from a "<class>:<cir>[:<pir>][,...]" list in Mbps, applied to every
+ * port, or from one such list per port separated by ';'. The peak rate defaults to the committed one.
+ *
+ * @rates_str [in]: class rates
+ * @cfg [out]: QoS configuration to set the rates of
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+doca_error_t simple_fwd_qos_parse_rates(const char *rates_str, struct simple_fwd_qos_cfg *cfg);
+
+/*
+ * Parses one "<class>:<cir>[:<pir>]" rates entry in Mbps, the peak rate defaults to the committed one
+ *
+ * @entry [in]: rates of a class
+ * @class_id [out]: traffic class the entry applies to
+ * @rate [out]: rates of the class, in bytes per second
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+doca_error_t simple_fwd_qos_parse_rate(const char *entry, uint8_t *class_id, struct simple_fwd_qos_rate *rate);
+
+/*
+ * Loads the configured rates into the shapers, with full buckets
+ *
+ * @cfg [in]: QoS configuration
+ * @return: true if at least one class is shaped and the rate limiter lcore is needed
+ */
+bool simple_fwd_qos_shaper_init(const struct simple_fwd_qos_cfg *cfg);
+
+/*
+ * Changes the rates of a class while the application is running, the buckets keep their tokens.
+ * Shaping a class needs the rate limiter lcore, which only runs when classes are shaped at startup
+ * or when its lcore is set explicitly.
+ *
+ * @port_id [in]: port identifier
+ * @tc [in]: traffic class
+ * @rate [in]: new rates, a 0 peak rate stops shaping the class
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+doca_error_t simple_fwd_qos_set_rate(uint16_t port_id, uint8_t tc, const struct simple_fwd_qos_rate *rate);
+
+/*
+ * Marks the shapers as refilled, called by the rate limiter lcore before its refill loop
+ */
+void simple_fwd_qos_shaper_start(void);
+
+/*
+ * Refills the buckets of all the shaped classes, called in a loop by the rate limiter lcore
+ *
+ * @now [in]: current TSC
+ */
+void simple_fwd_qos_shaper_refill(uint64_t now);
+
+/*
+ * Sets the drop policy of classes from a "<class>:<policy>[,...]" list, or a single "<policy>" for
+ * all classes, policy being one of "tail", "head", "red" or "codel"
+ *
+ * @policy_str [in]: class drop policies
+ * @cfg [out]: QoS configuration to set the drop policies of
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+doca_error_t simple_fwd_qos_parse_drop_policy(const char *policy_str, struct simple_fwd_qos_cfg *cfg);
+
+/*
+ * Sets the RED parameters from a "<min>:<max>:<max_p>" string, all in percents
+ *
+ * @red_str [in]: RED parameters
+ * @cfg [out]: QoS configuration to set the RED parameters of
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+doca_error_t simple_fwd_qos_parse_red(const char *red_str, struct simple_fwd_qos_cfg *cfg);
+
+/*
+ * Sets the CoDel parameters from a "<target>:<interval>" string, in microseconds
+ *
+ * @codel_str [in]: CoDel parameters
+ * @cfg [out]: QoS configuration to set the CoDel parameters of
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+doca_error_t simple_fwd_qos_parse_codel(const char *codel_str, struct simple_fwd_qos_cfg *cfg);
+
+/*
+ * Returns the drop counters of an lcore
+ *
+ * @lcore_id [in]: lcore identifier
+ * @return: drop counters, to be written by this lcore only
+ */
+struct simple_fwd_qos_drop_stats *simple_fwd_qos_drop_stats_get(unsigned int lcore_id);
+
+/*
+ * Returns the name of a drop reason
+ *
+ * @reason [in]: drop reason
+ * @return: name of the reason
+ */
+const char *simple_fwd_qos_drop_reason_name(enum simple_fwd_qos_drop_reason reason);
+
+/*
+ * Logs the packets dropped by the QoS stages per reason, summed over all the lcores
+ */
+void simple_fwd_qos_dump_drops(void);
+
+/*
+ * Initializes the enqueue side of the class rings for the calling RX lcore
+ *
+ * @enq [out]: enqueue state to initialize
+ * @cfg [in]: QoS configuration
+ */
+void simple_fwd_qos_enq_init(struct simple_fwd_qos_enq *enq, const struct simple_fwd_qos_cfg *cfg);
+
+/*
+ * Enqueues a burst of packets of one class into its ring, dropping according to the class policy.
+ * The packets not enqueued are freed and counted.
+ *
+ * @enq [in]: enqueue state of the calling lcore
+ * @port_id [in]: port the ring belongs to
+ * @tc [in]: traffic class of the packets
+ * @ring [in]: ring of the class
+ * @mbufs [in]: packets to enqueue
+ * @nb [in]: number of packets
+ */
+void simple_fwd_qos_enqueue(struct simple_fwd_qos_enq *enq,
+			    uint16_t port_id,
+			    uint8_t tc,
+			    struct rte_ring *ring,
+			    struct rte_mbuf **mbufs,
+			    uint16_t nb);
+
+/*
+ * Initializes the scheduler of the class rings of a port for the calling TX lcore
+ *
+ * @sched [out]: scheduler to initialize
+ * @cfg [in]: QoS configuration
+ * @port_id [in]: port the rings belong to, selects the weights
+ * @rings [in]: class rings of the port
+ * @ts_offset [in]: offset of the RX timestamp dynfield, used by CoDel
+ */
+void simple_fwd_qos_sched_init(struct simple_fwd_qos_sched *sched,
+			       const struct simple_fwd_qos_cfg *cfg,
+			       uint16_t port_id,
+			       struct rte_ring **rings,
+			       int ts_offset);
+
+/*
+ * Picks the next packets to send from the class rings, in scheduling order
+ *
+ * @sched [in]: scheduler of the port
+ * @pkts [out]: scheduled packets
+ * @nb_pkts [in]: maximum number of packets to schedule
+ * @return: number of packets scheduled
+ */
+uint16_t simple_fwd_qos_sched_dequeue(struct simple_fwd_qos_sched *sched, struct rte_mbuf **pkts, uint16_t nb_pkts);
+
+/*
+ * Checks whether or not the scheduler holds no staged packet
+ *
+ * @sched [in]: scheduler of a port
+ * @return: true if every class stage is empty
+ */
+bool simple_fwd_qos_sched_empty(const struct simple_fwd_qos_sched *sched);
+
+/*
+ * Takes packets from the class rings of another TX lcore, highest class first, for an idle TX lcore
+ * to help. The caller must own the rings, the home scheduler having nothing staged or buffered.
+ * Shaped classes are left to their home scheduler, which charges their shapers.
+ *
+ * @rings [in]: class rings of the port
+ * @port_id [in]: port the rings belong to
+ * @pkts [out]: taken packets
+ * @nb_pkts [in]: maximum number of packets to take
+ * @return: number of packets taken
+ */
+uint16_t simple_fwd_qos_steal(struct rte_ring **rings, uint16_t port_id, struct rte_mbuf **pkts, uint16_t nb_pkts);
+
+/*
+ * Frees the packets taken from the rings and not scheduled yet
+ *
+ * @sched [in]: scheduler of the port
+ */
+void simple_fwd_qos_sched_flush(struct simple_fwd_qos_sched *sched);
+
+/*
+ * Returns the parse level the classification needs from the RX path
+ *
+ * @cfg [in]: classification configuration
+ * @return: minimal parse level
+ */
+enum simple_fwd_parse_level simple_fwd_qos_parse_level(const struct simple_fwd_qos_cfg *cfg);
+
+/*
+ * Returns the traffic class of a parsed packet, with a single table lookup
+ *
+ * @cfg [in]: classification configuration
+ * @pinfo [in]: packet info, parsed at least to simple_fwd_qos_parse_level()
+ * @return: traffic class, lower than SIMPLE_FWD_QOS_NB_TC
+ */
+static inline uint8_t simple_fwd_qos_classify(const struct simple_fwd_qos_cfg *cfg, const struct simple_fwd_pkt_info *pinfo)
+{
+	switch (cfg->source) {
+	case SIMPLE_FWD_QOS_SRC_PCP:
+		return cfg->pcp_to_tc[pinfo->outer.pcp];
+	case SIMPLE_FWD_QOS_SRC_INNER_DSCP:
+		if (pinfo->tun_type != DOCA_FLOW_TUN_NONE && pinfo->inner.l3_type == IPV4)
+			return cfg->dscp_to_tc[((struct rte_ipv4_hdr *)pinfo->inner.l3)->type_of_service >> 2];
+		/* fall through */
+	default:
+		/* the ECN bits are not part of the class */
+		return cfg->dscp_to_tc[pinfo->tos >> 2];
+	}
+}
+
+#endif /* SIMPLE_FWD_QOS_H_ */
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+
+#include <rte_common.h>
+#include <rte_ethdev.h>
+#include <rte_pause.h>
+
+#include <doca_log.h>
+
+#include "simple_fwd_rss.h"
+
+DOCA_LOG_REGISTER(SIMPLE_FWD_RSS);
+
+#define RSS_FENCE_US (1000) /* Maximal time a moved bucket holds its new queue, on top of the idle back-off sleeps */
+#define RSS_ACK_POLLS (2)   /* Polls after which an RX lcore is known to have seen a new fence */
+
+/* Counters of the RX queues, per port */
+static struct simple_fwd_rss_rxq rss_rxqs[NUM_OF_PORTS][SIMPLE_FWD_RSS_MAX_QUEUES];
+
+struct simple_fwd_rss_rxq *simple_fwd_rss_rxq_get(uint16_t port_id, uint16_t queue_id)
+{
+	return &rss_rxqs[port_id][queue_id];
+}
+
+/*
+ * Waits for the RX lcore of a queue to poll it again
+ *
+ * @rxq [in]: RX queue counters
+ * @nb_polls [in]: number of polls to wait for
+ * @deadline [in]: TSC to give up at
+ * @return: true if the queue was polled in time and false otherwise
+ */
+static bool rss_wait_polls(struct simple_fwd_rss_rxq *rxq, uint64_t nb_polls, uint64_t deadline)
+{
+	uint64_t start = __atomic_load_n(&rxq->polls, __ATOMIC_ACQUIRE);
+
+	while (__atomic_load_n(&rxq->polls, __ATOMIC_ACQUIRE) - start < nb_polls) {
+		if (rte_rdtsc() >= deadline)
+			return false;
+		rte_pause();
+	}
+	return true;
+}
+
+/*
+ * Moves a hash bucket to another queue. The destination stops polling before the indirection table
+ * changes, and resumes once the source handled everything it received or had pending in the NIC by
+ * then, so the packets of the moved flows leave in order.
+ *
+ * @ctx [in/out]: rebalancer state
+ * @port_id [in]: port identifier
+ * @bucket [in]: hash bucket to move
+ * @dst [in]: queue to move the bucket to
+ * @return: 0 on success and negative value otherwise
+ */
+static int rss_move_bucket(struct simple_fwd_rss_ctx *ctx, uint16_t port_id, uint16_t bucket, uint16_t dst)
+{
+	uint16_t src = ctx->reta[port_id][bucket];
+	struct simple_fwd_rss_rxq *src_rxq = simple_fwd_rss_rxq_get(port_id, src);
+	struct simple_fwd_rss_rxq *dst_rxq = simple_fwd_rss_rxq_get(port_id, dst);
+	uint64_t deadline = rte_rdtsc() + ctx->fence_cycles;
+	uint64_t fence;
+	int backlog;
+
+	/* the previous move to this queue is still draining */
+	if (__atomic_load_n(&dst_rxq->fence, __ATOMIC_ACQUIRE) != 0)
+		return 0;
+
+	dst_rxq->fence_src = src;
+	dst_rxq->fence_deadline = deadline;
+	__atomic_store_n(&dst_rxq->fence, UINT64_MAX, __ATOMIC_RELEASE);
+	if (!rss_wait_polls(dst_rxq, RSS_ACK_POLLS, deadline)) {
+		DOCA_LOG_DBG("Port %u queue %u did not see the fence, bucket %u stays on queue %u", port_id, dst, bucket,
+			     src);
+		__atomic_store_n(&dst_rxq->fence, 0, __ATOMIC_RELEASE);
+		return 0;
+	}
+
+	ctx->reta[port_id][bucket] = dst;
+	if (ctx->set_rss(port_id, ctx->reta[port_id], SIMPLE_FWD_RSS_RETA_SIZE) != 0) {
+		DOCA_LOG_ERR("Failed to move port %u bucket %u from queue %u to %u", port_id, bucket, src, dst);
+		ctx->reta[port_id][bucket] = src;
+		__atomic_store_n(&dst_rxq->fence, 0, __ATOMIC_RELEASE);
+		return -1;
+	}
+
+	/*
+	 * The NIC backlog is read before the packets taken, a descriptor taken in between is counted twice,
+	 * which only holds the destination a little longer. Waiting for the source to poll again makes sure
+	 * the bursts it was handling are in the packets taken.
+	 */
+	backlog = rte_eth_rx_queue_count(port_id, src);
+	rss_wait_polls(src_rxq, RSS_ACK_POLLS, deadline);
+	if (backlog < 0)
+		fence = UINT64_MAX; /* backlog unknown, hold until the deadline */
+	else
+		fence = __atomic_load_n(&src_rxq->taken, __ATOMIC_ACQUIRE) + backlog;
+	dst_rxq->fence_deadline = rte_rdtsc() + ctx->fence_cycles;
+	__atomic_store_n(&dst_rxq->fence, fence, __ATOMIC_RELEASE);
+	ctx->moves++;
+	DOCA_LOG_DBG("Port %u bucket %u moved from queue %u to %u", port_id, bucket, src, dst);
+	return 0;
+}
+
+int simple_fwd_rss_init(struct simple_fwd_rss_ctx *ctx,
+			simple_fwd_rss_set_fn set_rss,
+			uint16_t nb_queues,
+			uint64_t polled_mask,
+			uint32_t threshold,
+			uint32_t idle_sleep_us)
+{
+	uint16_t polled[SIMPLE_FWD_RSS_MAX_QUEUES];
+	uint16_t nb_polled = 0;
+	uint16_t port_id, queue_id, bucket;
+
+	if (nb_queues == 0 || nb_queues > SIMPLE_FWD_RSS_MAX_QUEUES) {
+		DOCA_LOG_ERR("Invalid number of queues %u to rebalance, should be in [1, %d]", nb_queues,
+			     SIMPLE_FWD_RSS_MAX_QUEUES);
+		return -1;
+	}
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->set_rss = set_rss;
+	ctx->nb_queues = nb_queues;
+	ctx->polled_mask = polled_mask;
+	ctx->threshold = threshold;
+	/* a move waits for RSS_ACK_POLLS polls of an RX lcore, each may come after a full back-off sleep */
+	ctx->fence_cycles = rte_get_tsc_hz() * (RSS_FENCE_US + (uint64_t)RSS_ACK_POLLS * idle_sleep_us) / US_PER_S;
+	for (queue_id = 0; queue_id < nb_queues; queue_id++) {
+		if (polled_mask & (1ULL << queue_id))
+			polled[nb_polled++] = queue_id;
+	}
+	if (nb_polled == 0) {
+		DOCA_LOG_ERR("No RX queue is polled");
+		return -1;
+	}
+
+	/* the buckets of the polled queues stay where the RSS pipe put them, the others are spread */
+	for (port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+		for (bucket = 0; bucket < SIMPLE_FWD_RSS_RETA_SIZE; bucket++) {
+			queue_id = bucket % nb_queues;
+			ctx->reta[port_id][bucket] = (polled_mask & (1ULL << queue_id)) ? queue_id
+											: polled[bucket % nb_polled];
+		}
+		if (nb_polled != nb_queues && set_rss(port_id, ctx->reta[port_id], SIMPLE_FWD_RSS_RETA_SIZE) != 0) {
+			DOCA_LOG_ERR("Failed to set port %u RSS to the polled queues", port_id);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int simple_fwd_rss_rebalance(struct simple_fwd_rss_ctx *ctx, uint16_t port_id)
+{
+	uint64_t load[SIMPLE_FWD_RSS_MAX_QUEUES] = {0};
+	uint64_t bucket_load[SIMPLE_FWD_RSS_RETA_SIZE];
+	uint64_t pkts, total = 0, gap;
+	uint16_t queue_id, bucket, hot = 0, cold = 0, best = SIMPLE_FWD_RSS_RETA_SIZE;
+	uint16_t nb_polled = 0;
+	int backlog;
+
+	/* a bucket is counted by every queue it went through, the sum is its load */
+	for (bucket = 0; bucket < SIMPLE_FWD_RSS_RETA_SIZE; bucket++) {
+		pkts = 0;
+		for (queue_id = 0; queue_id < ctx->nb_queues; queue_id++)
+			pkts += __atomic_load_n(&rss_rxqs[port_id][queue_id].bucket_pkts[bucket], __ATOMIC_RELAXED);
+		bucket_load[bucket] = pkts - ctx->bucket_pkts[port_id][bucket];
+		ctx->bucket_pkts[port_id][bucket] = pkts;
+		load[ctx->reta[port_id][bucket]] += bucket_load[bucket];
+	}
+
+	/* packets waiting in the NIC are load the RX lcore could not keep up with */
+	for (queue_id = 0; queue_id < ctx->nb_queues; queue_id++) {
+		if (!(ctx->polled_mask & (1ULL << queue_id)))
+			continue;
+		backlog = rte_eth_rx_queue_count(port_id, queue_id);
+		if (backlog > 0)
+			load[queue_id] += backlog;
+		if (nb_polled == 0 || load[queue_id] > load[hot])
+			hot = queue_id;
+		if (nb_polled == 0 || load[queue_id] < load[cold])
+			cold = queue_id;
+		total += load[queue_id];
+		nb_polled++;
+	}
+	if (nb_polled < 2 || total == 0)
+		return 0;
+
+	gap = load[hot] - load[cold];
+	if (gap * 100 <= (total / nb_polled) * ctx->threshold)
+		return 0;
+
+	/* a bucket above half the gap would only make the cold queue the hot one */
+	for (bucket = 0; bucket < SIMPLE_FWD_RSS_RETA_SIZE; bucket++) {
+		if (ctx->reta[port_id][bucket] != hot || bucket_load[bucket] == 0 || bucket_load[bucket] > gap / 2)
+			continue;
+		if (best == SIMPLE_FWD_RSS_RETA_SIZE || bucket_load[bucket] > bucket_load[best])
+			best = bucket;
+	}
+	if (best == SIMPLE_FWD_RSS_RETA_SIZE)
+		return 0;
+	return rss_move_bucket(ctx, port_id, best, cold);
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SIMPLE_FWD_RSS_H_
+#define SIMPLE_FWD_RSS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_lcore.h>
+
+#include "simple_fwd_port.h"
+
+#define SIMPLE_FWD_RSS_RETA_SIZE 64 /* Hash buckets of the RSS indirection table, a power of 2 */
+#define SIMPLE_FWD_RSS_MAX_QUEUES 64 /* Maximum number of RX queues rebalanced */
+
+/* Hash bucket of a received packet, the entry of the indirection table that selected its queue */
+#define SIMPLE_FWD_RSS_BUCKET(hash) ((hash) & (SIMPLE_FWD_RSS_RETA_SIZE - 1))
+
+/*
+ * RX queue counters and migration fence, written by the RX lcore polling the queue, except the fence
+ * which the rebalancer sets and the RX lcore lifts
+ */
+struct simple_fwd_rss_rxq {
+	uint64_t polls;					   /* Polls of the queue */
+	uint64_t taken;					   /* Packets received from the queue */
+	uint64_t done;					   /* Received packets handed over or freed */
+	uint64_t bucket_pkts[SIMPLE_FWD_RSS_RETA_SIZE];	   /* Received packets per hash bucket */
+	uint64_t fence;		 /* done count of fence_src to wait for before polling, 0 for none */
+	uint64_t fence_deadline; /* TSC after which the fence is lifted anyway */
+	uint16_t fence_src;	 /* Queue the buckets moved to this queue come from */
+} __rte_cache_aligned;
+
+/*
+ * Updates the RSS indirection table of a port
+ *
+ * @port_id [in]: port identifier
+ * @queues [in]: queue of every hash bucket
+ * @nb_queues [in]: number of entries in queues
+ * @return: 0 on success and negative value otherwise
+ */
+typedef int (*simple_fwd_rss_set_fn)(uint16_t port_id, const uint16_t *queues, uint16_t nb_queues);
+
+/* RSS rebalancer state, owned by the lcore running the rebalancer */
+struct simple_fwd_rss_ctx {
+	simple_fwd_rss_set_fn set_rss;					 /* RSS indirection table update */
+	uint16_t nb_queues;						 /* Number of RX queues */
+	uint64_t polled_mask;						 /* Queues polled by an RX lcore */
+	uint32_t threshold;						 /* Load imbalance triggering a move, percents */
+	uint64_t fence_cycles;						 /* Maximal time a move holds its destination */
+	uint16_t reta[NUM_OF_PORTS][SIMPLE_FWD_RSS_RETA_SIZE];		 /* Queue of every hash bucket */
+	uint64_t bucket_pkts[NUM_OF_PORTS][SIMPLE_FWD_RSS_RETA_SIZE];	 /* Bucket counters at the last sample */
+	uint64_t moves;							 /* Buckets moved so far */
+};
+
+/*
+ * Returns the counters of an RX queue
+ *
+ * @port_id [in]: port identifier
+ * @queue_id [in]: RX queue identifier
+ * @return: RX queue counters
+ */
+struct simple_fwd_rss_rxq *simple_fwd_rss_rxq_get(uint16_t port_id, uint16_t queue_id);
+
+/*
+ * Called by the RX lcore before polling a queue, tells whether it may poll it. A queue receiving
+ * buckets from another queue waits until that queue handled the packets received before the move, so
+ * that no flow is reordered.
+ *
+ * @rxq [in/out]: RX queue counters
+ * @port_id [in]: port identifier
+ * @return: true if the queue may be polled and false otherwise
+ */
+static inline bool simple_fwd_rss_rxq_poll(struct simple_fwd_rss_rxq *rxq, uint16_t port_id)
+{
+	uint64_t fence = __atomic_load_n(&rxq->fence, __ATOMIC_ACQUIRE);
+
+	__atomic_store_n(&rxq->polls, rxq->polls + 1, __ATOMIC_RELEASE);
+	if (likely(fence == 0))
+		return true;
+	if (__atomic_load_n(&simple_fwd_rss_rxq_get(port_id, rxq->fence_src)->done, __ATOMIC_ACQUIRE) < fence &&
+	    rte_rdtsc() < rxq->fence_deadline)
+		return false;
+	__atomic_store_n(&rxq->fence, 0, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+ * Initializes the rebalancer and spreads the hash buckets over the polled queues only
+ *
+ * @ctx [out]: rebalancer state
+ * @set_rss [in]: RSS indirection table update
+ * @nb_queues [in]: number of RX queues
+ * @polled_mask [in]: queues polled by an RX lcore
+ * @threshold [in]: load imbalance triggering a move, in percents of the average queue load
+ * @idle_sleep_us [in]: maximal back-off sleep of an idle RX lcore, the moves wait for it on top
+ * @return: 0 on success and negative value otherwise
+ */
+int simple_fwd_rss_init(struct simple_fwd_rss_ctx *ctx,
+			simple_fwd_rss_set_fn set_rss,
+			uint16_t nb_queues,
+			uint64_t polled_mask,
+			uint32_t threshold,
+			uint32_t idle_sleep_us);
+
+/*
+ * Samples the load of the RX queues of a port, the received packets and the NIC backlog, and moves one
+ * hash bucket from the most to the least loaded queue when they are too far apart
+ *
+ * @ctx [in/out]: rebalancer state
+ * @port_id [in]: port identifier
+ * @return: 0 on success and negative value otherwise
+ */
+int simple_fwd_rss_rebalance(struct simple_fwd_rss_ctx *ctx, uint16_t port_id);
+
+#endif /* SIMPLE_FWD_RSS_H_ */
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#include <doca_log.h>
+
+#include "simple_fwd_startup.h"
+
+DOCA_LOG_REGISTER(SIMPLE_FWD_STARTUP);
+
+#define STARTUP_NS_PER_S 1000000000ULL /* Nanoseconds per second */
+#define STARTUP_NS_PER_MS 1000000ULL   /* Nanoseconds per millisecond */
+
+/* Timed startup phase */
+struct startup_phase {
+	const char *name; /* Name of the phase */
+	uint64_t ns;	  /* Time spent in the phase */
+};
+
+/* Startup phases, in the order they ran */
+struct startup_ctx {
+	struct startup_phase phases[SIMPLE_FWD_STARTUP_MAX_PHASES]; /* Ended phases and the running one */
+	uint32_t nb_phases;					    /* Phases started */
+	uint64_t start;						    /* Start of the running phase */
+};
+
+static struct startup_ctx startup_ctx;
+
+/*
+ * Returns the monotonic clock
+ *
+ * @return: nanoseconds
+ */
+static uint64_t startup_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * STARTUP_NS_PER_S + ts.tv_nsec;
+}
+
+/*
+ * Ends the running phase, if any
+ *
+ * @now [in]: current monotonic clock
+ */
+static void startup_phase_end(uint64_t now)
+{
+	if (startup_ctx.nb_phases == 0)
+		return;
+	startup_ctx.phases[startup_ctx.nb_phases - 1].ns += now - startup_ctx.start;
+}
+
+void simple_fwd_startup_phase(const char *name)
+{
+	uint64_t now = startup_now();
+
+	startup_phase_end(now);
+	startup_ctx.start = now;
+	if (startup_ctx.nb_phases == SIMPLE_FWD_STARTUP_MAX_PHASES)
+		return;
+	startup_ctx.phases[startup_ctx.nb_phases++].name = name;
+}
+
+void simple_fwd_startup_done(void)
+{
+	uint64_t total = 0;
+	uint32_t i;
+
+	startup_phase_end(startup_now());
+	for (i = 0; i < startup_ctx.nb_phases; i++) {
+		DOCA_LOG_INFO("Startup phase %-12s %8.3f ms",
+			      startup_ctx.phases[i].name,
+			      (double)startup_ctx.phases[i].ns / STARTUP_NS_PER_MS);
+		total += startup_ctx.phases[i].ns;
+	}
+	DOCA_LOG_INFO("Startup took %.3f ms", (double)total / STARTUP_NS_PER_MS);
+	startup_ctx.nb_phases = 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+
+#include <doca_log.h>
+
+#include "simple_fwd_latency.h"
+#include "simple_fwd_pipeline.h"
+#include "simple_fwd_stats.h"
+
+DOCA_LOG_REGISTER(SIMPLE_FWD_STATS);
+
+#define STATS_NB_COUNTERS (sizeof(struct simple_fwd_lcore_stats) / sizeof(uint64_t)) /* Counters of an lcore */
+
+/* Counters of the lcores */
+static struct simple_fwd_lcore_stats lcore_stats[RTE_MAX_LCORE];
+
+/* Names of the timed stages, as logged */
+static const char *const stats_stage_names[SIMPLE_FWD_STATS_STAGE_MAX] = {
+	[SIMPLE_FWD_STATS_STAGE_RX] = "rx",
+	[SIMPLE_FWD_STATS_STAGE_SCHED] = "sched",
+	[SIMPLE_FWD_STATS_STAGE_TX] = "tx",
+};
+
+struct simple_fwd_lcore_stats *simple_fwd_stats_get(unsigned int lcore_id)
+{
+	return &lcore_stats[lcore_id];
+}
+
+void simple_fwd_stats_read(unsigned int lcore_id, struct simple_fwd_lcore_stats *stats)
+{
+	const uint64_t *src = (const uint64_t *)&lcore_stats[lcore_id];
+	uint64_t *dst = (uint64_t *)stats;
+	size_t i;
+
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < STATS_NB_COUNTERS; i++)
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+}
+
+/*
+ * Adds the counters of an lcore to a sum
+ *
+ * @total [in/out]: sum of the counters
+ * @stats [in]: counters of the lcore
+ */
+static void stats_add(struct simple_fwd_lcore_stats *total, const struct simple_fwd_lcore_stats *stats)
+{
+	const uint64_t *src = (const uint64_t *)stats;
+	uint64_t *dst = (uint64_t *)total;
+	size_t i;
+
+	for (i = 0; i < STATS_NB_COUNTERS; i++)
+		dst[i] += src[i];
+}
+
+void simple_fwd_stats_sum(struct simple_fwd_lcore_stats *total)
+{
+	struct simple_fwd_lcore_stats stats;
+	unsigned int lcore_id;
+
+	memset(total, 0, sizeof(*total));
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		simple_fwd_stats_read(lcore_id, &stats);
+		stats_add(total, &stats);
+	}
+}
+
+const char *simple_fwd_stats_stage_name(enum simple_fwd_stats_stage stage)
+{
+	return stats_stage_names[stage];
+}
+
+void simple_fwd_stats_stage_pkts(const struct simple_fwd_lcore_stats *stats,
+				 uint64_t stage_pkts[SIMPLE_FWD_STATS_STAGE_MAX])
+{
+	stage_pkts[SIMPLE_FWD_STATS_STAGE_RX] = stats->rx_pkts;
+	stage_pkts[SIMPLE_FWD_STATS_STAGE_SCHED] = stats->deq_pkts;
+	stage_pkts[SIMPLE_FWD_STATS_STAGE_TX] = stats->tx_pkts + stats->tx_freed;
+}
+
+uint64_t simple_fwd_stats_cycles_per_pkt(uint64_t cycles, uint64_t pkts)
+{
+	return pkts == 0 ? 0 : cycles / pkts;
+}
+
+void simple_fwd_stats_dump(void)
+{
+	struct simple_fwd_lcore_stats stats, total;
+	uint64_t stage_pkts[SIMPLE_FWD_STATS_STAGE_MAX];
+	unsigned int lcore_id;
+	int tc, stage;
+	uint16_t idx;
+
+	memset(&total, 0, sizeof(total));
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		simple_fwd_stats_read(lcore_id, &stats);
+		if (stats.polls == 0)
+			continue;
+		stats_add(&total, &stats);
+		DOCA_LOG_INFO("Core %u rx: %lu, tx: %lu, polls: %lu, empty: %lu (%.1f%%), slept: %lu us",
+			      lcore_id,
+			      stats.rx_pkts,
+			      stats.tx_pkts,
+			      stats.polls,
+			      stats.empty_polls,
+			      100.0 * stats.empty_polls / stats.polls,
+			      stats.sleep_us);
+	}
+
+	DOCA_LOG_INFO("RX packets: %lu, parsed: %lu, parse errors: %lu, non IPv4: %lu",
+		      total.rx_pkts,
+		      total.parsed_pkts,
+		      total.parse_errors,
+		      total.non_ipv4_pkts);
+	for (tc = SIMPLE_FWD_QOS_NB_TC - 1; tc >= 0; tc--) {
+		if (total.enq_pkts[tc] != 0)
+			DOCA_LOG_INFO("Class %d packets: %lu", tc, total.enq_pkts[tc]);
+	}
+	simple_fwd_qos_dump_drops();
+	DOCA_LOG_INFO("TX packets: %lu, freed: %lu", total.tx_pkts, total.tx_freed);
+	simple_fwd_latency_dump();
+
+	simple_fwd_stats_stage_pkts(&total, stage_pkts);
+	for (stage = 0; stage < SIMPLE_FWD_STATS_STAGE_MAX; stage++) {
+		DOCA_LOG_INFO("Stage %s cycles per packet: %lu",
+			      stats_stage_names[stage],
+			      simple_fwd_stats_cycles_per_pkt(total.cycles[stage], stage_pkts[stage]));
+		/* the RX pipeline runs between the RX burst and the scheduler */
+		if (stage != SIMPLE_FWD_STATS_STAGE_RX)
+			continue;
+		for (idx = 0; idx < simple_fwd_pipeline_nb_stages(); idx++)
+			DOCA_LOG_INFO("Stage %s cycles per packet: %lu",
+				      simple_fwd_pipeline_stage_name(idx),
+				      simple_fwd_stats_cycles_per_pkt(total.pipeline_cycles[idx], total.pipeline_pkts[idx]));
+	}
+}
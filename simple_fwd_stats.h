@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SIMPLE_FWD_STATS_H_
+#define SIMPLE_FWD_STATS_H_
+
+#include <stdint.h>
+
+#include <rte_common.h>
+#include <rte_lcore.h>
+
+#include "app_vnf.h"
+#include "simple_fwd_qos.h"
+
+/* Stages timed by the lcores, besides the RX pipeline ones */
+enum simple_fwd_stats_stage {
+	SIMPLE_FWD_STATS_STAGE_RX,    /* RX burst from the NIC */
+	SIMPLE_FWD_STATS_STAGE_SCHED, /* Dequeue from the QoS rings by the scheduler */
+	SIMPLE_FWD_STATS_STAGE_TX,    /* TX burst to the NIC */
+	SIMPLE_FWD_STATS_STAGE_MAX,
+};
+
+/*
+ * Counters of an lcore, written by the lcore only and read by the reporter without locking. Each
+ * lcore has its own cache lines, the hot path never shares them.
+ */
+struct simple_fwd_lcore_stats {
+	uint64_t rx_pkts;				    /* Packets received from the NIC */
+	uint64_t parsed_pkts;				    /* Packets parsed */
+	uint64_t parse_errors;				    /* Packets the parser rejected, freed */
+	uint64_t non_ipv4_pkts;				    /* Parsed packets that are not IPv4, freed */
+	uint64_t enq_pkts[SIMPLE_FWD_QOS_NB_TC];	    /* Packets handed to a class, queued or sent */
+	uint64_t deq_pkts;				    /* Packets dequeued by the scheduler */
+	uint64_t tx_pkts;				    /* Packets the NIC accepted */
+	uint64_t tx_freed;				    /* Packets the NIC refused, freed */
+	uint64_t polls;					    /* Polling loops */
+	uint64_t empty_polls;				    /* Polling loops that found no packet */
+	uint64_t sleep_us;				    /* Time slept backing off */
+	uint64_t cycles[SIMPLE_FWD_STATS_STAGE_MAX];	    /* TSC cycles spent in every stage */
+	uint64_t pipeline_pkts[APP_VNF_MAX_STAGES];	    /* Packets that entered every RX pipeline stage */
+	uint64_t pipeline_cycles[APP_VNF_MAX_STAGES];	    /* TSC cycles spent in every RX pipeline stage */
+} __rte_cache_aligned;
+
+/*
+ * Returns the counters of an lcore
+ *
+ * @lcore_id [in]: lcore identifier
+ * @return: counters of the lcore
+ */
+struct simple_fwd_lcore_stats *simple_fwd_stats_get(unsigned int lcore_id);
+
+/*
+ * Reads the counters of an lcore, each one atomically, while the lcore keeps updating them
+ *
+ * @lcore_id [in]: lcore identifier
+ * @stats [out]: counters of the lcore
+ */
+void simple_fwd_stats_read(unsigned int lcore_id, struct simple_fwd_lcore_stats *stats);
+
+/*
+ * Sums the counters of all the lcores, lock free, while the lcores keep updating them
+ *
+ * @total [out]: sum of the counters
+ */
+void simple_fwd_stats_sum(struct simple_fwd_lcore_stats *total);
+
+/*
+ * Returns the name of a timed stage
+ *
+ * @stage [in]: timed stage
+ * @return: name of the stage
+ */
+const char *simple_fwd_stats_stage_name(enum simple_fwd_stats_stage stage);
+
+/*
+ * Returns the number of packets that went through every timed stage
+ *
+ * @stats [in]: counters of an lcore or their sum
+ * @stage_pkts [out]: packets of every stage
+ */
+void simple_fwd_stats_stage_pkts(const struct simple_fwd_lcore_stats *stats,
+				 uint64_t stage_pkts[SIMPLE_FWD_STATS_STAGE_MAX]);
+
+/*
+ * Returns the average cycles a stage spent per packet
+ *
+ * @cycles [in]: cycles spent in the stage
+ * @pkts [in]: packets that went through the stage
+ * @return: cycles per packet, 0 when no packet went through
+ */
+uint64_t simple_fwd_stats_cycles_per_pkt(uint64_t cycles, uint64_t pkts);
+
+/*
+ * Logs the counters of every lcore that polled, the totals, the QoS drops, the latency percentiles
+ * and the cycles per packet of every stage, RX pipeline ones included
+ */
+void simple_fwd_stats_dump(void);
+
+#endif /* SIMPLE_FWD_STATS_H_ */
@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_telemetry.h>
+
+#include <doca_log.h>
+
+#include "simple_fwd_latency.h"
+#include "simple_fwd_pipeline.h"
+#include "simple_fwd_qos.h"
+#include "simple_fwd_rss.h"
+#include "simple_fwd_stats.h"
+#include "simple_fwd_telemetry.h"
+
+DOCA_LOG_REGISTER(SIMPLE_FWD_TELEMETRY);
+
+#define TELEMETRY_NAME_LEN 32 /* Maximal length of a stat name */
+
+/* Stats sources of the telemetry commands, set before the lcores are launched */
+struct telemetry_ctx {
+	struct rte_ring *(*rings)[NUM_OF_PORTS][NUM_QOS_LEVELS]; /* QoS rings of every TX shard */
+	uint16_t nb_queues;					 /* Number of RX queues of every port */
+};
+
+static struct telemetry_ctx telemetry_ctx;
+
+/*
+ * Parses the numeric parameter of a command
+ *
+ * @params [in]: command parameters
+ * @max [in]: upper bound, excluded, of the parameter
+ * @id [out]: parsed parameter
+ * @return: 0 on success and negative value otherwise
+ */
+static int telemetry_parse_id(const char *params, unsigned long max, unsigned long *id)
+{
+	char *end;
+
+	if (params == NULL || !isdigit((unsigned char)*params))
+		return -EINVAL;
+	errno = 0;
+	*id = strtoul(params, &end, 10);
+	if (errno != 0 || *end != '\0' || *id >= max)
+		return -EINVAL;
+	return 0;
+}
+
+/*
+ * Reads the QoS drop counters of an lcore while the lcore keeps updating them
+ *
+ * @lcore_id [in]: lcore identifier
+ * @drops [out]: dropped packets per reason
+ */
+static void telemetry_read_drops(unsigned int lcore_id, uint64_t drops[SIMPLE_FWD_QOS_DROP_REASON_MAX])
+{
+	struct simple_fwd_qos_drop_stats *stats = simple_fwd_qos_drop_stats_get(lcore_id);
+	int reason;
+
+	for (reason = 0; reason < SIMPLE_FWD_QOS_DROP_REASON_MAX; reason++)
+		drops[reason] = __atomic_load_n(&stats->pkts[reason], __ATOMIC_RELAXED);
+}
+
+/*
+ * Adds the counters of an lcore, or their sum, to a telemetry reply
+ *
+ * @d [in/out]: telemetry reply, started as a dictionary
+ * @stats [in]: pipeline counters
+ * @drops [in]: QoS dropped packets per reason
+ */
+static void telemetry_add_lcore_stats(struct rte_tel_data *d,
+				      const struct simple_fwd_lcore_stats *stats,
+				      const uint64_t drops[SIMPLE_FWD_QOS_DROP_REASON_MAX])
+{
+	uint64_t stage_pkts[SIMPLE_FWD_STATS_STAGE_MAX];
+	char name[TELEMETRY_NAME_LEN];
+	const char *stage_name;
+	int tc, reason, stage;
+	uint16_t idx;
+
+	rte_tel_data_add_dict_uint(d, "rx_pkts", stats->rx_pkts);
+	rte_tel_data_add_dict_uint(d, "parsed_pkts", stats->parsed_pkts);
+	rte_tel_data_add_dict_uint(d, "parse_errors", stats->parse_errors);
+	rte_tel_data_add_dict_uint(d, "non_ipv4_pkts", stats->non_ipv4_pkts);
+	for (tc = 0; tc < SIMPLE_FWD_QOS_NB_TC; tc++) {
+		snprintf(name, sizeof(name), "tc%d_pkts", tc);
+		rte_tel_data_add_dict_uint(d, name, stats->enq_pkts[tc]);
+	}
+	for (reason = 0; reason < SIMPLE_FWD_QOS_DROP_REASON_MAX; reason++) {
+		snprintf(name, sizeof(name), "%s_drops", simple_fwd_qos_drop_reason_name(reason));
+		rte_tel_data_add_dict_uint(d, name, drops[reason]);
+	}
+	rte_tel_data_add_dict_uint(d, "deq_pkts", stats->deq_pkts);
+	rte_tel_data_add_dict_uint(d, "tx_pkts", stats->tx_pkts);
+	rte_tel_data_add_dict_uint(d, "tx_freed", stats->tx_freed);
+	rte_tel_data_add_dict_uint(d, "polls", stats->polls);
+	rte_tel_data_add_dict_uint(d, "empty_polls", stats->empty_polls);
+	rte_tel_data_add_dict_uint(d, "sleep_us", stats->sleep_us);
+
+	simple_fwd_stats_stage_pkts(stats, stage_pkts);
+	for (stage = 0; stage < SIMPLE_FWD_STATS_STAGE_MAX; stage++) {
+		stage_name = simple_fwd_stats_stage_name(stage);
+		snprintf(name, sizeof(name), "%s_cycles", stage_name);
+		rte_tel_data_add_dict_uint(d, name, stats->cycles[stage]);
+		snprintf(name, sizeof(name), "%s_cycles_per_pkt", stage_name);
+		rte_tel_data_add_dict_uint(d,
+					   name,
+					   simple_fwd_stats_cycles_per_pkt(stats->cycles[stage], stage_pkts[stage]));
+	}
+	for (idx = 0; idx < simple_fwd_pipeline_nb_stages(); idx++) {
+		stage_name = simple_fwd_pipeline_stage_name(idx);
+		snprintf(name, sizeof(name), "%s_pkts", stage_name);
+		rte_tel_data_add_dict_uint(d, name, stats->pipeline_pkts[idx]);
+		snprintf(name, sizeof(name), "%s_cycles", stage_name);
+		rte_tel_data_add_dict_uint(d, name, stats->pipeline_cycles[idx]);
+		snprintf(name, sizeof(name), "%s_cycles_per_pkt", stage_name);
+		rte_tel_data_add_dict_uint(d,
+					   name,
+					   simple_fwd_stats_cycles_per_pkt(stats->pipeline_cycles[idx],
+									   stats->pipeline_pkts[idx]));
+	}
+}
+
+/*
+ * Telemetry callback exporting the counters summed over all the lcores
+ *
+ * @cmd [in]: telemetry command, unused
+ * @params [in]: command parameters, unused
+ * @d [out]: telemetry reply
+ * @return: 0 on success and negative value otherwise
+ */
+static int telemetry_stats(const char *cmd __rte_unused, const char *params __rte_unused, struct rte_tel_data *d)
+{
+	uint64_t drops[SIMPLE_FWD_QOS_DROP_REASON_MAX], total_drops[SIMPLE_FWD_QOS_DROP_REASON_MAX] = {0};
+	struct simple_fwd_lcore_stats total;
+	unsigned int lcore_id;
+	int reason;
+
+	simple_fwd_stats_sum(&total);
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		telemetry_read_drops(lcore_id, drops);
+		for (reason = 0; reason < SIMPLE_FWD_QOS_DROP_REASON_MAX; reason++)
+			total_drops[reason] += drops[reason];
+	}
+	rte_tel_data_start_dict(d);
+	telemetry_add_lcore_stats(d, &total, total_drops);
+	return 0;
+}
+
+/*
+ * Telemetry callback listing the lcores that polled
+ *
+ * @cmd [in]: telemetry command, unused
+ * @params [in]: command parameters, unused
+ * @d [out]: telemetry reply
+ * @return: 0 on success and negative value otherwise
+ */
+static int telemetry_lcores(const char *cmd __rte_unused, const char *params __rte_unused, struct rte_tel_data *d)
+{
+	unsigned int lcore_id;
+
+	rte_tel_data_start_array(d, RTE_TEL_UINT_VAL);
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		if (__atomic_load_n(&simple_fwd_stats_get(lcore_id)->polls, __ATOMIC_RELAXED) != 0)
+			rte_tel_data_add_array_uint(d, lcore_id);
+	}
+	return 0;
+}
+
+/*
+ * Telemetry callback exporting the counters of an lcore
+ *
+ * @cmd [in]: telemetry command, unused
+ * @params [in]: lcore identifier
+ * @d [out]: telemetry reply
+ * @return: 0 on success and negative value otherwise
+ */
+static int telemetry_lcore(const char *cmd __rte_unused, const char *params, struct rte_tel_data *d)
+{
+	uint64_t drops[SIMPLE_FWD_QOS_DROP_REASON_MAX];
+	struct simple_fwd_lcore_stats stats;
+	unsigned long lcore_id;
+	int ret;
+
+	ret = telemetry_parse_id(params, RTE_MAX_LCORE, &lcore_id);
+	if (ret != 0)
+		return ret;
+	simple_fwd_stats_read(lcore_id, &stats);
+	telemetry_read_drops(lcore_id, drops);
+	rte_tel_data_start_dict(d);
+	telemetry_add_lcore_stats(d, &stats, drops);
+	return 0;
+}
+
+/*
+ * Telemetry callback exporting the counters of the RX queues of a port, as seen by the RX lcores
+ *
+ * @cmd [in]: telemetry command, unused
+ * @params [in]: port identifier
+ * @d [out]: telemetry reply
+ * @return: 0 on success and negative value otherwise
+ */
+static int telemetry_rxq(const char *cmd __rte_unused, const char *params, struct rte_tel_data *d)
+{
+	struct simple_fwd_rss_rxq *rxq;
+	struct rte_tel_data *queue;
+	char name[TELEMETRY_NAME_LEN];
+	unsigned long port_id;
+	uint64_t taken, done, polls;
+	uint16_t queue_id;
+	int ret, backlog;
+
+	ret = telemetry_parse_id(params, NUM_OF_PORTS, &port_id);
+	if (ret != 0)
+		return ret;
+	rte_tel_data_start_dict(d);
+	for (queue_id = 0; queue_id < telemetry_ctx.nb_queues; queue_id++) {
+		queue = rte_tel_data_alloc();
+		if (queue == NULL)
+			return -ENOMEM;
+		rxq = simple_fwd_rss_rxq_get(port_id, queue_id);
+		taken = __atomic_load_n(&rxq->taken, __ATOMIC_RELAXED);
+		done = __atomic_load_n(&rxq->done, __ATOMIC_RELAXED);
+		polls = __atomic_load_n(&rxq->polls, __ATOMIC_RELAXED);
+		rte_tel_data_start_dict(queue);
+		/* the polls of a queue are only counted while the RSS rebalancer runs */
+		if (polls != 0)
+			rte_tel_data_add_dict_uint(queue, "polls", polls);
+		rte_tel_data_add_dict_uint(queue, "rx_pkts", taken);
+		rte_tel_data_add_dict_uint(queue, "in_flight", taken > done ? taken - done : 0);
+		backlog = rte_eth_rx_queue_count(port_id, queue_id);
+		if (backlog >= 0)
+			rte_tel_data_add_dict_uint(queue, "nic_backlog", backlog);
+		snprintf(name, sizeof(name), "rxq%u", queue_id);
+		rte_tel_data_add_dict_container(d, name, queue, 0);
+	}
+	return 0;
+}
+
+/*
+ * Telemetry callback exporting the occupancy of the QoS rings of a port
+ *
+ * @cmd [in]: telemetry command, unused
+ * @params [in]: port identifier
+ * @d [out]: telemetry reply
+ * @return: 0 on success and negative value otherwise
+ */
+static int telemetry_rings(const char *cmd __rte_unused, const char *params, struct rte_tel_data *d)
+{
+	struct rte_tel_data *shard_rings;
+	char name[TELEMETRY_NAME_LEN];
+	unsigned long port_id;
+	int ret, shard, tc;
+
+	ret = telemetry_parse_id(params, NUM_OF_PORTS, &port_id);
+	if (ret != 0)
+		return ret;
+	rte_tel_data_start_dict(d);
+	for (shard = 0; shard < MAX_TX_SHARDS; shard++) {
+		if (telemetry_ctx.rings[shard][port_id][0] == NULL)
+			continue;
+		shard_rings = rte_tel_data_alloc();
+		if (shard_rings == NULL)
+			return -ENOMEM;
+		rte_tel_data_start_dict(shard_rings);
+		for (tc = 0; tc < NUM_QOS_LEVELS; tc++) {
+			snprintf(name, sizeof(name), "tc%d", tc);
+			rte_tel_data_add_dict_uint(shard_rings,
+						   name,
+						   rte_ring_count(telemetry_ctx.rings[shard][port_id][tc]));
+		}
+		snprintf(name, sizeof(name), "shard%d", shard);
+		rte_tel_data_add_dict_container(d, name, shard_rings, 0);
+	}
+	return 0;
+}
+
+/*
+ * Adds the latency figures of a histogram to a telemetry reply
+ *
+ * @d [in/out]: telemetry reply, started as a dictionary
+ * @prefix [in]: prefix of the stat names
+ * @hist [in]: latency histogram
+ */
+static void telemetry_add_latency(struct rte_tel_data *d, const char *prefix, const struct simple_fwd_latency_hist *hist)
+{
+	char name[TELEMETRY_NAME_LEN];
+
+	snprintf(name, sizeof(name), "%s_samples", prefix);
+	rte_tel_data_add_dict_uint(d, name, hist->count);
+	snprintf(name, sizeof(name), "%s_avg_ns", prefix);
+	rte_tel_data_add_dict_uint(d, name, simple_fwd_latency_cycles_to_ns(hist->sum / hist->count));
+	snprintf(name, sizeof(name), "%s_p50_ns", prefix);
+	rte_tel_data_add_dict_uint(d, name, simple_fwd_latency_cycles_to_ns(simple_fwd_latency_percentile(hist, 0.5)));
+	snprintf(name, sizeof(name), "%s_p99_ns", prefix);
+	rte_tel_data_add_dict_uint(d, name, simple_fwd_latency_cycles_to_ns(simple_fwd_latency_percentile(hist, 0.99)));
+	snprintf(name, sizeof(name), "%s_p999_ns", prefix);
+	rte_tel_data_add_dict_uint(d, name, simple_fwd_latency_cycles_to_ns(simple_fwd_latency_percentile(hist, 0.999)));
+	snprintf(name, sizeof(name), "%s_max_ns", prefix);
+	rte_tel_data_add_dict_uint(d, name, simple_fwd_latency_cycles_to_ns(hist->max));
+}
+
+/*
+ * Telemetry callback exporting the latency percentiles of every segment and class of a port
+ *
+ * @cmd [in]: telemetry command, unused
+ * @params [in]: RX port identifier
+ * @d [out]: telemetry reply
+ * @return: 0 on success and negative value otherwise
+ */
+static int telemetry_latency(const char *cmd __rte_unused, const char *params, struct rte_tel_data *d)
+{
+	struct simple_fwd_latency_hist hist;
+	struct rte_tel_data *class_lat;
+	char name[TELEMETRY_NAME_LEN];
+	unsigned long port_id;
+	int ret, tc, seg;
+
+	ret = telemetry_parse_id(params, NUM_OF_PORTS, &port_id);
+	if (ret != 0)
+		return ret;
+	rte_tel_data_start_dict(d);
+	for (tc = 0; tc < SIMPLE_FWD_QOS_NB_TC; tc++) {
+		class_lat = NULL;
+		for (seg = 0; seg < SIMPLE_FWD_LATENCY_SEG_MAX; seg++) {
+			simple_fwd_latency_merge(port_id, tc, seg, &hist);
+			if (hist.count == 0)
+				continue;
+			if (class_lat == NULL) {
+				class_lat = rte_tel_data_alloc();
+				if (class_lat == NULL)
+					return -ENOMEM;
+				rte_tel_data_start_dict(class_lat);
+			}
+			telemetry_add_latency(class_lat, simple_fwd_latency_seg_name(seg), &hist);
+		}
+		if (class_lat == NULL)
+			continue;
+		snprintf(name, sizeof(name), "tc%d", tc);
+		rte_tel_data_add_dict_container(d, name, class_lat, 0);
+	}
+	return 0;
+}
+
+/*
+ * Telemetry callback changing the shaping rates of a class of a port at runtime
+ *
+ * @cmd [in]: telemetry command, unused
+ * @params [in]: port identifier and class rates in Mbps, as "<port_id>,<class>:<cir>[:<pir>]"
+ * @d [out]: telemetry reply
+ * @return: 0 on success and negative value otherwise
+ */
+static int telemetry_qos_rate(const char *cmd __rte_unused, const char *params, struct rte_tel_data *d)
+{
+	struct simple_fwd_qos_rate rate;
+	unsigned long port_id;
+	doca_error_t result;
+	uint8_t tc;
+	char *end;
+
+	if (params == NULL || !isdigit((unsigned char)*params))
+		return -EINVAL;
+	errno = 0;
+	port_id = strtoul(params, &end, 10);
+	if (errno != 0 || *end != ',' || port_id >= NUM_OF_PORTS)
+		return -EINVAL;
+	if (simple_fwd_qos_parse_rate(end + 1, &tc, &rate) != DOCA_SUCCESS)
+		return -EINVAL;
+	result = simple_fwd_qos_set_rate(port_id, tc, &rate);
+	if (result == DOCA_ERROR_BAD_STATE)
+		return -ENOTSUP;
+	if (result != DOCA_SUCCESS)
+		return -EINVAL;
+	rte_tel_data_start_dict(d);
+	rte_tel_data_add_dict_uint(d, "port_id", port_id);
+	rte_tel_data_add_dict_uint(d, "tc", tc);
+	rte_tel_data_add_dict_uint(d, "cir", rate.cir);
+	rte_tel_data_add_dict_uint(d, "pir", rate.pir);
+	return 0;
+}
+
+/* Telemetry command of the application */
+struct telemetry_cmd {
+	const char *name; /* Command, as requested by the clients */
+	telemetry_cb cb;  /* Callback building the reply */
+	const char *help; /* Help text of the command */
+};
+
+/* Telemetry commands registered by this module */
+static const struct telemetry_cmd telemetry_cmds[] = {
+	{"/simple_fwd/stats", telemetry_stats, "Returns the counters summed over all the lcores. Takes no parameters"},
+	{"/simple_fwd/lcores", telemetry_lcores, "Returns the lcores that polled. Takes no parameters"},
+	{"/simple_fwd/lcore", telemetry_lcore, "Returns the counters of an lcore. Parameters: int lcore_id"},
+	{"/simple_fwd/rxq", telemetry_rxq, "Returns the RX queue counters of a port. Parameters: int port_id"},
+	{"/simple_fwd/rings", telemetry_rings, "Returns the QoS ring occupancy of a port. Parameters: int port_id"},
+	{"/simple_fwd/latency", telemetry_latency, "Returns the latency percentiles of a port. Parameters: int port_id"},
+	{"/simple_fwd/qos_rate",
+	 telemetry_qos_rate,
+	 "Shapes a class of a port, rates in Mbps, a 0 peak rate unshapes it. Parameters: int port_id,<class>:<cir>[:<pir>]"},
+};
+
+int simple_fwd_telemetry_init(struct rte_ring *rings[MAX_TX_SHARDS][NUM_OF_PORTS][NUM_QOS_LEVELS],
+			      uint16_t nb_queues)
+{
+	unsigned int i;
+	int ret;
+
+	telemetry_ctx.rings = rings;
+	telemetry_ctx.nb_queues = nb_queues;
+	for (i = 0; i < RTE_DIM(telemetry_cmds); i++) {
+		ret = rte_telemetry_register_cmd(telemetry_cmds[i].name, telemetry_cmds[i].cb, telemetry_cmds[i].help);
+		if (ret != 0) {
+			DOCA_LOG_ERR("Failed to register telemetry command %s: %d", telemetry_cmds[i].name, ret);
+			return ret;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SIMPLE_FWD_TELEMETRY_H_
+#define SIMPLE_FWD_TELEMETRY_H_
+
+#include <stdint.h>
+
+#include <rte_ring.h>
+
+#include "simple_fwd_port.h"
+#include "simple_fwd_vnf_core.h"
+
+/*
+ * Registers the telemetry commands exporting the lcore, pipeline, QoS, RX queue, ring and latency
+ * stats. The commands run on the DPDK telemetry thread, reading the counters without locking, so that
+ * scraping them never stalls an lcore. The NIC port and queue counters are exported by the ethdev
+ * commands.
+ *
+ * @rings [in]: QoS rings of every TX shard, port and class
+ * @nb_queues [in]: number of RX queues of every port
+ * @return: 0 on success and negative value otherwise
+ */
+int simple_fwd_telemetry_init(struct rte_ring *rings[MAX_TX_SHARDS][NUM_OF_PORTS][NUM_QOS_LEVELS],
+			      uint16_t nb_queues);
+
+#endif /* SIMPLE_FWD_TELEMETRY_H_ */
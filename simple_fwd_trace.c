@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_lcore.h>
+
+#include <doca_log.h>
+
+#include "simple_fwd_trace.h"
+
+DOCA_LOG_REGISTER(SIMPLE_FWD_TRACE);
+
+/* Mapped trace file */
+struct trace_file {
+	int fd;						   /* File descriptor, -1 when not tracing */
+	void *base;					   /* Mapping of the whole file */
+	size_t size;					   /* Size of the file */
+	struct simple_fwd_trace_ring *rings[RTE_MAX_LCORE]; /* Ring of every worker lcore */
+};
+
+static struct trace_file trace_file = {.fd = -1};
+
+int simple_fwd_trace_init(const char *path, uint32_t ring_size)
+{
+	struct simple_fwd_trace_hdr *hdr;
+	struct simple_fwd_trace_ring *ring;
+	uint64_t ring_stride;
+	unsigned int lcore_id;
+	uint32_t nb_rings = rte_lcore_count() - 1;
+
+	ring_stride = RTE_ALIGN_CEIL(sizeof(struct simple_fwd_trace_ring) +
+					     (uint64_t)ring_size * sizeof(struct simple_fwd_trace_record),
+				     SIMPLE_FWD_TRACE_ALIGN);
+	trace_file.size = sizeof(struct simple_fwd_trace_hdr) + nb_rings * ring_stride;
+
+	trace_file.fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (trace_file.fd < 0) {
+		DOCA_LOG_ERR("Failed to create trace file %s: %s", path, strerror(errno));
+		return -1;
+	}
+	if (ftruncate(trace_file.fd, trace_file.size) != 0) {
+		DOCA_LOG_ERR("Failed to size trace file %s to %zu bytes: %s", path, trace_file.size, strerror(errno));
+		goto close_file;
+	}
+	trace_file.base = mmap(NULL, trace_file.size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, trace_file.fd, 0);
+	if (trace_file.base == MAP_FAILED) {
+		DOCA_LOG_ERR("Failed to map trace file %s: %s", path, strerror(errno));
+		goto close_file;
+	}
+
+	hdr = trace_file.base;
+	hdr->version = SIMPLE_FWD_TRACE_VERSION;
+	hdr->record_size = sizeof(struct simple_fwd_trace_record);
+	hdr->nb_rings = nb_rings;
+	hdr->ring_size = ring_size;
+	hdr->ring_offset = sizeof(*hdr);
+	hdr->ring_stride = ring_stride;
+	hdr->tsc_hz = rte_get_tsc_hz();
+	ring = (struct simple_fwd_trace_ring *)(hdr + 1);
+	RTE_LCORE_FOREACH_WORKER(lcore_id) {
+		ring->mask = ring_size - 1;
+		ring->lcore_id = lcore_id;
+		trace_file.rings[lcore_id] = ring;
+		ring = (struct simple_fwd_trace_ring *)((uint8_t *)ring + ring_stride);
+	}
+	/* the magic goes last, a file without it was not fully set up */
+	__atomic_store_n(&hdr->magic, SIMPLE_FWD_TRACE_MAGIC, __ATOMIC_RELEASE);
+	DOCA_LOG_INFO("Tracing latency to %s, %u records per lcore", path, ring_size);
+	return 0;
+
+close_file:
+	close(trace_file.fd);
+	trace_file.fd = -1;
+	return -1;
+}
+
+struct simple_fwd_trace_ring *simple_fwd_trace_ring_get(unsigned int lcore_id)
+{
+	return trace_file.rings[lcore_id];
+}
+
+void simple_fwd_trace_fini(void)
+{
+	unsigned int lcore_id;
+	uint64_t nb_records = 0;
+
+	if (trace_file.fd < 0)
+		return;
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		if (trace_file.rings[lcore_id] == NULL)
+			continue;
+		nb_records += trace_file.rings[lcore_id]->head;
+		trace_file.rings[lcore_id] = NULL;
+	}
+	msync(trace_file.base, trace_file.size, MS_ASYNC);
+	munmap(trace_file.base, trace_file.size);
+	close(trace_file.fd);
+	trace_file.fd = -1;
+	DOCA_LOG_INFO("Traced %lu packets", nb_records);
+}
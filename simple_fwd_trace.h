@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SIMPLE_FWD_TRACE_H_
+#define SIMPLE_FWD_TRACE_H_
+
+#include <stdint.h>
+
+/*
+ * Binary latency trace, a file mapped in memory holding one ring of fixed size records per worker
+ * lcore. Every lcore only writes its own ring, overwriting its oldest records once full, so tracing
+ * takes no lock. This header only depends on the C library, the offline decoder shares it.
+ */
+
+#define SIMPLE_FWD_TRACE_MAGIC 0x3143525444574653ULL /* "SFWDTRC1" */
+#define SIMPLE_FWD_TRACE_VERSION 1
+#define SIMPLE_FWD_TRACE_ALIGN 64 /* Alignment of the rings in the file, a cache line */
+
+/* Trace file header, the rings follow it */
+struct simple_fwd_trace_hdr {
+	uint64_t magic;	       /* SIMPLE_FWD_TRACE_MAGIC */
+	uint32_t version;      /* SIMPLE_FWD_TRACE_VERSION */
+	uint32_t record_size;  /* Size of a record */
+	uint32_t nb_rings;     /* Number of rings, one per worker lcore */
+	uint32_t ring_size;    /* Records per ring, a power of 2 */
+	uint64_t ring_offset;  /* Offset of the first ring in the file */
+	uint64_t ring_stride;  /* Distance between two rings, header included */
+	uint64_t tsc_hz;       /* TSC frequency, to convert the timestamps */
+} __attribute__((aligned(SIMPLE_FWD_TRACE_ALIGN)));
+
+/* Ring header, the records follow it */
+struct simple_fwd_trace_ring {
+	uint64_t head;	   /* Records written so far, the last ring_size ones are kept */
+	uint32_t mask;	   /* ring_size - 1 */
+	uint32_t lcore_id; /* lcore writing the ring */
+} __attribute__((aligned(SIMPLE_FWD_TRACE_ALIGN)));
+
+/* Trace record of a sampled packet, the timestamps are TSC cycles */
+struct simple_fwd_trace_record {
+	uint64_t tsc_rx;   /* RX */
+	uint64_t tsc_enq;  /* Classification */
+	uint64_t tsc_deq;  /* Scheduling, 0 for run to completion classes */
+	uint64_t tsc_tx;   /* TX burst return */
+	uint32_t len;	   /* Packet length */
+	uint16_t port_id;  /* RX port */
+	uint16_t lcore_id; /* lcore that sent the packet */
+	uint8_t tc;	   /* Traffic class */
+	uint8_t pad[7];	   /* Padding to a multiple of 8 bytes */
+};
+
+/*
+ * Returns the records of a ring
+ *
+ * @ring [in]: ring header
+ * @return: first record of the ring
+ */
+static inline struct simple_fwd_trace_record *simple_fwd_trace_records(struct simple_fwd_trace_ring *ring)
+{
+	return (struct simple_fwd_trace_record *)(ring + 1);
+}
+
+/*
+ * Appends a record to the ring of the calling lcore
+ *
+ * @ring [in/out]: ring of the calling lcore
+ * @tsc_rx [in]: RX timestamp
+ * @tsc_enq [in]: classification timestamp
+ * @tsc_deq [in]: scheduling timestamp, 0 for run to completion classes
+ * @tsc_tx [in]: TX burst return timestamp
+ * @len [in]: packet length
+ * @port_id [in]: RX port
+ * @tc [in]: traffic class
+ */
+static inline void simple_fwd_trace_write(struct simple_fwd_trace_ring *ring,
+					  uint64_t tsc_rx,
+					  uint64_t tsc_enq,
+					  uint64_t tsc_deq,
+					  uint64_t tsc_tx,
+					  uint32_t len,
+					  uint16_t port_id,
+					  uint8_t tc)
+{
+	struct simple_fwd_trace_record *rec = &simple_fwd_trace_records(ring)[ring->head & ring->mask];
+
+	rec->tsc_rx = tsc_rx;
+	rec->tsc_enq = tsc_enq;
+	rec->tsc_deq = tsc_deq;
+	rec->tsc_tx = tsc_tx;
+	rec->len = len;
+	rec->port_id = port_id;
+	rec->lcore_id = ring->lcore_id;
+	rec->tc = tc;
+	/* a reader of a live trace sees the record before the head covering it */
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Creates the trace file and maps it, with one ring per worker lcore. The file is populated up
+ * front, tracing never faults a page in on the datapath.
+ *
+ * @path [in]: trace file path
+ * @ring_size [in]: records per ring, a power of 2
+ * @return: 0 on success and negative value otherwise
+ */
+int simple_fwd_trace_init(const char *path, uint32_t ring_size);
+
+/*
+ * Returns the ring of an lcore
+ *
+ * @lcore_id [in]: lcore identifier
+ * @return: ring of the lcore, NULL when not tracing
+ */
+struct simple_fwd_trace_ring *simple_fwd_trace_ring_get(unsigned int lcore_id);
+
+/*
+ * Unmaps the trace file once the lcores stopped, leaving the records on disk
+ */
+void simple_fwd_trace_fini(void);
+
+#endif /* SIMPLE_FWD_TRACE_H_ */
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2021 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Offline decoder of the binary latency traces, prints the records as CSV or the latency
+ * percentiles of every port and class:
+ *
+ *	simple_fwd_trace_decode <trace file> [csv|hist]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "simple_fwd_trace.h"
+
+#define DECODE_MAX_PORTS 2	/* Ports of the application */
+#define DECODE_MAX_TC 8		/* Traffic classes of the application */
+#define DECODE_NS_PER_S 1E9	/* Nanoseconds per second */
+
+/* Latencies of one port and class */
+struct decode_group {
+	uint64_t *latencies; /* Total latencies, in TSC cycles */
+	uint64_t nb;	     /* Number of latencies */
+};
+
+/*
+ * Returns a ring of the trace
+ *
+ * @hdr [in]: trace header
+ * @idx [in]: ring index
+ * @return: ring header
+ */
+static struct simple_fwd_trace_ring *decode_ring(struct simple_fwd_trace_hdr *hdr, uint32_t idx)
+{
+	return (struct simple_fwd_trace_ring *)((uint8_t *)hdr + hdr->ring_offset + idx * hdr->ring_stride);
+}
+
+/*
+ * Returns the number of records a ring holds, and the first one in time order
+ *
+ * @hdr [in]: trace header
+ * @ring [in]: ring header
+ * @first [out]: sequence number of the oldest record held
+ * @return: number of records held
+ */
+static uint64_t decode_ring_span(struct simple_fwd_trace_hdr *hdr, struct simple_fwd_trace_ring *ring, uint64_t *first)
+{
+	uint64_t nb = ring->head < hdr->ring_size ? ring->head : hdr->ring_size;
+
+	*first = ring->head - nb;
+	return nb;
+}
+
+/*
+ * Converts TSC cycles to nanoseconds
+ *
+ * @hdr [in]: trace header
+ * @cycles [in]: TSC cycles
+ * @return: nanoseconds
+ */
+static double decode_ns(struct simple_fwd_trace_hdr *hdr, uint64_t cycles)
+{
+	return (double)cycles * DECODE_NS_PER_S / hdr->tsc_hz;
+}
+
+/*
+ * Prints every record as a CSV line, lcore by lcore, in time order
+ *
+ * @hdr [in]: trace header
+ */
+static void decode_csv(struct simple_fwd_trace_hdr *hdr)
+{
+	struct simple_fwd_trace_record *rec;
+	struct simple_fwd_trace_ring *ring;
+	uint64_t first, nb, i;
+	uint32_t r;
+
+	printf("lcore,port,class,len,tsc_rx,tsc_enq,tsc_deq,tsc_tx,rx_ns,ring_ns,tx_ns,total_ns\n");
+	for (r = 0; r < hdr->nb_rings; r++) {
+		ring = decode_ring(hdr, r);
+		nb = decode_ring_span(hdr, ring, &first);
+		for (i = first; i < first + nb; i++) {
+			rec = &simple_fwd_trace_records(ring)[i & (hdr->ring_size - 1)];
+			printf("%u,%u,%u,%u,%lu,%lu,%lu,%lu,%.1f,%.1f,%.1f,%.1f\n",
+			       rec->lcore_id,
+			       rec->port_id,
+			       rec->tc,
+			       rec->len,
+			       rec->tsc_rx,
+			       rec->tsc_enq,
+			       rec->tsc_deq,
+			       rec->tsc_tx,
+			       decode_ns(hdr, rec->tsc_enq - rec->tsc_rx),
+			       rec->tsc_deq != 0 ? decode_ns(hdr, rec->tsc_deq - rec->tsc_enq) : 0,
+			       decode_ns(hdr, rec->tsc_tx - (rec->tsc_deq != 0 ? rec->tsc_deq : rec->tsc_enq)),
+			       decode_ns(hdr, rec->tsc_tx - rec->tsc_rx));
+		}
+	}
+}
+
+/*
+ * Compares two latencies, for qsort
+ *
+ * @a [in]: first latency
+ * @b [in]: second latency
+ * @return: negative, 0 or positive value as a is lower, equal or higher than b
+ */
+static int decode_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Returns a percentile of sorted latencies
+ *
+ * @group [in]: sorted latencies
+ * @quantile [in]: quantile, between 0 and 1
+ * @return: percentile in TSC cycles
+ */
+static uint64_t decode_percentile(const struct decode_group *group, double quantile)
+{
+	uint64_t idx = (uint64_t)(quantile * group->nb);
+
+	return group->latencies[idx < group->nb ? idx : group->nb - 1];
+}
+
+/*
+ * Prints the exact total latency percentiles of every port and class
+ *
+ * @hdr [in]: trace header
+ * @return: 0 on success and negative value otherwise
+ */
+static int decode_hist(struct simple_fwd_trace_hdr *hdr)
+{
+	struct decode_group groups[DECODE_MAX_PORTS][DECODE_MAX_TC];
+	struct simple_fwd_trace_record *rec;
+	struct simple_fwd_trace_ring *ring;
+	struct decode_group *group;
+	uint64_t first, nb, i;
+	uint32_t r, port_id, tc;
+	int ret = 0;
+
+	memset(groups, 0, sizeof(groups));
+	/* first pass sizes the groups, second pass fills them */
+	for (r = 0; r < hdr->nb_rings; r++) {
+		ring = decode_ring(hdr, r);
+		nb = decode_ring_span(hdr, ring, &first);
+		for (i = first; i < first + nb; i++) {
+			rec = &simple_fwd_trace_records(ring)[i & (hdr->ring_size - 1)];
+			if (rec->port_id < DECODE_MAX_PORTS && rec->tc < DECODE_MAX_TC)
+				groups[rec->port_id][rec->tc].nb++;
+		}
+	}
+	for (port_id = 0; port_id < DECODE_MAX_PORTS; port_id++) {
+		for (tc = 0; tc < DECODE_MAX_TC; tc++) {
+			group = &groups[port_id][tc];
+			if (group->nb == 0)
+				continue;
+			group->latencies = malloc(group->nb * sizeof(uint64_t));
+			if (group->latencies == NULL) {
+				fprintf(stderr, "Failed to allocate %lu latencies\n", group->nb);
+				ret = -ENOMEM;
+				goto free_groups;
+			}
+			group->nb = 0;
+		}
+	}
+	for (r = 0; r < hdr->nb_rings; r++) {
+		ring = decode_ring(hdr, r);
+		nb = decode_ring_span(hdr, ring, &first);
+		for (i = first; i < first + nb; i++) {
+			rec = &simple_fwd_trace_records(ring)[i & (hdr->ring_size - 1)];
+			if (rec->port_id >= DECODE_MAX_PORTS || rec->tc >= DECODE_MAX_TC)
+				continue;
+			group = &groups[rec->port_id][rec->tc];
+			group->latencies[group->nb++] = rec->tsc_tx - rec->tsc_rx;
+		}
+	}
+
+	printf("port,class,samples,p50_ns,p99_ns,p99.9_ns,max_ns\n");
+	for (port_id = 0; port_id < DECODE_MAX_PORTS; port_id++) {
+		for (tc = 0; tc < DECODE_MAX_TC; tc++) {
+			group = &groups[port_id][tc];
+			if (group->nb == 0)
+				continue;
+			qsort(group->latencies, group->nb, sizeof(uint64_t), decode_cmp);
+			printf("%u,%u,%lu,%.1f,%.1f,%.1f,%.1f\n",
+			       port_id,
+			       tc,
+			       group->nb,
+			       decode_ns(hdr, decode_percentile(group, 0.5)),
+			       decode_ns(hdr, decode_percentile(group, 0.99)),
+			       decode_ns(hdr, decode_percentile(group, 0.999)),
+			       decode_ns(hdr, group->latencies[group->nb - 1]));
+		}
+	}
+
+free_groups:
+	for (port_id = 0; port_id < DECODE_MAX_PORTS; port_id++) {
+		for (tc = 0; tc < DECODE_MAX_TC; tc++)
+			free(groups[port_id][tc].latencies);
+	}
+	return ret;
+}
+
+/*
+ * Checks that a mapped file is a complete trace of this version
+ *
+ * @hdr [in]: mapped file
+ * @size [in]: size of the file
+ * @return: 0 on success and negative value otherwise
+ */
+static int decode_check(struct simple_fwd_trace_hdr *hdr, size_t size)
+{
+	if (size < sizeof(*hdr) || hdr->magic != SIMPLE_FWD_TRACE_MAGIC) {
+		fprintf(stderr, "Not a trace file\n");
+		return -EINVAL;
+	}
+	if (hdr->version != SIMPLE_FWD_TRACE_VERSION || hdr->record_size != sizeof(struct simple_fwd_trace_record)) {
+		fprintf(stderr, "Unsupported trace version %u, record size %u\n", hdr->version, hdr->record_size);
+		return -EINVAL;
+	}
+	if (hdr->ring_size == 0 || (hdr->ring_size & (hdr->ring_size - 1)) != 0 || hdr->tsc_hz == 0 ||
+	    hdr->ring_offset + (uint64_t)hdr->nb_rings * hdr->ring_stride > size) {
+		fprintf(stderr, "Corrupted trace header\n");
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/*
+ * Trace decoder main function
+ *
+ * @argc [in]: command line arguments size
+ * @argv [in]: array of command line arguments
+ * @return: EXIT_SUCCESS on success and EXIT_FAILURE otherwise
+ */
+int main(int argc, char **argv)
+{
+	struct simple_fwd_trace_hdr *hdr;
+	const char *mode = argc > 2 ? argv[2] : "csv";
+	struct stat st;
+	int fd, ret;
+
+	if (argc < 2 || (strcmp(mode, "csv") != 0 && strcmp(mode, "hist") != 0)) {
+		fprintf(stderr, "Usage: %s <trace file> [csv|hist]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	fd = open(argv[1], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", argv[1], strerror(errno));
+		return EXIT_FAILURE;
+	}
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (hdr == MAP_FAILED) {
+		fprintf(stderr, "Failed to map %s: %s\n", argv[1], strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	ret = decode_check(hdr, st.st_size);
+	if (ret == 0) {
+		if (strcmp(mode, "csv") == 0)
+			decode_csv(hdr);
+		else
+			ret = decode_hist(hdr);
+	}
+	munmap(hdr, st.st_size);
+	return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -38,7 +38,12 @@
 #include <utils.h>
 
 #include "simple_fwd.h"
+#include "simple_fwd_latency.h"
 #include "simple_fwd_port.h"
+#include "simple_fwd_startup.h"
+#include "simple_fwd_stats.h"
+#include "simple_fwd_telemetry.h"
+#include "simple_fwd_trace.h"
 #include "simple_fwd_vnf_core.h"
 
 DOCA_LOG_REGISTER(SIMPLE_FWD_VNF);
@@ -46,23 +51,7 @@ DOCA_LOG_REGISTER(SIMPLE_FWD_VNF);
 #define DEFAULT_NB_METERS (1 << 13) /* Maximum number of meters used */
 
 struct simple_fwd_process_pkts_params process_pkts_params;
-struct rte_ring *rx_ring_buffers[NUM_OF_PORTS][NUM_QOS_LEVELS];
-
-FILE *latency_log = NULL;
-
-void init_latency_log() {
-    latency_log = fopen("/home/ubuntu/packet_latency_ns.log", "w");
-    if (!latency_log) {
-        perror("fopen latency log");
-        exit(1);
-    }
-}
-
-void close_latency_log() {
-    if (latency_log) {
-        fclose(latency_log);
-    }
-}
+struct rte_ring *rx_ring_buffers[MAX_TX_SHARDS][NUM_OF_PORTS][NUM_QOS_LEVELS];
 
 /*
  * Signal handler
@@ -74,7 +63,6 @@ static void signal_handler(int signum)
 	if (signum == SIGINT || signum == SIGTERM) {
 		DOCA_LOG_INFO("Signal %d received, preparing to exit", signum);
 		simple_fwd_process_pkts_stop();
-        close_latency_log();
 	}
 }
 
@@ -90,10 +78,6 @@ static void signal_handler(int signum)
 
 int main(int argc, char **argv)
 {
-    uint16_t num_of_tx = 8;
-
-    init_latency_log();
-
     /*
      * Core 1 process queue 1 start
      * Core 2 process queue 2 start
@@ -119,6 +103,21 @@ int main(int argc, char **argv)
 		.stats_timer = 100000,
 		.age_thread = false,
 		.is_hairpin = false,
+		.parse_level = SIMPLE_FWD_PARSE_L2,
+		.frag_reassembly = false,
+		.ring_sync = SIMPLE_FWD_RING_SYNC_AUTO,
+		.rtc_classes = 0,
+		.tx_min_burst = 1,
+		.tx_flush_us = 0,
+		.idle_polls = 0,
+		.idle_sleep_us = 0,
+		.topology.rate_limiter = -1,
+		.topology.numa_strict = false,
+		.rebalance_ms = 0,
+		.rebalance_threshold = 25,
+		.latency_sample = 64,
+		.latency_trace_records = 1 << 20,
+		.hw_timestamp = false,
 	};
 	struct app_vnf *vnf;
     process_pkts_params.cfg = &app_cfg;
@@ -137,6 +136,12 @@ int main(int argc, char **argv)
 	if (result != DOCA_SUCCESS)
 		return EXIT_FAILURE;
 
+	/* Parsing includes the EAL init */
+	simple_fwd_startup_phase("args_eal");
+
+	/* Default classification, before the cmdline/json mappings override it */
+	simple_fwd_qos_cfg_init(&app_cfg.qos);
+
 	/* Parse cmdline/json arguments */
 	result = doca_argp_init("doca_simple_forward_vnf", &app_cfg);
 	if (result != DOCA_SUCCESS) {
@@ -164,6 +169,11 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	simple_fwd_startup_phase("ports");
+	/* the ports enable the timestamp offload only once its field is registered */
+	if (app_cfg.hw_timestamp && simple_fwd_latency_hw_register() != 0)
+		DOCA_LOG_WARN("Packets are timed from software timestamps");
+
 	/* update queues and ports */
 	result = dpdk_queues_and_ports_init(&dpdk_config);
 	if (result != DOCA_SUCCESS) {
@@ -171,6 +181,7 @@ int main(int argc, char **argv)
 		exit_status = EXIT_FAILURE;
 		goto dpdk_destroy;
 	}
+	simple_fwd_latency_hw_init(dpdk_config.port_config.nb_ports);
 
 	signal(SIGINT, signal_handler);
 	signal(SIGTERM, signal_handler);
@@ -178,6 +189,7 @@ int main(int argc, char **argv)
 	/* convert to number of cycles */
 	app_cfg.stats_timer *= rte_get_timer_hz();
 
+	simple_fwd_startup_phase("flow");
 	vnf = simple_fwd_get_vnf();
 	port_cfg.nb_queues = dpdk_config.port_config.nb_queues;
 	port_cfg.is_hairpin = app_cfg.is_hairpin;
@@ -191,6 +203,7 @@ int main(int argc, char **argv)
 	}
 
 	/* Init DOCA Flow Tune Server */
+	simple_fwd_startup_phase("tune_server");
 	result = doca_flow_tune_server_cfg_create(&server_cfg);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to create flow tune server configuration");
@@ -212,16 +225,47 @@ int main(int argc, char **argv)
     int main_core_id = rte_get_main_lcore();
     printf("main core = %d\n", main_core_id);
 
-    result = init_ring_buffers(rx_ring_buffers);
+	simple_fwd_startup_phase("lcores");
+	result = simple_fwd_map_queue(dpdk_config.port_config.nb_queues, &app_cfg.topology,
+				      simple_fwd_qos_shaper_init(&app_cfg.qos), app_cfg.rtc_classes != 0);
+	if (result != 0) {
+		DOCA_LOG_ERR("Failed to map lcores");
+		exit_status = EXIT_FAILURE;
+		goto exit_app;
+	}
+
+	simple_fwd_startup_phase("rings");
+    result = init_ring_buffers(rx_ring_buffers, &app_cfg);
     if (result != DOCA_SUCCESS) {
         DOCA_LOG_ERR("Failed to create ring buffer");
         return result;
     }
+	simple_fwd_startup_phase("telemetry");
+	if (simple_fwd_telemetry_init(rx_ring_buffers, dpdk_config.port_config.nb_queues) != 0)
+		DOCA_LOG_WARN("Stats are not exported over telemetry");
+	simple_fwd_startup_phase("datapath");
+	if (simple_fwd_process_pkts_init(&app_cfg, vnf) != 0) {
+		DOCA_LOG_ERR("Failed to prepare the datapath");
+		exit_status = EXIT_FAILURE;
+		goto exit_app;
+	}
+	if (app_cfg.latency_trace[0] != '\0') {
+		if (app_cfg.latency_sample == 0)
+			DOCA_LOG_WARN("Latency sampling is off, no packet is traced");
+		if (simple_fwd_trace_init(app_cfg.latency_trace, app_cfg.latency_trace_records) != 0) {
+			exit_status = EXIT_FAILURE;
+			goto exit_app;
+		}
+	}
+
+	simple_fwd_startup_done();
 
-	simple_fwd_map_queue(dpdk_config.port_config.nb_queues, num_of_tx);
 	process_pkts_params.vnf = vnf;
 	rte_eal_mp_remote_launch(simple_fwd_process_pkts, &process_pkts_params, CALL_MAIN);
 	rte_eal_mp_wait_lcore();
+	simple_fwd_stats_dump();
+	simple_fwd_latency_destroy();
+	simple_fwd_trace_fini();
 exit_app:
 	/* cleanup app resources */
 	simple_fwd_destroy(vnf);
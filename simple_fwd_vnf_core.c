@@ -37,6 +37,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include <rte_eal.h>
 #include <rte_common.h>
@@ -47,6 +48,9 @@
 #include <rte_mbuf.h>
 #include <rte_net.h>
 #include <rte_flow.h>
+#include <rte_ip.h>
+#include <rte_ip_frag.h>
+#include <rte_spinlock.h>
 
 #include <doca_argp.h>
 #include <doca_flow.h>
@@ -57,6 +61,11 @@
 
 #include "simple_fwd_ft.h"
 #include "simple_fwd_port.h"
+#include "simple_fwd_latency.h"
+#include "simple_fwd_pipeline.h"
+#include "simple_fwd_rss.h"
+#include "simple_fwd_stats.h"
+#include "simple_fwd_trace.h"
 #include "simple_fwd_vnf_core.h"
 
 DOCA_LOG_REGISTER(SIMPLE_FWD_VNF : Core);
@@ -65,30 +74,75 @@ DOCA_LOG_REGISTER(SIMPLE_FWD_VNF : Core);
 #define VNF_PKT_LEN(M) rte_pktmbuf_pkt_len(M)	     /* A marco that returns the length of the packet */
 #define VNF_RX_BURST_SIZE (32)			     /* Burst size of packets to read, RX burst read size */
 #define VNF_TX_BURST_SIZE (32)
+#define VNF_TX_BUFFER_SIZE (2 * VNF_TX_BURST_SIZE) /* Packets held per port by a TX lcore, room for one retry */
+#define VNF_MAIN_PERIOD_US (1000) /* Main lcore wake-up period, checking its stats and rebalancing timers */
+#define VNF_TX_STEAL_BATCH (8)	/* Packets an idle TX lcore takes at once from a port of another shard */
+#define VNF_FRAG_MAX_FLOWS (4096)		     /* Maximum number of packets being reassembled per RX lcore */
+#define VNF_FRAG_BUCKET_ENTRIES (16)		     /* Associativity of the per lcore reassembly table */
+#define VNF_FRAG_TTL_MS (100)			     /* Time to wait for all the fragments of a packet */
+#define VNF_FRAG_PREFETCH (3)			     /* Prefetch offset used when freeing timed out fragments */
+#define VNF_RATE_LIMITER_PERIOD_US (10)	     /* Interval between two refills of the shaper buckets */
+#define IDLE 0		/* Role of the lcores not mapped, core_params_arr is zeroed */
 #define RX 1
 #define TX 2
-#define RATE_LIMITER 0
+#define RATE_LIMITER 3
 
 static int latency_dynfield_offset = -1;
 #define GET_LATENCY_TS(m) \
-    ((uint64_t *)RTE_MBUF_DYNFIELD(m, latency_dynfield_offset, uint64_t *))
+    RTE_MBUF_DYNFIELD(m, latency_dynfield_offset, struct simple_fwd_latency_ts *)
 
 
 /* Flag for forcing lcores to stop processing packets, and gracefully terminate the application */
 static volatile bool force_quit;
 extern struct simple_fwd_process_pkts_params process_pkts_params;
-extern struct rte_ring *rx_ring_buffers[NUM_OF_PORTS][NUM_QOS_LEVELS];
-extern FILE *latency_log;
+extern struct rte_ring *rx_ring_buffers[MAX_TX_SHARDS][NUM_OF_PORTS][NUM_QOS_LEVELS];
 
 /* Parameters used by each core */
 struct vnf_per_core_params {
-	int ports[NUM_OF_PORTS];  /* Ports identifiers */
-	int queues[NUM_OF_PORTS]; /* Queue mapped for the core running */
-	int used;		  /* Whether the core is used or not */
+	int ports[NUM_OF_PORTS];     /* Ports identifiers */
+	int queues[NUM_OF_PORTS];    /* Queue mapped for the core running */
+	int tx_queues[NUM_OF_PORTS]; /* TX queue the core sends on, per egress port */
+	int tx_shard;		     /* Home QoS rings set of a TX core */
+	int used;		     /* Role of the core, IDLE if not used */
 };
 
+/* TX queue of a port, locked only when several lcores send on it */
+struct vnf_tx_queue {
+	rte_spinlock_t lock; /* Serializes rte_eth_tx_burst() of the lcores sharing the queue */
+	uint16_t nb_users;   /* Number of lcores sending on the queue */
+	bool shared;	     /* Whether or not the lock has to be taken */
+} __rte_cache_aligned;
+
 /* per core parameters */
 static struct vnf_per_core_params core_params_arr[RTE_MAX_LCORE];
+
+/* TX queues of the ports, queues are at most as many as the lcores */
+static struct vnf_tx_queue tx_queues_arr[NUM_OF_PORTS][RTE_MAX_LCORE];
+
+/* Number of QoS rings sets, RX lcores spread the flows over them by RSS hash */
+static uint16_t nb_tx_shards = 1;
+
+/* Owner of the rings of a TX shard */
+enum vnf_tx_shard_owner {
+	VNF_TX_SHARD_HOME,   /* The home TX lcore schedules the rings */
+	VNF_TX_SHARD_LENT,   /* The home TX lcore has nothing staged or buffered, another one may take over */
+	VNF_TX_SHARD_STOLEN, /* Another TX lcore is sending packets of the rings */
+};
+
+/* Ownership of a TX shard, handed between its home TX lcore and the idle ones helping it */
+struct vnf_tx_shard {
+	uint32_t owner;			  /* enum vnf_tx_shard_owner, changed atomically */
+	uint16_t tx_queues[NUM_OF_PORTS]; /* TX queue of the home TX lcore, per egress port */
+} __rte_cache_aligned;
+
+/* Ownership of every TX shard */
+static struct vnf_tx_shard tx_shards[MAX_TX_SHARDS];
+
+/* Whether or not idle TX lcores help other shards, only when every shard has a single home lcore */
+static bool tx_steal;
+
+/* RX queues polled by an RX lcore */
+static uint64_t rx_polled_mask;
 /*
  * Adjust the mbuf pointer, to point on the packet's raw data
  *
@@ -103,156 +157,928 @@ static void vnf_adjust_mbuf(struct rte_mbuf *m, struct simple_fwd_pkt_info *pinf
 }
 
 /*
- * Process received packets, mainly retrieving packet's key, then checking if there is an entry found
- * matching the generated key, in the entries table.
- * If no entry found, the function will create and add new one.
- * In addition, this function handles aging as well
+ * Feeds an IPv4 fragment to the lcore reassembly table and parses the packet once it is complete.
+ * The reassembled packet is a multi segment mbuf forwarded as is, so the egress port must accept
+ * its size.
+ *
+ * @frag_tbl [in]: reassembly table of the calling lcore
+ * @death_row [in]: mbufs to be freed by the calling lcore
+ * @m [in]: the received fragment
+ * @level [in]: parse level used by the RX path
+ * @pinfo [in/out]: fragment packet info, replaced by the reassembled packet info
+ * @return: reassembled packet, NULL if more fragments are needed or the packet is dropped
+ */
+static struct rte_mbuf *vnf_ipv4_reassemble(struct rte_ip_frag_tbl *frag_tbl,
+					    struct rte_ip_frag_death_row *death_row,
+					    struct rte_mbuf *m,
+					    enum simple_fwd_parse_level level,
+					    struct simple_fwd_pkt_info *pinfo)
+{
+	struct rte_ipv4_hdr *iphdr = (struct rte_ipv4_hdr *)pinfo->outer.l3;
+	struct rte_mbuf *mo;
+
+	m->l2_len = pinfo->outer.l3 - pinfo->outer.l2;
+	m->l3_len = rte_ipv4_hdr_len(iphdr);
+	mo = rte_ipv4_frag_reassemble_packet(frag_tbl, death_row, m, rte_rdtsc(), iphdr);
+	if (mo == NULL)
+		return NULL;
+
+	/* the headers are all in the first segment of the chain */
+	if (simple_fwd_parse_packet_level(VNF_PKT_L2(mo), rte_pktmbuf_data_len(mo), level, pinfo) ||
+	    pinfo->outer.l3_type != IPV4) {
+		rte_pktmbuf_free(mo);
+		return NULL;
+	}
+	iphdr = (struct rte_ipv4_hdr *)pinfo->outer.l3;
+	iphdr->hdr_checksum = 0;
+	iphdr->hdr_checksum = rte_ipv4_cksum(iphdr);
+	return mo;
+}
+
+/*
+ * Sends packets on a TX queue, taking the queue lock only if other lcores send on it as well
+ *
+ * @port_id [in]: egress port
+ * @queue_id [in]: TX queue of the calling lcore on the port
+ * @pkts [in]: packets to send
+ * @nb_pkts [in]: number of packets
+ * @return: number of packets the NIC accepted
+ */
+static inline uint16_t vnf_tx_burst(uint16_t port_id, uint16_t queue_id, struct rte_mbuf **pkts, uint16_t nb_pkts)
+{
+	struct vnf_tx_queue *txq = &tx_queues_arr[port_id][queue_id];
+	uint16_t nb_tx;
+
+	if (likely(!txq->shared))
+		return rte_eth_tx_burst(port_id, queue_id, pkts, nb_pkts);
+	rte_spinlock_lock(&txq->lock);
+	nb_tx = rte_eth_tx_burst(port_id, queue_id, pkts, nb_pkts);
+	rte_spinlock_unlock(&txq->lock);
+	return nb_tx;
+}
+
+/* Packets scheduled by a TX lcore for an egress port and not sent yet */
+struct vnf_tx_buffer {
+	struct rte_mbuf *pkts[VNF_TX_BUFFER_SIZE]; /* Buffered packets, oldest first */
+	uint16_t cnt;				   /* Number of buffered packets */
+	uint64_t deadline;			   /* TSC by which the buffered packets are sent even if few */
+};
+
+/* Latency sampling state of an lcore */
+struct vnf_latency {
+	struct simple_fwd_latency_lcore *hist; /* Histograms of the lcore, NULL when not sampling */
+	struct simple_fwd_trace_ring *trace;   /* Trace ring of the lcore, NULL when not tracing */
+	struct simple_fwd_latency_hw hw;       /* NIC RX timestamps conversion of the lcore */
+	uint32_t sample;		       /* One packet in sample is timed, 0 for none */
+	uint32_t countdown;		       /* Packets left before the next sampled one */
+};
+
+/*
+ * Initializes the latency sampling state of an lcore
+ *
+ * @lat [out]: latency sampling state
+ * @core_id [in]: lcore identifier
+ * @sample [in]: one packet in sample is timed, 0 for none
+ * @return: 0 on success and negative value otherwise
+ */
+static int vnf_latency_init(struct vnf_latency *lat, uint32_t core_id, uint32_t sample)
+{
+	lat->sample = sample;
+	lat->countdown = sample;
+	lat->hist = NULL;
+	lat->trace = simple_fwd_trace_ring_get(core_id);
+	simple_fwd_latency_hw_get(&lat->hw);
+	if (sample == 0)
+		return 0;
+	lat->hist = simple_fwd_latency_lcore_get(core_id);
+	if (lat->hist == NULL) {
+		DOCA_LOG_ERR("Core %u has no latency histograms", core_id);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Stamps a packet once through the RX pipeline, as it is queued or sent. Every packet gets the
+ * enqueue timestamp CoDel needs, the sampled ones the RX timestamp as well.
+ *
+ * @lat [in/out]: latency sampling state of the RX lcore
+ * @m [in]: packet to queue or send
+ * @rx_tsc [in]: TSC at the return of the RX burst, the RX timestamp unless the NIC stamped the packet
+ */
+static inline void vnf_latency_stamp_rx(struct vnf_latency *lat, struct rte_mbuf *m, uint64_t rx_tsc)
+{
+	struct simple_fwd_latency_ts *ts = GET_LATENCY_TS(m);
+
+	ts->enq = rte_rdtsc();
+	ts->deq = 0;
+	if (lat->sample != 0 && --lat->countdown == 0) {
+		lat->countdown = lat->sample;
+		ts->rx = simple_fwd_latency_rx_tsc(&lat->hw, m, rx_tsc);
+	} else
+		ts->rx = 0;
+}
+
+/*
+ * Stamps the sampled packets a TX lcore scheduled
+ *
+ * @lat [in]: latency sampling state of the TX lcore
+ * @pkts [in]: scheduled packets
+ * @nb_pkts [in]: number of packets
+ * @now [in]: TSC of the scheduling
+ */
+static inline void vnf_latency_stamp_deq(const struct vnf_latency *lat,
+					 struct rte_mbuf **pkts,
+					 uint16_t nb_pkts,
+					 uint64_t now)
+{
+	struct simple_fwd_latency_ts *ts;
+	uint16_t i;
+
+	if (lat->sample == 0)
+		return;
+	for (i = 0; i < nb_pkts; i++) {
+		ts = GET_LATENCY_TS(pkts[i]);
+		if (ts->rx != 0)
+			ts->deq = now;
+	}
+}
+
+/* Sampled packet of a TX burst, copied before the burst hands the mbuf over to the PMD */
+struct vnf_latency_sample {
+	struct simple_fwd_latency_ts ts; /* Timestamps of the packet */
+	uint16_t idx;			 /* Index of the packet in the burst */
+	uint32_t len;			 /* Packet length */
+	uint16_t port_id;		 /* RX port of the packet */
+	uint8_t tc;			 /* Traffic class of the packet */
+};
+
+/*
+ * Sends packets like vnf_tx_burst, and records the latency of the sampled packets the NIC accepted
+ *
+ * @lat [in]: latency sampling state of the calling lcore
+ * @port_id [in]: egress port
+ * @queue_id [in]: TX queue of the calling lcore on the port
+ * @pkts [in]: packets to send
+ * @nb_pkts [in]: number of packets, up to VNF_TX_BUFFER_SIZE
+ * @return: number of packets the NIC accepted
+ */
+static inline uint16_t vnf_tx_burst_timed(const struct vnf_latency *lat,
+					  uint16_t port_id,
+					  uint16_t queue_id,
+					  struct rte_mbuf **pkts,
+					  uint16_t nb_pkts)
+{
+	struct vnf_latency_sample samples[VNF_TX_BUFFER_SIZE];
+	struct simple_fwd_latency_ts *ts;
+	uint16_t i, nb_samples = 0, nb_tx;
+	uint64_t now;
+
+	if (lat->sample == 0)
+		return vnf_tx_burst(port_id, queue_id, pkts, nb_pkts);
+	for (i = 0; i < nb_pkts; i++) {
+		ts = GET_LATENCY_TS(pkts[i]);
+		if (ts->rx == 0)
+			continue;
+		samples[nb_samples].ts = *ts;
+		samples[nb_samples].idx = i;
+		samples[nb_samples].len = pkts[i]->pkt_len;
+		samples[nb_samples].port_id = pkts[i]->port;
+		samples[nb_samples].tc = rte_mbuf_sched_traffic_class_get(pkts[i]);
+		nb_samples++;
+	}
+	nb_tx = vnf_tx_burst(port_id, queue_id, pkts, nb_pkts);
+	if (nb_samples == 0)
+		return nb_tx;
+	/* the packets not sent stay buffered and are recorded by the burst sending them */
+	now = rte_rdtsc();
+	for (i = 0; i < nb_samples && samples[i].idx < nb_tx; i++) {
+		simple_fwd_latency_record_pkt(lat->hist, samples[i].port_id, samples[i].tc, &samples[i].ts, now);
+		if (lat->trace != NULL)
+			simple_fwd_trace_write(lat->trace,
+					       samples[i].ts.rx,
+					       samples[i].ts.enq,
+					       samples[i].ts.deq,
+					       now,
+					       samples[i].len,
+					       samples[i].port_id,
+					       samples[i].tc);
+	}
+	return nb_tx;
+}
+
+/*
+ * Sends the buffered packets, the ones the NIC does not accept stay buffered for the next flush
+ *
+ * @buf [in]: TX buffer
+ * @port_id [in]: egress port
+ * @queue_id [in]: TX queue of the calling lcore on the port
+ * @lat [in]: latency sampling state of the calling lcore
+ * @stats [in/out]: counters of the calling lcore
+ */
+static void vnf_tx_buffer_flush(struct vnf_tx_buffer *buf,
+				uint16_t port_id,
+				uint16_t queue_id,
+				const struct vnf_latency *lat,
+				struct simple_fwd_lcore_stats *stats)
+{
+	uint64_t start = rte_rdtsc();
+	uint16_t nb_tx;
+
+	nb_tx = vnf_tx_burst_timed(lat, port_id, queue_id, buf->pkts, buf->cnt);
+	stats->tx_pkts += nb_tx;
+	stats->cycles[SIMPLE_FWD_STATS_STAGE_TX] += rte_rdtsc() - start;
+	buf->cnt -= nb_tx;
+	if (buf->cnt != 0)
+		memmove(buf->pkts, &buf->pkts[nb_tx], buf->cnt * sizeof(buf->pkts[0]));
+}
+
+/* Idle back-off state of a polling lcore */
+struct vnf_idle {
+	uint32_t empty_polls;		      /* Consecutive polling loops that found no packet */
+	uint32_t sleep_us;		      /* Current back-off sleep, doubled up to the configured bound */
+	struct simple_fwd_lcore_stats *stats; /* Counters of the lcore */
+};
+
+/*
+ * Initializes the idle back-off state of the calling lcore
  *
- * @mbuf [in]: DPDK structure represent the packet received
- * @queue_id [in]: Queue ID
- * @vnf [in]: Holder for all functions pointers used by the application
+ * @idle [out]: idle back-off state
  */
-static void simple_fwd_process_offload(struct rte_mbuf *mbuf, uint16_t queue_id, struct app_vnf *vnf, struct simple_fwd_pkt_info* pinfo)
+static void vnf_idle_init(struct vnf_idle *idle)
 {
+	memset(idle, 0, sizeof(*idle));
+	idle->stats = simple_fwd_stats_get(rte_lcore_id());
+}
 
-	if (simple_fwd_parse_packet(VNF_PKT_L2(mbuf), VNF_PKT_LEN(mbuf), pinfo))
+/*
+ * Accounts a polling loop and backs off when the lcore keeps finding nothing to do: it pauses after
+ * idle_polls empty loops, and after as many more sleeps, 1us first and twice longer every time up to
+ * idle_sleep_us, which bounds the wake-up latency. Any packet resets the back-off.
+ *
+ * @idle [in/out]: idle back-off state
+ * @app_config [in]: application configuration
+ * @busy [in]: whether or not the loop found packets
+ */
+static inline void vnf_idle_poll(struct vnf_idle *idle, struct simple_fwd_config *app_config, bool busy)
+{
+	idle->stats->polls++;
+	if (likely(busy)) {
+		idle->empty_polls = 0;
+		idle->sleep_us = 0;
+		return;
+	}
+	idle->stats->empty_polls++;
+	if (app_config->idle_polls == 0 || ++idle->empty_polls < app_config->idle_polls)
 		return;
-	pinfo->orig_data = mbuf;
-	pinfo->orig_port_id = mbuf->port;
-	pinfo->pipe_queue = queue_id;
-	pinfo->rss_hash = mbuf->hash.rss;
-	if (pinfo->outer.l3_type != IPV4)
+	if (app_config->idle_sleep_us == 0 || idle->empty_polls < 2 * app_config->idle_polls) {
+		rte_pause();
 		return;
-	//vnf->vnf_process_pkt(&pinfo);
-	//vnf_adjust_mbuf(mbuf, &pinfo);
-    pinfo->tos = ((struct rte_ipv4_hdr *)pinfo->outer.l3)->type_of_service;
+	}
+	idle->sleep_us = idle->sleep_us == 0 ? 1 : RTE_MIN(idle->sleep_us * 2, app_config->idle_sleep_us);
+	rte_delay_us_sleep(idle->sleep_us);
+	idle->stats->sleep_us += idle->sleep_us;
+	/* stays in the sleeping stage, the counter would wrap after 2^32 loops otherwise */
+	idle->empty_polls = 2 * app_config->idle_polls;
+}
+
+/*
+ * Records that an lcore sends on a TX queue of every port
+ *
+ * @lcore_id [in]: lcore identifier
+ * @queue_id [in]: TX queue the lcore sends on
+ */
+static void vnf_tx_queue_use(unsigned int lcore_id, uint16_t queue_id)
+{
+	struct vnf_tx_queue *txq;
+	int port_id;
+
+	for (port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+		txq = &tx_queues_arr[port_id][queue_id];
+		core_params_arr[lcore_id].tx_queues[port_id] = queue_id;
+		txq->nb_users++;
+		txq->shared = txq->nb_users > 1;
+	}
+}
+
+/*
+ * Computes how deep the RX path has to parse packets, which is the deepest level required by
+ * any of the enabled stages, or the level forced by the user if deeper.
+ * QoS ring selection reads the field the classification is configured on, while HW offload keys
+ * flows on the tunnel and inner headers. Reassembly needs the outer IPv4 header to spot fragments.
+ *
+ * @app_config [in]: application configuration
+ * @return: parse level used by the RX lcores
+ */
+static enum simple_fwd_parse_level simple_fwd_rx_parse_level(struct simple_fwd_config *app_config)
+{
+	enum simple_fwd_parse_level level = simple_fwd_qos_parse_level(&app_config->qos);
+
+	if (app_config->hw_offload)
+		level = SIMPLE_FWD_PARSE_TUNNEL;
+	else if (app_config->frag_reassembly && level < SIMPLE_FWD_PARSE_L3_DSCP)
+		level = SIMPLE_FWD_PARSE_L3_DSCP;
+
+	if (app_config->parse_level > level)
+		level = app_config->parse_level;
+	return level;
+}
+
+/* State of an RX lcore, shared by the core stages of its pipeline */
+struct vnf_rx_state {
+	struct simple_fwd_config *app_config;	 /* Application configuration */
+	struct simple_fwd_lcore_stats *stats;	 /* Counters of the lcore */
+	struct vnf_latency lat;			 /* Latency sampling state of the lcore */
+	enum simple_fwd_parse_level parse_level; /* Parse depth of the packets */
+	struct rte_ip_frag_tbl *frag_tbl;	 /* Reassembly table, NULL when not reassembling */
+	struct rte_ip_frag_death_row death_row;	 /* Fragments to free once a burst is parsed */
+	struct simple_fwd_qos_enq qos_enq;	 /* Admission state of the QoS rings */
+	uint32_t core_id;			 /* Lcore identifier */
+	uint16_t queue_id;			 /* RX queue of the lcore */
+	uint16_t port_id;			 /* RX port of the burst going through the pipeline */
+	uint64_t rx_tsc;			 /* TSC at the return of the RX burst */
+	/* packets are bucketed by shard and class, bucket = shard * NUM_QOS_LEVELS + class */
+	struct rte_mbuf *cls_mbufs[MAX_TX_SHARDS * NUM_QOS_LEVELS][VNF_RX_BURST_SIZE];
+	uint16_t cls_cnt[MAX_TX_SHARDS * NUM_QOS_LEVELS]; /* Packets per bucket */
+	struct rte_mbuf *rtc_mbufs[VNF_RX_BURST_SIZE];	 /* Packets of the run to completion classes */
+};
+
+/* State of the RX lcores, set while they run */
+static struct vnf_rx_state *vnf_rx_states[RTE_MAX_LCORE];
+
+/*
+ * Initializes the state of an RX lcore
+ *
+ * @rx [out]: state of the lcore
+ * @core_id [in]: lcore identifier
+ * @queue_id [in]: RX queue of the lcore
+ * @app_config [in]: application configuration
+ * @return: 0 on success and negative value otherwise
+ */
+static int vnf_rx_state_init(struct vnf_rx_state *rx,
+			     uint32_t core_id,
+			     uint16_t queue_id,
+			     struct simple_fwd_config *app_config)
+{
+	uint64_t frag_cycles;
+
+	memset(rx, 0, sizeof(*rx));
+	rx->app_config = app_config;
+	rx->stats = simple_fwd_stats_get(core_id);
+	rx->parse_level = simple_fwd_rx_parse_level(app_config);
+	rx->core_id = core_id;
+	rx->queue_id = queue_id;
+	if (vnf_latency_init(&rx->lat, core_id, app_config->latency_sample) != 0)
+		return -1;
+	simple_fwd_qos_enq_init(&rx->qos_enq, &app_config->qos);
+	if (app_config->frag_reassembly) {
+		frag_cycles = (rte_get_tsc_hz() + MS_PER_S - 1) / MS_PER_S * VNF_FRAG_TTL_MS;
+		rx->frag_tbl = rte_ip_frag_table_create(VNF_FRAG_MAX_FLOWS, VNF_FRAG_BUCKET_ENTRIES,
+							VNF_FRAG_MAX_FLOWS, frag_cycles, rte_socket_id());
+		if (rx->frag_tbl == NULL) {
+			DOCA_LOG_ERR("Core %u failed to create fragments table", core_id);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Releases the state of an RX lcore
+ *
+ * @rx [in]: state of the lcore
+ */
+static void vnf_rx_state_fini(struct vnf_rx_state *rx)
+{
+	if (rx->frag_tbl != NULL)
+		rte_ip_frag_table_destroy(rx->frag_tbl);
+}
+
+/*
+ * Hands the state of an RX lcore to a core stage of its pipeline
+ *
+ * @lcore_id [in]: lcore identifier
+ * @queue_id [in]: RX queue of the lcore
+ * @ctx [out]: state of the lcore
+ * @return: 0 on success and negative value otherwise
+ */
+static int vnf_rx_stage_init(uint32_t lcore_id, uint16_t queue_id __rte_unused, void **ctx)
+{
+	*ctx = vnf_rx_states[lcore_id];
+	return *ctx == NULL ? -1 : 0;
+}
+
+/*
+ * Parse stage: parses the packets, reassembles the IPv4 fragments and drops what cannot be forwarded
+ *
+ * @ctx [in]: state of the RX lcore
+ * @mbufs [in/out]: received packets, the kept ones first
+ * @pinfos [out]: info of the kept packets
+ * @nb_pkts [in]: number of packets
+ * @return: number of packets kept
+ */
+static uint16_t vnf_parse_burst(void *ctx,
+				struct rte_mbuf **mbufs,
+				struct simple_fwd_pkt_info *pinfos,
+				uint16_t nb_pkts)
+{
+	struct vnf_rx_state *rx = (struct vnf_rx_state *)ctx;
+	struct simple_fwd_pkt_info *pinfo;
+	struct rte_mbuf *m;
+	uint16_t i, n = 0;
+
+	for (i = 0; i < nb_pkts; i++) {
+		m = mbufs[i];
+		pinfo = &pinfos[n];
+		/* the parser resets what it fills, the info is reused as is between bursts */
+		if (simple_fwd_parse_packet_level(VNF_PKT_L2(m), VNF_PKT_LEN(m), rx->parse_level, pinfo)) {
+			rx->stats->parse_errors++;
+			rte_pktmbuf_free(m);
+			continue;
+		}
+		rx->stats->parsed_pkts++;
+		if (pinfo->outer.l3_type != IPV4) {
+			rx->stats->non_ipv4_pkts++;
+			rte_pktmbuf_free(m);
+			continue;
+		}
+		if (rx->frag_tbl != NULL && pinfo->outer.frag) {
+			m = vnf_ipv4_reassemble(rx->frag_tbl, &rx->death_row, m, rx->parse_level, pinfo);
+			if (m == NULL)
+				continue;
+		}
+		pinfo->orig_data = m;
+		pinfo->orig_port_id = m->port;
+		pinfo->pipe_queue = rx->queue_id;
+		pinfo->rss_hash = m->hash.rss;
+		mbufs[n++] = m;
+	}
+	if (rx->frag_tbl != NULL)
+		rte_ip_frag_free_death_row(&rx->death_row, VNF_FRAG_PREFETCH);
+	return n;
+}
+
+/*
+ * Classify stage: gives every packet its traffic class, carried in the mbuf
+ *
+ * @ctx [in]: state of the RX lcore
+ * @mbufs [in]: parsed packets
+ * @pinfos [in]: info of the packets
+ * @nb_pkts [in]: number of packets
+ * @return: number of packets kept, all of them
+ */
+static uint16_t vnf_classify_burst(void *ctx,
+				   struct rte_mbuf **mbufs,
+				   struct simple_fwd_pkt_info *pinfos,
+				   uint16_t nb_pkts)
+{
+	struct vnf_rx_state *rx = (struct vnf_rx_state *)ctx;
+	uint16_t i;
+
+	/* the latency is accounted per class, the RSS hash is left as is */
+	for (i = 0; i < nb_pkts; i++)
+		rte_mbuf_sched_traffic_class_set(mbufs[i], simple_fwd_qos_classify(&rx->app_config->qos, &pinfos[i]));
+	return nb_pkts;
+}
+
+/*
+ * Enqueue stage: queues the packets to the QoS rings of their shard and class, one enqueue per
+ * non-empty class, and sends the run to completion classes right away
+ *
+ * @ctx [in]: state of the RX lcore
+ * @mbufs [in]: classified packets
+ * @pinfos [in]: unused
+ * @nb_pkts [in]: number of packets
+ * @return: number of packets kept, none
+ */
+static uint16_t vnf_enqueue_burst(void *ctx,
+				  struct rte_mbuf **mbufs,
+				  struct simple_fwd_pkt_info *pinfos __rte_unused,
+				  uint16_t nb_pkts)
+{
+	struct vnf_rx_state *rx = (struct vnf_rx_state *)ctx;
+	uint16_t i, nb_rtc = 0, nb_tx, dst_port;
+	uint32_t cls, bucket, shard;
+	uint64_t cls_mask = 0;
+	struct rte_mbuf *m;
+
+	for (i = 0; i < nb_pkts; i++) {
+		m = mbufs[i];
+		vnf_latency_stamp_rx(&rx->lat, m, rx->rx_tsc);
+		cls = rte_mbuf_sched_traffic_class_get(m);
+		rx->stats->enq_pkts[cls]++;
+		if (rx->app_config->rtc_classes & (1 << cls)) {
+			rx->rtc_mbufs[nb_rtc++] = m;
+			continue;
+		}
+		/* a flow always lands in the same shard, keeping its packets in order */
+		bucket = (m->hash.rss % nb_tx_shards) * NUM_QOS_LEVELS + cls;
+		rx->cls_mbufs[bucket][rx->cls_cnt[bucket]++] = m;
+		cls_mask |= 1ULL << bucket;
+	}
+	/* run to completion classes skip the rings and the TX lcores */
+	if (nb_rtc != 0) {
+		dst_port = rx->port_id ^ 1;
+		nb_tx = vnf_tx_burst_timed(&rx->lat,
+					   dst_port,
+					   core_params_arr[rx->core_id].tx_queues[dst_port],
+					   rx->rtc_mbufs,
+					   nb_rtc);
+		rx->stats->tx_pkts += nb_tx;
+		if (unlikely(nb_tx < nb_rtc)) {
+			rx->stats->tx_freed += nb_rtc - nb_tx;
+			rte_pktmbuf_free_bulk(&rx->rtc_mbufs[nb_tx], nb_rtc - nb_tx);
+		}
+	}
+	while (cls_mask) {
+		bucket = rte_bsf64(cls_mask);
+		cls_mask &= cls_mask - 1;
+		shard = bucket / NUM_QOS_LEVELS;
+		cls = bucket % NUM_QOS_LEVELS;
+		simple_fwd_qos_enqueue(&rx->qos_enq,
+				       rx->port_id,
+				       cls,
+				       rx_ring_buffers[shard][rx->port_id][cls],
+				       rx->cls_mbufs[bucket],
+				       rx->cls_cnt[bucket]);
+		rx->cls_cnt[bucket] = 0;
+	}
+	return 0;
+}
+
+/* Core stages of the RX pipeline, the application ones run between classify and enqueue */
+static const struct app_vnf_stage vnf_parse_stage = {
+	.name = "parse",
+	.stage_init = &vnf_rx_stage_init,
+	.process_burst = &vnf_parse_burst,
+};
 
+static const struct app_vnf_stage vnf_classify_stage = {
+	.name = "classify",
+	.stage_init = &vnf_rx_stage_init,
+	.process_burst = &vnf_classify_burst,
+};
+
+static const struct app_vnf_stage vnf_enqueue_stage = {
+	.name = "enqueue",
+	.stage_init = &vnf_rx_stage_init,
+	.process_burst = &vnf_enqueue_burst,
+};
 
-    printf("queue: %d TOS: 0x%02x\n", queue_id, pinfo->tos);
+/*
+ * Chains the stages of the RX pipeline: parse, classify, the application stages and enqueue
+ *
+ * @app_config [in]: application configuration
+ * @vnf [in]: application the stages are taken from
+ * @return: 0 on success and negative value otherwise
+ */
+static int vnf_pipeline_build(struct simple_fwd_config *app_config, struct app_vnf *vnf)
+{
+	const struct app_vnf_stage *stages = NULL;
+	uint16_t nb_stages = 0, i;
+
+	if (simple_fwd_pipeline_add(&vnf_parse_stage) != 0 || simple_fwd_pipeline_add(&vnf_classify_stage) != 0)
+		return -1;
+	/* the flow table of the application is only used when offloading */
+	if (app_config->hw_offload && vnf->vnf_get_stages != NULL)
+		nb_stages = vnf->vnf_get_stages(&stages);
+	for (i = 0; i < nb_stages; i++) {
+		if (simple_fwd_pipeline_add(&stages[i]) != 0)
+			return -1;
+	}
+	return simple_fwd_pipeline_add(&vnf_enqueue_stage);
 }
 
 int process_rx_thread(uint32_t core_id, uint16_t queue_id) {
     uint16_t nb_rx, j;
-    int result;
-    uint64_t cur_tsc, last_tsc;
     struct rte_mbuf *mbufs[VNF_RX_BURST_SIZE];
+    struct simple_fwd_pkt_info pinfos[VNF_RX_BURST_SIZE];
     uint32_t port_id = 0;
     struct simple_fwd_config *app_config = ((struct simple_fwd_process_pkts_params *)&process_pkts_params)->cfg;
 	struct app_vnf *vnf = ((struct simple_fwd_process_pkts_params *)&process_pkts_params)->vnf;
-
-//    struct simple_fwd_config *app_config = ((struct simple_fwd_process_pkts_params *)process_pkts_params)->cfg;
-
-
-    last_tsc = rte_rdtsc();
+    struct vnf_rx_state rx;
+    struct simple_fwd_pipeline pipeline;
+    struct vnf_idle idle;
+    bool busy;
+    struct simple_fwd_rss_rxq *rxq;
+    /* the polls and buckets counters and the move fences only serve the RSS rebalancer */
+    bool rebalance = app_config->rebalance_ms != 0;
+    uint64_t start, now;
+
+    if (vnf_rx_state_init(&rx, core_id, queue_id, app_config) != 0) {
+        vnf_rx_state_fini(&rx);
+        return -1;
+    }
+    vnf_rx_states[core_id] = &rx;
+    if (simple_fwd_pipeline_lcore_init(&pipeline, core_id, queue_id) != 0) {
+        vnf_rx_states[core_id] = NULL;
+        vnf_rx_state_fini(&rx);
+        return -1;
+    }
+    memset(pinfos, 0, sizeof(pinfos));
+    vnf_idle_init(&idle);
     while (!force_quit) {
-        struct simple_fwd_pkt_info pinfo;
-        memset(&pinfo, 0, sizeof(struct simple_fwd_pkt_info));
-
+        busy = false;
         for (port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+            rxq = simple_fwd_rss_rxq_get(port_id, queue_id);
+            /* a queue given buckets of another one waits for it to handle their older packets */
+            if (rebalance && !simple_fwd_rss_rxq_poll(rxq, port_id))
+                continue;
+            start = rte_rdtsc();
             nb_rx = rte_eth_rx_burst(port_id, queue_id, mbufs, VNF_RX_BURST_SIZE);
-            for (j = 0; j < nb_rx; j++) {
-                if (simple_fwd_parse_packet(VNF_PKT_L2(mbufs[j]), VNF_PKT_LEN(mbufs[j]), &pinfo))
-                    continue;
-                pinfo.orig_data = mbufs[j];
-                pinfo.orig_port_id = mbufs[j]->port;
-                pinfo.pipe_queue = queue_id;
-                pinfo.rss_hash = mbufs[j]->hash.rss;
-                if (pinfo.outer.l3_type != IPV4)
-                    continue;
-                //vnf->vnf_process_pkt(&pinfo);
-                //vnf_adjust_mbuf(mbuf, &pinfo);
-                pinfo.tos = ((struct rte_ipv4_hdr *)pinfo.outer.l3)->type_of_service;
-                *GET_LATENCY_TS(mbufs[j]) = rte_rdtsc();
-                if (rte_ring_enqueue(rx_ring_buffers[port_id][pinfo.tos], mbufs[j]) < 0) {
-                    // ring 满了，先弹出一个
-                    void *old_mbuf;
-                    if (rte_ring_dequeue(rx_ring_buffers[port_id][pinfo.tos], &old_mbuf) == 0) {
-                        rte_pktmbuf_free((struct rte_mbuf *)old_mbuf);
-                        rte_ring_enqueue(rx_ring_buffers[port_id][pinfo.tos], mbufs[j]);
-                    } else {
-                        rte_pktmbuf_free(mbufs[j]);
-                    }
+            __atomic_store_n(&rxq->taken, rxq->taken + nb_rx, __ATOMIC_RELEASE);
+            busy |= nb_rx != 0;
+            /* empty polls are accounted by the idle back-off, not as stage cycles */
+            if (nb_rx != 0) {
+                now = rte_rdtsc();
+                rx.stats->rx_pkts += nb_rx;
+                rx.stats->cycles[SIMPLE_FWD_STATS_STAGE_RX] += now - start;
+                rx.rx_tsc = now;
+                rx.port_id = port_id;
+                if (unlikely(now >= rx.lat.hw.next_sync))
+                    simple_fwd_latency_hw_sync(&rx.lat.hw, now);
+                if (rebalance) {
+                    for (j = 0; j < nb_rx; j++)
+                        rxq->bucket_pkts[SIMPLE_FWD_RSS_BUCKET(mbufs[j]->hash.rss)]++;
                 }
+                simple_fwd_pipeline_run(&pipeline, mbufs, pinfos, nb_rx, now);
             }
+            __atomic_store_n(&rxq->done, rxq->done + nb_rx, __ATOMIC_RELEASE);
             if (app_config->age_thread)
                 vnf->vnf_flow_age(port_id, queue_id);
         }
+        vnf_idle_poll(&idle, app_config, busy);
     }
+    simple_fwd_pipeline_lcore_fini(&pipeline);
+    vnf_rx_states[core_id] = NULL;
+    vnf_rx_state_fini(&rx);
     return 0;
 }
 
+/*
+ * Moves the ownership of a TX shard
+ *
+ * @shard [in]: TX shard
+ * @from [in]: owner the shard is expected to have
+ * @to [in]: new owner
+ * @return: true if the shard had the expected owner and changed hands
+ */
+static bool vnf_tx_shard_take(struct vnf_tx_shard *shard, enum vnf_tx_shard_owner from, enum vnf_tx_shard_owner to)
+{
+	uint32_t expected = from;
+
+	return __atomic_compare_exchange_n(&shard->owner, &expected, to, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/*
+ * Helps a shard lent by its home TX lcore: takes a bounded batch per port from its rings, and hands
+ * it all to the NIC on the TX queues of the home TX lcore before giving the shard back. The NIC sends
+ * the packets of a queue in order, so the home TX lcore only ever sends packets after the stolen ones.
+ *
+ * @shard_id [in]: TX shard to help
+ * @tx_bufs [in]: TX buffers of the calling lcore, empty
+ * @lat [in]: latency sampling state of the calling lcore
+ * @stats [in/out]: counters of the calling lcore
+ * @return: number of packets taken
+ */
+static uint16_t vnf_tx_steal(int shard_id,
+			     struct vnf_tx_buffer *tx_bufs,
+			     const struct vnf_latency *lat,
+			     struct simple_fwd_lcore_stats *stats)
+{
+	struct vnf_tx_shard *shard = &tx_shards[shard_id];
+	struct vnf_tx_buffer *buf;
+	uint16_t nb_stolen = 0;
+	int port_id;
+
+	if (!vnf_tx_shard_take(shard, VNF_TX_SHARD_LENT, VNF_TX_SHARD_STOLEN))
+		return 0;
+	for (port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+		buf = &tx_bufs[port_id];
+		buf->cnt = simple_fwd_qos_steal(rx_ring_buffers[shard_id][port_id], port_id, buf->pkts, VNF_TX_STEAL_BATCH);
+		if (buf->cnt == 0)
+			continue;
+		stats->deq_pkts += buf->cnt;
+		nb_stolen += buf->cnt;
+		vnf_latency_stamp_deq(lat, buf->pkts, buf->cnt, rte_rdtsc());
+		/* the home TX lcore waits for its shard, which goes back with nothing buffered */
+		while (buf->cnt != 0 && !force_quit)
+			vnf_tx_buffer_flush(buf, port_id ^ 1, shard->tx_queues[port_id ^ 1], lat, stats);
+	}
+	__atomic_store_n(&shard->owner, VNF_TX_SHARD_LENT, __ATOMIC_RELEASE);
+	return nb_stolen;
+}
+
 int process_tx_thread(uint32_t core_id) {
-    struct rte_mbuf *tx_mbufs[VNF_TX_BURST_SIZE];
-    uint16_t nb_tx, nb_deq;
+    uint16_t nb_deq;
+    struct simple_fwd_config *app_config = ((struct simple_fwd_process_pkts_params *)&process_pkts_params)->cfg;
+    struct simple_fwd_qos_sched sched[NUM_OF_PORTS];
+    struct vnf_tx_buffer tx_bufs[NUM_OF_PORTS];
+    struct vnf_tx_buffer *buf;
+    uint64_t flush_cycles = rte_get_tsc_hz() * app_config->tx_flush_us / US_PER_S;
+    uint64_t now;
+    int home_shard = core_params_arr[core_id].tx_shard;
+    int victim = home_shard;
+    bool idle, pending, drained, lent = false;
+    struct vnf_idle idle_state;
+    struct simple_fwd_lcore_stats *stats = simple_fwd_stats_get(core_id);
+    uint64_t start;
+    struct vnf_latency lat;
+
+    if (vnf_latency_init(&lat, core_id, app_config->latency_sample) != 0)
+        return -1;
+    memset(tx_bufs, 0, sizeof(tx_bufs));
+    vnf_idle_init(&idle_state);
+    for (int port_id = 0; port_id < NUM_OF_PORTS; port_id++)
+        simple_fwd_qos_sched_init(&sched[port_id], &app_config->qos, port_id, rx_ring_buffers[home_shard][port_id],
+                                  latency_dynfield_offset + offsetof(struct simple_fwd_latency_ts, enq));
 
     while (!force_quit) {
+        /* a lent shard comes back once the lcore helping it has sent all it took, the lcore idles meanwhile */
+        if (lent) {
+            if (!vnf_tx_shard_take(&tx_shards[home_shard], VNF_TX_SHARD_LENT, VNF_TX_SHARD_HOME)) {
+                vnf_idle_poll(&idle_state, app_config, false);
+                continue;
+            }
+            lent = false;
+        }
+
+        idle = true;
         for (int port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
-            for (int prio = NUM_QOS_LEVELS - 1; prio >= 0; prio--) {
-                nb_deq = rte_ring_dequeue_burst(rx_ring_buffers[port_id][prio],
-                                                (void **)tx_mbufs,
-                                                VNF_TX_BURST_SIZE,
-                                                NULL);
-                if (nb_deq == 0)
-                    continue;
-
-                uint16_t dst_port = port_id ^ 1;
-
-                // TX：计算差值
-                uint64_t delta = rte_rdtsc() - *GET_LATENCY_TS(tx_mbufs[0]);
-                double latency_ns = (double)delta * 1e9 / rte_get_tsc_hz();
-                fprintf(latency_log, "%.2f\n", latency_ns);
-
-                nb_tx = rte_eth_tx_burst(dst_port, 0, tx_mbufs, nb_deq);
-//                printf("core %u, port %u -> %u, prio %d, dequeued %u, sent %u\n",
-//                       core_id, port_id, dst_port, prio, nb_deq, nb_tx);
-
-                if (unlikely(nb_tx < nb_deq)) {
-                    for (uint16_t i = nb_tx; i < nb_deq; i++)
-                        rte_pktmbuf_free(tx_mbufs[i]);
-                }
+            uint16_t dst_port = port_id ^ 1;
+            uint16_t tx_queue = core_params_arr[core_id].tx_queues[dst_port];
+
+            buf = &tx_bufs[port_id];
+            start = rte_rdtsc();
+            /* a full buffer leaves the packets in the rings, where the drop policy applies */
+            nb_deq = simple_fwd_qos_sched_dequeue(&sched[port_id], &buf->pkts[buf->cnt],
+                                                  RTE_MIN(VNF_TX_BURST_SIZE, VNF_TX_BUFFER_SIZE - buf->cnt));
+            if (nb_deq != 0)
+                idle = false;
+            if (buf->cnt == 0 && nb_deq == 0)
+                continue;
+
+            now = rte_rdtsc();
+            if (nb_deq != 0) {
+                stats->deq_pkts += nb_deq;
+                stats->cycles[SIMPLE_FWD_STATS_STAGE_SCHED] += now - start;
+
+                vnf_latency_stamp_deq(&lat, &buf->pkts[buf->cnt], nb_deq, now);
+
+                if (buf->cnt == 0)
+                    buf->deadline = now + flush_cycles;
+                buf->cnt += nb_deq;
             }
+
+            /* small bursts wait for more packets, unless a class asks for an immediate flush */
+            if (buf->cnt < app_config->tx_min_burst && !sched[port_id].flush && now < buf->deadline)
+                continue;
+            vnf_tx_buffer_flush(buf, dst_port, tx_queue, &lat, stats);
+            sched[port_id].flush = false;
+        }
+
+        /* buffered packets wait for their flush deadline, not for a back-off sleep */
+        pending = false;
+        drained = true;
+        for (int port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+            pending |= tx_bufs[port_id].cnt != 0;
+            drained &= simple_fwd_qos_sched_empty(&sched[port_id]);
+        }
+
+        /*
+         * Nothing left at home: lend the shard, whose older packets are all sent, and help one lent
+         * by another lcore. The packets of a flow thus leave one lcore at a time, in order.
+         */
+        if (tx_steal && idle && !pending && drained) {
+            __atomic_store_n(&tx_shards[home_shard].owner, VNF_TX_SHARD_LENT, __ATOMIC_RELEASE);
+            lent = true;
+            victim = (victim + 1) % nb_tx_shards;
+            if (victim == home_shard)
+                victim = (victim + 1) % nb_tx_shards;
+            if (vnf_tx_steal(victim, tx_bufs, &lat, stats) != 0)
+                idle = false;
         }
+        vnf_idle_poll(&idle_state, app_config, !idle || pending);
     }
 
+    for (int port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+        buf = &tx_bufs[port_id];
+        if (buf->cnt != 0)
+            vnf_tx_buffer_flush(buf, port_id ^ 1, core_params_arr[core_id].tx_queues[port_id ^ 1], &lat, stats);
+        stats->tx_freed += buf->cnt;
+        rte_pktmbuf_free_bulk(buf->pkts, buf->cnt);
+        simple_fwd_qos_sched_flush(&sched[port_id]);
+    }
     return 0;
 }
 
 
 int process_rate_limiter() {
+    uint64_t period = rte_get_tsc_hz() * VNF_RATE_LIMITER_PERIOD_US / US_PER_S;
+    uint64_t last_tsc = rte_rdtsc();
+    uint64_t cur_tsc;
+
+    simple_fwd_qos_shaper_start();
+    while (!force_quit) {
+        cur_tsc = rte_rdtsc();
+        /* refilling on every loop would keep the buckets cache lines bouncing with the TX lcores */
+        if (cur_tsc - last_tsc < period) {
+            rte_pause();
+            continue;
+        }
+        simple_fwd_qos_shaper_refill(cur_tsc);
+        last_tsc = cur_tsc;
+    }
     return 0;
 }
 
-
-void register_latency_field() {
-    struct rte_mbuf_dynfield field_desc = {
-            .name = "latency_ts",
-            .size = sizeof(uint64_t),
-            .align = __alignof__(uint64_t),
-            .flags = 0,
-    };
-    latency_dynfield_offset = rte_mbuf_dynfield_register(&field_desc);
-    if (latency_dynfield_offset < 0) {
-        rte_exit(EXIT_FAILURE, "Cannot register latency dynfield\n");
+/*
+ * Runs the control work of the main lcore until the application stops: the stats report every
+ * stats_timer, and the RX queues rebalancing every rebalance_ms
+ *
+ * @vnf [in]: application resources, updating the RSS queues
+ * @app_config [in]: application configuration
+ * @return: 0 on success and negative value otherwise
+ */
+static int process_main_lcore(struct app_vnf *vnf, struct simple_fwd_config *app_config)
+{
+    struct simple_fwd_rss_ctx rss;
+    uint64_t rebalance_cycles = rte_get_timer_hz() * app_config->rebalance_ms / MS_PER_S;
+    uint64_t cur_tsc, last_stats, last_rebalance;
+    uint16_t port_id;
+
+    if (rebalance_cycles != 0 &&
+        simple_fwd_rss_init(&rss, vnf->vnf_set_rss, app_config->dpdk_cfg->port_config.nb_queues, rx_polled_mask,
+                            app_config->rebalance_threshold, app_config->idle_sleep_us) != 0)
+        return -1;
+    last_stats = last_rebalance = rte_get_timer_cycles();
+    while (!force_quit) {
+        rte_delay_us_sleep(VNF_MAIN_PERIOD_US);
+        cur_tsc = rte_get_timer_cycles();
+        if (app_config->stats_timer != 0 && cur_tsc - last_stats >= app_config->stats_timer) {
+            simple_fwd_stats_dump();
+            last_stats = cur_tsc;
+        }
+        if (rebalance_cycles != 0 && cur_tsc - last_rebalance >= rebalance_cycles) {
+            for (port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+                if (simple_fwd_rss_rebalance(&rss, port_id) != 0)
+                    return -1;
+            }
+            last_rebalance = cur_tsc;
+        }
     }
+    if (rebalance_cycles != 0)
+        DOCA_LOG_INFO("RSS rebalancer moved %lu buckets", rss.moves);
+    return 0;
 }
 
-
-int simple_fwd_process_pkts(void *process_pkts_params)
+/*
+ * Registers the mbuf dynamic field carrying the timestamps of the packets
+ *
+ * @return: 0 on success and negative value otherwise
+ */
+static int register_latency_field(void)
 {
-    //        if (core_id == rte_get_main_lcore()) {
-//            cur_tsc = rte_rdtsc();
-//            if (cur_tsc > last_tsc + app_config->stats_timer) {
-//                result = vnf->vnf_dump_stats(0);
-//                if (result != 0)
-//                    return result;
-//                last_tsc = cur_tsc;
-//            }
-//        }
+	struct rte_mbuf_dynfield field_desc = {
+		.name = "latency_ts",
+		.size = sizeof(struct simple_fwd_latency_ts),
+		.align = __alignof__(uint64_t),
+		.flags = 0,
+	};
+
+	latency_dynfield_offset = rte_mbuf_dynfield_register(&field_desc);
+	if (latency_dynfield_offset < 0) {
+		DOCA_LOG_ERR("Cannot register latency dynfield: %s", rte_strerror(rte_errno));
+		return -1;
+	}
+	return 0;
+}
 
-    register_latency_field();
+int simple_fwd_process_pkts_init(struct simple_fwd_config *app_config, struct app_vnf *vnf)
+{
+	unsigned int lcore_id;
+
+	if (register_latency_field() != 0)
+		return -1;
+	if (vnf_pipeline_build(app_config, vnf) != 0)
+		return -1;
+	if (app_config->latency_sample == 0)
+		return 0;
+	/* the lcores recording latencies, RX ones for their run to completion classes */
+	RTE_LCORE_FOREACH_WORKER(lcore_id) {
+		if (core_params_arr[lcore_id].used != RX && core_params_arr[lcore_id].used != TX)
+			continue;
+		if (simple_fwd_latency_lcore_init(lcore_id) == NULL)
+			return -1;
+	}
+	return 0;
+}
 
+int simple_fwd_process_pkts(void *process_pkts_params)
+{
 	uint32_t core_id = rte_lcore_id();
 	struct vnf_per_core_params *params = &core_params_arr[core_id];
+	struct simple_fwd_config *cfg = ((struct simple_fwd_process_pkts_params *)process_pkts_params)->cfg;
 
     if(params->used == RX) {
         DOCA_LOG_TRC("Core %u process queue %u start", core_id, params->queues[0]);
@@ -261,6 +1087,12 @@ int simple_fwd_process_pkts(void *process_pkts_params)
     }else if (params->used == TX) {
         printf("Core %u use for tx\n", core_id);
         process_tx_thread(core_id);
+    }else if (params->used == RATE_LIMITER) {
+        DOCA_LOG_INFO("Core %u use for rate limiter", core_id);
+        process_rate_limiter();
+    }else if (core_id == rte_get_main_lcore()) {
+        DOCA_LOG_INFO("Core %u use for stats and RSS rebalancing", core_id);
+        process_main_lcore(((struct simple_fwd_process_pkts_params *)process_pkts_params)->vnf, cfg);
     }else{
         printf("Core %u use for other\n", core_id);
     }
@@ -375,43 +1207,722 @@ static doca_error_t age_thread_callback(void *param, void *config)
 }
 
 /*
- * Registers all flags used by the application for DOCA argument parser, so that when parsing
- * it can be parsed accordingly
+ * ARGP Callback - Handle hardware timestamp parameter
+ *
+ * @param [in]: Input parameter
+ * @config [in/out]: Program configuration context
  * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
  */
-doca_error_t register_simple_fwd_params(void)
+static doca_error_t hw_timestamp_callback(void *param, void *config)
 {
-	doca_error_t result;
-	struct doca_argp_param *stats_param, *nr_queues_param, *rx_only_param, *hw_offload_param;
-	struct doca_argp_param *hairpinq_param, *age_thread_param;
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
 
-	/* Create and register stats timer param */
-	result = doca_argp_param_create(&stats_param);
-	if (result != DOCA_SUCCESS) {
-		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
-		return result;
-	}
-	doca_argp_param_set_short_name(stats_param, "t");
-	doca_argp_param_set_long_name(stats_param, "stats-timer");
-	doca_argp_param_set_arguments(stats_param, "<time>");
-	doca_argp_param_set_description(stats_param, "Set interval to dump stats information");
-	doca_argp_param_set_callback(stats_param, stats_callback);
-	doca_argp_param_set_type(stats_param, DOCA_ARGP_TYPE_INT);
-	result = doca_argp_register_param(stats_param);
-	if (result != DOCA_SUCCESS) {
-		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
-		return result;
-	}
+	app_config->hw_timestamp = *(bool *)param;
+	DOCA_LOG_DBG("Set hw_timestamp:%s", app_config->hw_timestamp ? "true" : "false");
+	return DOCA_SUCCESS;
+}
 
-	/* Create and register queues number param */
-	result = doca_argp_param_create(&nr_queues_param);
-	if (result != DOCA_SUCCESS) {
-		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
-		return result;
+/*
+ * Callback function for setting the minimal depth of the RX packet parsing
+ *
+ * @param [in]: parse level name, one of "l2", "dscp", "5tuple" or "tunnel"
+ * @config [out]: application configuration to set the parse level
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t parse_level_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *level = (const char *)param;
+
+	if (strcmp(level, "l2") == 0)
+		app_config->parse_level = SIMPLE_FWD_PARSE_L2;
+	else if (strcmp(level, "dscp") == 0)
+		app_config->parse_level = SIMPLE_FWD_PARSE_L3_DSCP;
+	else if (strcmp(level, "5tuple") == 0)
+		app_config->parse_level = SIMPLE_FWD_PARSE_5TUPLE;
+	else if (strcmp(level, "tunnel") == 0)
+		app_config->parse_level = SIMPLE_FWD_PARSE_TUNNEL;
+	else {
+		DOCA_LOG_ERR("Invalid parse level %s, should be l2, dscp, 5tuple or tunnel", level);
+		return DOCA_ERROR_INVALID_VALUE;
 	}
-	doca_argp_param_set_short_name(nr_queues_param, "q");
-	doca_argp_param_set_long_name(nr_queues_param, "nr-queues");
-	doca_argp_param_set_arguments(nr_queues_param, "<num>");
+	DOCA_LOG_DBG("Set parse_level:%s", level);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the IPv4 reassembly
+ *
+ * @param [in]: parameter indicates whether or not to reassemble IPv4 fragments
+ * @config [out]: application configuration to set the IPv4 reassembly
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t frag_reassembly_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+
+	app_config->frag_reassembly = *(bool *)param;
+	DOCA_LOG_DBG("Set frag_reassembly:%s", app_config->frag_reassembly ? "true" : "false");
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the QoS rings synchronization mode
+ *
+ * @param [in]: synchronization mode name, one of "auto", "mt", "rts" or "hts"
+ * @config [out]: application configuration to set the rings synchronization mode
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t ring_sync_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *sync = (const char *)param;
+
+	if (strcmp(sync, "auto") == 0)
+		app_config->ring_sync = SIMPLE_FWD_RING_SYNC_AUTO;
+	else if (strcmp(sync, "mt") == 0)
+		app_config->ring_sync = SIMPLE_FWD_RING_SYNC_MT;
+	else if (strcmp(sync, "rts") == 0)
+		app_config->ring_sync = SIMPLE_FWD_RING_SYNC_RTS;
+	else if (strcmp(sync, "hts") == 0)
+		app_config->ring_sync = SIMPLE_FWD_RING_SYNC_HTS;
+	else {
+		DOCA_LOG_ERR("Invalid ring sync mode %s, should be auto, mt, rts or hts", sync);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	DOCA_LOG_DBG("Set ring_sync:%s", sync);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the field packets are classified on
+ *
+ * @param [in]: classification source name, one of "dscp", "pcp" or "inner-dscp"
+ * @config [out]: application configuration to set the classification source
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t qos_source_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *source = (const char *)param;
+
+	if (strcmp(source, "dscp") == 0)
+		app_config->qos.source = SIMPLE_FWD_QOS_SRC_DSCP;
+	else if (strcmp(source, "pcp") == 0)
+		app_config->qos.source = SIMPLE_FWD_QOS_SRC_PCP;
+	else if (strcmp(source, "inner-dscp") == 0)
+		app_config->qos.source = SIMPLE_FWD_QOS_SRC_INNER_DSCP;
+	else {
+		DOCA_LOG_ERR("Invalid QoS source %s, should be dscp, pcp or inner-dscp", source);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	DOCA_LOG_DBG("Set qos_source:%s", source);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the DSCP to traffic class mapping
+ *
+ * @param [in]: list of "<dscp>:<class>" pairs, DSCP values not listed keep their class selector
+ * @config [out]: application configuration to set the DSCP mapping
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t dscp_map_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *map = (const char *)param;
+	doca_error_t result;
+
+	result = simple_fwd_qos_parse_map(map, app_config->qos.dscp_to_tc, SIMPLE_FWD_QOS_NB_DSCP,
+					  SIMPLE_FWD_QOS_NB_TC - 1);
+	if (result != DOCA_SUCCESS)
+		return result;
+	DOCA_LOG_DBG("Set dscp_map:%s", map);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the VLAN PCP to traffic class mapping
+ *
+ * @param [in]: list of "<pcp>:<class>" pairs, PCP values not listed are used as the class
+ * @config [out]: application configuration to set the PCP mapping
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t pcp_map_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *map = (const char *)param;
+	doca_error_t result;
+
+	result = simple_fwd_qos_parse_map(map, app_config->qos.pcp_to_tc, SIMPLE_FWD_QOS_NB_PCP,
+					  SIMPLE_FWD_QOS_NB_TC - 1);
+	if (result != DOCA_SUCCESS)
+		return result;
+	DOCA_LOG_DBG("Set pcp_map:%s", map);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the TX scheduling discipline
+ *
+ * @param [in]: scheduling mode name, one of "strict", "drr" or "wfq"
+ * @config [out]: application configuration to set the scheduling mode
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t sched_mode_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *mode = (const char *)param;
+
+	if (strcmp(mode, "strict") == 0)
+		app_config->qos.sched_mode = SIMPLE_FWD_QOS_SCHED_STRICT;
+	else if (strcmp(mode, "drr") == 0)
+		app_config->qos.sched_mode = SIMPLE_FWD_QOS_SCHED_DRR;
+	else if (strcmp(mode, "wfq") == 0)
+		app_config->qos.sched_mode = SIMPLE_FWD_QOS_SCHED_WFQ;
+	else {
+		DOCA_LOG_ERR("Invalid scheduling mode %s, should be strict, drr or wfq", mode);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	DOCA_LOG_DBG("Set sched_mode:%s", mode);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the number of classes served in strict priority
+ *
+ * @param [in]: number of highest classes served before the weighted ones
+ * @config [out]: application configuration to set the number of strict classes
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t sched_strict_classes_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	int nb_strict_tc = *(int *)param;
+
+	if (nb_strict_tc < 0 || nb_strict_tc > SIMPLE_FWD_QOS_NB_TC) {
+		DOCA_LOG_ERR("Invalid sched_strict_classes %d, should be in [0, %d]", nb_strict_tc, SIMPLE_FWD_QOS_NB_TC);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	app_config->qos.nb_strict_tc = nb_strict_tc;
+	DOCA_LOG_DBG("Set sched_strict_classes:%d", nb_strict_tc);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the class weights of the scheduler
+ *
+ * @param [in]: list of "<class>:<weight>" pairs, for all ports or per port separated by ';'
+ * @config [out]: application configuration to set the weights
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t sched_weights_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *weights = (const char *)param;
+	doca_error_t result;
+
+	result = simple_fwd_qos_parse_weights(weights, &app_config->qos);
+	if (result != DOCA_SUCCESS)
+		return result;
+	DOCA_LOG_DBG("Set sched_weights:%s", weights);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the class shaping rates
+ *
+ * @param [in]: list of "<class>:<cir>[:<pir>]" entries in Mbps, for all ports or per port separated by ';'
+ * @config [out]: application configuration to set the rates
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t sched_rates_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *rates = (const char *)param;
+	doca_error_t result;
+
+	result = simple_fwd_qos_parse_rates(rates, &app_config->qos);
+	if (result != DOCA_SUCCESS)
+		return result;
+	DOCA_LOG_DBG("Set sched_rates:%s", rates);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the drop policy of the classes
+ *
+ * @param [in]: a single policy for all classes, or a list of "<class>:<policy>" pairs
+ * @config [out]: application configuration to set the drop policies
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t drop_policy_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *policy = (const char *)param;
+	doca_error_t result;
+
+	result = simple_fwd_qos_parse_drop_policy(policy, &app_config->qos);
+	if (result != DOCA_SUCCESS)
+		return result;
+	DOCA_LOG_DBG("Set drop_policy:%s", policy);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the RED parameters
+ *
+ * @param [in]: "<min>:<max>:<max_p>" in percents
+ * @config [out]: application configuration to set the RED parameters
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t red_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *red = (const char *)param;
+	doca_error_t result;
+
+	result = simple_fwd_qos_parse_red(red, &app_config->qos);
+	if (result != DOCA_SUCCESS)
+		return result;
+	DOCA_LOG_DBG("Set red:%s", red);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the CoDel parameters
+ *
+ * @param [in]: "<target>:<interval>" in microseconds
+ * @config [out]: application configuration to set the CoDel parameters
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t codel_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *codel = (const char *)param;
+	doca_error_t result;
+
+	result = simple_fwd_qos_parse_codel(codel, &app_config->qos);
+	if (result != DOCA_SUCCESS)
+		return result;
+	DOCA_LOG_DBG("Set codel:%s", codel);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Parses a comma separated list of traffic classes
+ *
+ * @classes [in]: list of classes, empty for none
+ * @mask [out]: bitmask of the listed classes
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t parse_class_list(const char *classes, uint32_t *mask)
+{
+	const char *ptr = classes;
+	unsigned long cls;
+	char *end;
+
+	*mask = 0;
+	while (*ptr != '\0') {
+		errno = 0;
+		cls = strtoul(ptr, &end, 0);
+		if (errno != 0 || end == ptr || cls >= NUM_QOS_LEVELS || (*end != ',' && *end != '\0')) {
+			DOCA_LOG_ERR("Invalid class list %s, should be a list of classes below %d", classes, NUM_QOS_LEVELS);
+			return DOCA_ERROR_INVALID_VALUE;
+		}
+		*mask |= 1 << cls;
+		ptr = (*end == ',') ? end + 1 : end;
+	}
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the classes sent by the RX lcores
+ *
+ * @param [in]: comma separated list of classes, empty for none
+ * @config [out]: application configuration to set the run to completion classes
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t rtc_classes_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *classes = (const char *)param;
+	doca_error_t result;
+
+	result = parse_class_list(classes, &app_config->rtc_classes);
+	if (result != DOCA_SUCCESS)
+		return result;
+	DOCA_LOG_DBG("Set rtc_classes:%s", classes);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the minimal TX burst
+ *
+ * @param [in]: number of packets buffered before sending, 1 to send right away
+ * @config [out]: application configuration to set the minimal TX burst
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t tx_min_burst_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	int min_burst = *(int *)param;
+
+	if (min_burst < 1 || min_burst > VNF_TX_BURST_SIZE) {
+		DOCA_LOG_ERR("Invalid tx_min_burst %d, should be in [1, %d]", min_burst, VNF_TX_BURST_SIZE);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	app_config->tx_min_burst = min_burst;
+	DOCA_LOG_DBG("Set tx_min_burst:%d", min_burst);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the TX flush deadline
+ *
+ * @param [in]: maximal time a packet waits for a TX burst to fill, in microseconds
+ * @config [out]: application configuration to set the TX flush deadline
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t tx_flush_us_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	int flush_us = *(int *)param;
+
+	if (flush_us < 0) {
+		DOCA_LOG_ERR("Invalid tx_flush_us %d, should be >= 0", flush_us);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	app_config->tx_flush_us = flush_us;
+	DOCA_LOG_DBG("Set tx_flush_us:%d", flush_us);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the number of empty polls before backing off
+ *
+ * @param [in]: number of consecutive empty polls, 0 to always busy poll
+ * @config [out]: application configuration to set the idle back-off threshold
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t idle_polls_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	int idle_polls = *(int *)param;
+
+	if (idle_polls < 0) {
+		DOCA_LOG_ERR("Invalid idle_polls %d, should be >= 0", idle_polls);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	app_config->idle_polls = idle_polls;
+	DOCA_LOG_DBG("Set idle_polls:%d", idle_polls);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the maximal idle back-off sleep
+ *
+ * @param [in]: maximal sleep of an idle lcore, in microseconds, 0 to only pause
+ * @config [out]: application configuration to set the idle back-off sleep
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t idle_sleep_us_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	int sleep_us = *(int *)param;
+
+	if (sleep_us < 0) {
+		DOCA_LOG_ERR("Invalid idle_sleep_us %d, should be >= 0", sleep_us);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	app_config->idle_sleep_us = sleep_us;
+	DOCA_LOG_DBG("Set idle_sleep_us:%d", sleep_us);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the RSS rebalancing period
+ *
+ * @param [in]: time between two RX queues load samples, in milliseconds, 0 to never rebalance
+ * @config [out]: application configuration to set the rebalancing period
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t rebalance_ms_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	int rebalance_ms = *(int *)param;
+
+	if (rebalance_ms < 0) {
+		DOCA_LOG_ERR("Invalid rebalance_ms %d, should be >= 0", rebalance_ms);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	app_config->rebalance_ms = rebalance_ms;
+	DOCA_LOG_DBG("Set rebalance_ms:%d", rebalance_ms);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the RSS rebalancing threshold
+ *
+ * @param [in]: load gap between the busiest and idlest queues moving a bucket, in percents of the average
+ * @config [out]: application configuration to set the rebalancing threshold
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t rebalance_threshold_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	int threshold = *(int *)param;
+
+	if (threshold < 0) {
+		DOCA_LOG_ERR("Invalid rebalance_threshold %d, should be >= 0", threshold);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	app_config->rebalance_threshold = threshold;
+	DOCA_LOG_DBG("Set rebalance_threshold:%d", threshold);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP Callback - Handle latency sampling parameter
+ *
+ * @param [in]: Input parameter
+ * @config [in/out]: Program configuration context
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t latency_sample_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	int latency_sample = *(int *)param;
+
+	if (latency_sample < 0) {
+		DOCA_LOG_ERR("Invalid latency_sample %d, should be >= 0", latency_sample);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	app_config->latency_sample = latency_sample;
+	DOCA_LOG_DBG("Set latency_sample:%d", latency_sample);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP Callback - Handle latency trace file parameter
+ *
+ * @param [in]: Input parameter
+ * @config [in/out]: Program configuration context
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t latency_trace_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *path = (const char *)param;
+
+	if (strnlen(path, PATH_MAX) == PATH_MAX) {
+		DOCA_LOG_ERR("Latency trace path too long, should be shorter than %d", PATH_MAX);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	strcpy(app_config->latency_trace, path);
+	DOCA_LOG_DBG("Set latency_trace:%s", path);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP Callback - Handle latency trace records parameter
+ *
+ * @param [in]: Input parameter
+ * @config [in/out]: Program configuration context
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t latency_trace_records_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	int records = *(int *)param;
+
+	if (records <= 0 || !rte_is_power_of_2(records)) {
+		DOCA_LOG_ERR("Invalid latency_trace_records %d, should be a power of 2", records);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	app_config->latency_trace_records = records;
+	DOCA_LOG_DBG("Set latency_trace_records:%d", records);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Parses a comma separated list of lcores and lcore ranges, such as "1-4,8"
+ *
+ * @str [in]: list of lcores
+ * @lcores [out]: listed lcores, in order
+ * @nb_lcores [out]: number of listed lcores
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t parse_lcore_list(const char *str, uint16_t *lcores, uint16_t *nb_lcores)
+{
+	const char *ptr = str;
+	unsigned long first, last;
+	char *end;
+
+	*nb_lcores = 0;
+	while (*ptr != '\0') {
+		errno = 0;
+		first = strtoul(ptr, &end, 0);
+		last = first;
+		if (errno == 0 && end != ptr && *end == '-') {
+			ptr = end + 1;
+			last = strtoul(ptr, &end, 0);
+		}
+		if (errno != 0 || end == ptr || last < first || last >= RTE_MAX_LCORE ||
+		    *nb_lcores + last - first >= RTE_MAX_LCORE || (*end != ',' && *end != '\0')) {
+			DOCA_LOG_ERR("Invalid lcore list %s, should be lcores or ranges below %d", str, RTE_MAX_LCORE);
+			return DOCA_ERROR_INVALID_VALUE;
+		}
+		while (first <= last)
+			lcores[(*nb_lcores)++] = first++;
+		ptr = (*end == ',') ? end + 1 : end;
+	}
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the RX lcores
+ *
+ * @param [in]: list of lcores, empty for one per queue from the first free worker
+ * @config [out]: application configuration to set the RX lcores
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t rx_lcores_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *lcores = (const char *)param;
+	doca_error_t result;
+
+	result = parse_lcore_list(lcores, app_config->topology.rx, &app_config->topology.nb_rx);
+	if (result != DOCA_SUCCESS)
+		return result;
+	DOCA_LOG_DBG("Set rx_lcores:%s", lcores);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the TX lcores
+ *
+ * @param [in]: list of lcores, empty for all the remaining free workers
+ * @config [out]: application configuration to set the TX lcores
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t tx_lcores_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *lcores = (const char *)param;
+	doca_error_t result;
+
+	result = parse_lcore_list(lcores, app_config->topology.tx, &app_config->topology.nb_tx);
+	if (result != DOCA_SUCCESS)
+		return result;
+	DOCA_LOG_DBG("Set tx_lcores:%s", lcores);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the rate limiter lcore
+ *
+ * @param [in]: lcore identifier, -1 for the next free worker
+ * @config [out]: application configuration to set the rate limiter lcore
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t rate_limiter_lcore_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	int lcore_id = *(int *)param;
+
+	if (lcore_id < -1 || lcore_id >= RTE_MAX_LCORE) {
+		DOCA_LOG_ERR("Invalid rate_limiter_lcore %d, should be in [-1, %d)", lcore_id, RTE_MAX_LCORE);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	app_config->topology.rate_limiter = lcore_id;
+	DOCA_LOG_DBG("Set rate_limiter_lcore:%d", lcore_id);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the strict NUMA mode
+ *
+ * @param [in]: true to reject lcores remote to the ports, false to only warn
+ * @config [out]: application configuration to set the strict NUMA mode
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t numa_strict_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+
+	app_config->topology.numa_strict = *(bool *)param;
+	DOCA_LOG_DBG("Set numa_strict:%s", app_config->topology.numa_strict ? "true" : "false");
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Callback function for setting the classes flushed right away
+ *
+ * @param [in]: comma separated list of classes, empty for none
+ * @config [out]: application configuration to set the flushed classes
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t tx_flush_classes_callback(void *param, void *config)
+{
+	struct simple_fwd_config *app_config = (struct simple_fwd_config *)config;
+	const char *classes = (const char *)param;
+	doca_error_t result;
+
+	result = parse_class_list(classes, &app_config->qos.flush_classes);
+	if (result != DOCA_SUCCESS)
+		return result;
+	DOCA_LOG_DBG("Set tx_flush_classes:%s", classes);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Registers all flags used by the application for DOCA argument parser, so that when parsing
+ * it can be parsed accordingly
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+doca_error_t register_simple_fwd_params(void)
+{
+	doca_error_t result;
+	struct doca_argp_param *stats_param, *nr_queues_param, *rx_only_param, *hw_offload_param;
+	struct doca_argp_param *hairpinq_param, *age_thread_param, *parse_level_param, *frag_reassembly_param;
+	struct doca_argp_param *ring_sync_param, *qos_source_param, *dscp_map_param, *pcp_map_param;
+	struct doca_argp_param *sched_mode_param, *sched_strict_classes_param, *sched_weights_param;
+	struct doca_argp_param *sched_rates_param, *drop_policy_param, *red_param, *codel_param;
+	struct doca_argp_param *rtc_classes_param, *tx_min_burst_param, *tx_flush_us_param, *tx_flush_classes_param;
+	struct doca_argp_param *idle_polls_param, *idle_sleep_us_param;
+	struct doca_argp_param *rx_lcores_param, *tx_lcores_param, *rate_limiter_lcore_param, *numa_strict_param;
+	struct doca_argp_param *rebalance_ms_param, *rebalance_threshold_param, *latency_sample_param;
+	struct doca_argp_param *latency_trace_param, *latency_trace_records_param, *hw_timestamp_param;
+
+	/* Create and register stats timer param */
+	result = doca_argp_param_create(&stats_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_short_name(stats_param, "t");
+	doca_argp_param_set_long_name(stats_param, "stats-timer");
+	doca_argp_param_set_arguments(stats_param, "<time>");
+	doca_argp_param_set_description(stats_param, "Set interval to dump stats information");
+	doca_argp_param_set_callback(stats_param, stats_callback);
+	doca_argp_param_set_type(stats_param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(stats_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register queues number param */
+	result = doca_argp_param_create(&nr_queues_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_short_name(nr_queues_param, "q");
+	doca_argp_param_set_long_name(nr_queues_param, "nr-queues");
+	doca_argp_param_set_arguments(nr_queues_param, "<num>");
 	doca_argp_param_set_description(nr_queues_param, "Set queues number");
 	doca_argp_param_set_callback(nr_queues_param, nr_queues_callback);
 	doca_argp_param_set_type(nr_queues_param, DOCA_ARGP_TYPE_INT);
@@ -421,69 +1932,566 @@ doca_error_t register_simple_fwd_params(void)
 		return result;
 	}
 
-	/* Create and register RX only param */
-	result = doca_argp_param_create(&rx_only_param);
+	/* Create and register RX only param */
+	result = doca_argp_param_create(&rx_only_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_short_name(rx_only_param, "r");
+	doca_argp_param_set_long_name(rx_only_param, "rx-only");
+	doca_argp_param_set_description(rx_only_param, "Set rx only");
+	doca_argp_param_set_callback(rx_only_param, rx_only_callback);
+	doca_argp_param_set_type(rx_only_param, DOCA_ARGP_TYPE_BOOLEAN);
+	result = doca_argp_register_param(rx_only_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register HW offload param */
+	result = doca_argp_param_create(&hw_offload_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_short_name(hw_offload_param, "o");
+	doca_argp_param_set_long_name(hw_offload_param, "hw-offload");
+	doca_argp_param_set_description(hw_offload_param, "Set PCI address of the RXP engine to use");
+	doca_argp_param_set_callback(hw_offload_param, hw_offload_callback);
+	doca_argp_param_set_type(hw_offload_param, DOCA_ARGP_TYPE_BOOLEAN);
+	result = doca_argp_register_param(hw_offload_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register hairpin queue param */
+	result = doca_argp_param_create(&hairpinq_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_short_name(hairpinq_param, "hq");
+	doca_argp_param_set_long_name(hairpinq_param, "hairpinq");
+	doca_argp_param_set_description(hairpinq_param, "Set forwarding to hairpin queue");
+	doca_argp_param_set_callback(hairpinq_param, hairpinq_callback);
+	doca_argp_param_set_type(hairpinq_param, DOCA_ARGP_TYPE_BOOLEAN);
+	result = doca_argp_register_param(hairpinq_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register age thread param */
+	result = doca_argp_param_create(&age_thread_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_short_name(age_thread_param, "a");
+	doca_argp_param_set_long_name(age_thread_param, "age-thread");
+	doca_argp_param_set_description(age_thread_param, "Start thread do aging");
+	doca_argp_param_set_callback(age_thread_param, age_thread_callback);
+	doca_argp_param_set_type(age_thread_param, DOCA_ARGP_TYPE_BOOLEAN);
+	result = doca_argp_register_param(age_thread_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register parse level param */
+	result = doca_argp_param_create(&parse_level_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_short_name(parse_level_param, "p");
+	doca_argp_param_set_long_name(parse_level_param, "parse-level");
+	doca_argp_param_set_arguments(parse_level_param, "<level>");
+	doca_argp_param_set_description(parse_level_param,
+					"Set minimal RX parse depth: l2, dscp, 5tuple or tunnel (deeper levels are used when needed)");
+	doca_argp_param_set_callback(parse_level_param, parse_level_callback);
+	doca_argp_param_set_type(parse_level_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(parse_level_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register IPv4 reassembly param */
+	result = doca_argp_param_create(&frag_reassembly_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_short_name(frag_reassembly_param, "f");
+	doca_argp_param_set_long_name(frag_reassembly_param, "frag-reassembly");
+	doca_argp_param_set_description(frag_reassembly_param, "Reassemble IPv4 fragments before classification");
+	doca_argp_param_set_callback(frag_reassembly_param, frag_reassembly_callback);
+	doca_argp_param_set_type(frag_reassembly_param, DOCA_ARGP_TYPE_BOOLEAN);
+	result = doca_argp_register_param(frag_reassembly_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register QoS rings sync mode param */
+	result = doca_argp_param_create(&ring_sync_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(ring_sync_param, "ring-sync");
+	doca_argp_param_set_arguments(ring_sync_param, "<mode>");
+	doca_argp_param_set_description(ring_sync_param, "Set QoS rings sync mode: auto, mt, rts or hts");
+	doca_argp_param_set_callback(ring_sync_param, ring_sync_callback);
+	doca_argp_param_set_type(ring_sync_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(ring_sync_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register QoS source param */
+	result = doca_argp_param_create(&qos_source_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(qos_source_param, "qos-source");
+	doca_argp_param_set_arguments(qos_source_param, "<source>");
+	doca_argp_param_set_description(qos_source_param, "Set the field packets are classified on: dscp, pcp or inner-dscp");
+	doca_argp_param_set_callback(qos_source_param, qos_source_callback);
+	doca_argp_param_set_type(qos_source_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(qos_source_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register DSCP map param */
+	result = doca_argp_param_create(&dscp_map_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(dscp_map_param, "dscp-map");
+	doca_argp_param_set_arguments(dscp_map_param, "<dscp:class,...>");
+	doca_argp_param_set_description(dscp_map_param, "Map DSCP values to traffic classes, others use DSCP >> 3");
+	doca_argp_param_set_callback(dscp_map_param, dscp_map_callback);
+	doca_argp_param_set_type(dscp_map_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(dscp_map_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register PCP map param */
+	result = doca_argp_param_create(&pcp_map_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(pcp_map_param, "pcp-map");
+	doca_argp_param_set_arguments(pcp_map_param, "<pcp:class,...>");
+	doca_argp_param_set_description(pcp_map_param, "Map VLAN PCP values to traffic classes, others are used as is");
+	doca_argp_param_set_callback(pcp_map_param, pcp_map_callback);
+	doca_argp_param_set_type(pcp_map_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(pcp_map_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register scheduling mode param */
+	result = doca_argp_param_create(&sched_mode_param);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
 		return result;
 	}
-	doca_argp_param_set_short_name(rx_only_param, "r");
-	doca_argp_param_set_long_name(rx_only_param, "rx-only");
-	doca_argp_param_set_description(rx_only_param, "Set rx only");
-	doca_argp_param_set_callback(rx_only_param, rx_only_callback);
-	doca_argp_param_set_type(rx_only_param, DOCA_ARGP_TYPE_BOOLEAN);
-	result = doca_argp_register_param(rx_only_param);
+	doca_argp_param_set_long_name(sched_mode_param, "sched-mode");
+	doca_argp_param_set_arguments(sched_mode_param, "<mode>");
+	doca_argp_param_set_description(sched_mode_param, "Set TX scheduling of the weighted classes: strict, drr or wfq");
+	doca_argp_param_set_callback(sched_mode_param, sched_mode_callback);
+	doca_argp_param_set_type(sched_mode_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(sched_mode_param);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
 		return result;
 	}
 
-	/* Create and register HW offload param */
-	result = doca_argp_param_create(&hw_offload_param);
+	/* Create and register strict priority classes param */
+	result = doca_argp_param_create(&sched_strict_classes_param);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
 		return result;
 	}
-	doca_argp_param_set_short_name(hw_offload_param, "o");
-	doca_argp_param_set_long_name(hw_offload_param, "hw-offload");
-	doca_argp_param_set_description(hw_offload_param, "Set PCI address of the RXP engine to use");
-	doca_argp_param_set_callback(hw_offload_param, hw_offload_callback);
-	doca_argp_param_set_type(hw_offload_param, DOCA_ARGP_TYPE_BOOLEAN);
-	result = doca_argp_register_param(hw_offload_param);
+	doca_argp_param_set_long_name(sched_strict_classes_param, "sched-strict-classes");
+	doca_argp_param_set_arguments(sched_strict_classes_param, "<num>");
+	doca_argp_param_set_description(sched_strict_classes_param,
+					"Set number of highest classes served in strict priority before the weighted ones");
+	doca_argp_param_set_callback(sched_strict_classes_param, sched_strict_classes_callback);
+	doca_argp_param_set_type(sched_strict_classes_param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(sched_strict_classes_param);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
 		return result;
 	}
 
-	/* Create and register hairpin queue param */
-	result = doca_argp_param_create(&hairpinq_param);
+	/* Create and register class weights param */
+	result = doca_argp_param_create(&sched_weights_param);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
 		return result;
 	}
-	doca_argp_param_set_short_name(hairpinq_param, "hq");
-	doca_argp_param_set_long_name(hairpinq_param, "hairpinq");
-	doca_argp_param_set_description(hairpinq_param, "Set forwarding to hairpin queue");
-	doca_argp_param_set_callback(hairpinq_param, hairpinq_callback);
-	doca_argp_param_set_type(hairpinq_param, DOCA_ARGP_TYPE_BOOLEAN);
-	result = doca_argp_register_param(hairpinq_param);
+	doca_argp_param_set_long_name(sched_weights_param, "sched-weights");
+	doca_argp_param_set_arguments(sched_weights_param, "<class:weight,...[;...]>");
+	doca_argp_param_set_description(sched_weights_param,
+					"Set class weights for all ports, or per port separated by ';', others weigh 1");
+	doca_argp_param_set_callback(sched_weights_param, sched_weights_callback);
+	doca_argp_param_set_type(sched_weights_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(sched_weights_param);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
 		return result;
 	}
 
-	/* Create and register age thread param */
-	result = doca_argp_param_create(&age_thread_param);
+	/* Create and register class rates param */
+	result = doca_argp_param_create(&sched_rates_param);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
 		return result;
 	}
-	doca_argp_param_set_short_name(age_thread_param, "a");
-	doca_argp_param_set_long_name(age_thread_param, "age-thread");
-	doca_argp_param_set_description(age_thread_param, "Start thread do aging");
-	doca_argp_param_set_callback(age_thread_param, age_thread_callback);
-	doca_argp_param_set_type(age_thread_param, DOCA_ARGP_TYPE_BOOLEAN);
-	result = doca_argp_register_param(age_thread_param);
+	doca_argp_param_set_long_name(sched_rates_param, "sched-rates");
+	doca_argp_param_set_arguments(sched_rates_param, "<class:cir[:pir],...[;...]>");
+	doca_argp_param_set_description(sched_rates_param,
+					"Shape classes to a committed and peak rate in Mbps, for all ports or per port separated by ';'");
+	doca_argp_param_set_callback(sched_rates_param, sched_rates_callback);
+	doca_argp_param_set_type(sched_rates_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(sched_rates_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register drop policy param */
+	result = doca_argp_param_create(&drop_policy_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(drop_policy_param, "drop-policy");
+	doca_argp_param_set_arguments(drop_policy_param, "<policy|class:policy,...>");
+	doca_argp_param_set_description(drop_policy_param, "Set full rings drop policy: tail, head, red or codel");
+	doca_argp_param_set_callback(drop_policy_param, drop_policy_callback);
+	doca_argp_param_set_type(drop_policy_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(drop_policy_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register RED param */
+	result = doca_argp_param_create(&red_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(red_param, "red");
+	doca_argp_param_set_arguments(red_param, "<min:max:max_p>");
+	doca_argp_param_set_description(red_param, "Set RED ring occupancy thresholds and max drop probability, in percents");
+	doca_argp_param_set_callback(red_param, red_callback);
+	doca_argp_param_set_type(red_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(red_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register CoDel param */
+	result = doca_argp_param_create(&codel_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(codel_param, "codel");
+	doca_argp_param_set_arguments(codel_param, "<target:interval>");
+	doca_argp_param_set_description(codel_param, "Set CoDel sojourn time target and interval, in microseconds");
+	doca_argp_param_set_callback(codel_param, codel_callback);
+	doca_argp_param_set_type(codel_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(codel_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register run to completion classes param */
+	result = doca_argp_param_create(&rtc_classes_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(rtc_classes_param, "rtc-classes");
+	doca_argp_param_set_arguments(rtc_classes_param, "<class,...>");
+	doca_argp_param_set_description(rtc_classes_param,
+					"Set classes sent by the RX lcores directly, skipping the QoS rings and scheduling");
+	doca_argp_param_set_callback(rtc_classes_param, rtc_classes_callback);
+	doca_argp_param_set_type(rtc_classes_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(rtc_classes_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register minimal TX burst param */
+	result = doca_argp_param_create(&tx_min_burst_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(tx_min_burst_param, "tx-min-burst");
+	doca_argp_param_set_arguments(tx_min_burst_param, "<num>");
+	doca_argp_param_set_description(tx_min_burst_param, "Set number of packets buffered before sending a TX burst");
+	doca_argp_param_set_callback(tx_min_burst_param, tx_min_burst_callback);
+	doca_argp_param_set_type(tx_min_burst_param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(tx_min_burst_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register TX flush deadline param */
+	result = doca_argp_param_create(&tx_flush_us_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(tx_flush_us_param, "tx-flush-us");
+	doca_argp_param_set_arguments(tx_flush_us_param, "<usec>");
+	doca_argp_param_set_description(tx_flush_us_param, "Set maximal time a packet waits for a TX burst to fill");
+	doca_argp_param_set_callback(tx_flush_us_param, tx_flush_us_callback);
+	doca_argp_param_set_type(tx_flush_us_param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(tx_flush_us_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register TX flushed classes param */
+	result = doca_argp_param_create(&tx_flush_classes_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(tx_flush_classes_param, "tx-flush-classes");
+	doca_argp_param_set_arguments(tx_flush_classes_param, "<class,...>");
+	doca_argp_param_set_description(tx_flush_classes_param, "Set classes sent right away, without waiting for a TX burst to fill");
+	doca_argp_param_set_callback(tx_flush_classes_param, tx_flush_classes_callback);
+	doca_argp_param_set_type(tx_flush_classes_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(tx_flush_classes_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register idle back-off threshold param */
+	result = doca_argp_param_create(&idle_polls_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(idle_polls_param, "idle-polls");
+	doca_argp_param_set_arguments(idle_polls_param, "<num>");
+	doca_argp_param_set_description(idle_polls_param, "Set number of empty polls before an lcore backs off, 0 to always busy poll");
+	doca_argp_param_set_callback(idle_polls_param, idle_polls_callback);
+	doca_argp_param_set_type(idle_polls_param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(idle_polls_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register idle back-off sleep param */
+	result = doca_argp_param_create(&idle_sleep_us_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(idle_sleep_us_param, "idle-sleep-us");
+	doca_argp_param_set_arguments(idle_sleep_us_param, "<usec>");
+	doca_argp_param_set_description(idle_sleep_us_param, "Set maximal sleep of an idle lcore, bounding its wake-up latency, 0 to only pause");
+	doca_argp_param_set_callback(idle_sleep_us_param, idle_sleep_us_callback);
+	doca_argp_param_set_type(idle_sleep_us_param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(idle_sleep_us_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register RX lcores param */
+	result = doca_argp_param_create(&rx_lcores_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(rx_lcores_param, "rx-lcores");
+	doca_argp_param_set_arguments(rx_lcores_param, "<lcore,...>");
+	doca_argp_param_set_description(rx_lcores_param, "Set RX lcores, one per queue, default is one per queue from the first worker");
+	doca_argp_param_set_callback(rx_lcores_param, rx_lcores_callback);
+	doca_argp_param_set_type(rx_lcores_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(rx_lcores_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register TX lcores param */
+	result = doca_argp_param_create(&tx_lcores_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(tx_lcores_param, "tx-lcores");
+	doca_argp_param_set_arguments(tx_lcores_param, "<lcore,...>");
+	doca_argp_param_set_description(tx_lcores_param, "Set TX lcores, default is all the workers left");
+	doca_argp_param_set_callback(tx_lcores_param, tx_lcores_callback);
+	doca_argp_param_set_type(tx_lcores_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(tx_lcores_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register rate limiter lcore param */
+	result = doca_argp_param_create(&rate_limiter_lcore_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(rate_limiter_lcore_param, "rate-limiter-lcore");
+	doca_argp_param_set_arguments(rate_limiter_lcore_param, "<lcore>");
+	doca_argp_param_set_description(rate_limiter_lcore_param, "Set rate limiter lcore, needed to shape classes at runtime over telemetry, default is the next worker left when classes are shaped at startup");
+	doca_argp_param_set_callback(rate_limiter_lcore_param, rate_limiter_lcore_callback);
+	doca_argp_param_set_type(rate_limiter_lcore_param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(rate_limiter_lcore_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register strict NUMA param */
+	result = doca_argp_param_create(&numa_strict_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(numa_strict_param, "numa-strict");
+	doca_argp_param_set_description(numa_strict_param, "Fail when an lcore is on another NUMA node than the ports, instead of warning");
+	doca_argp_param_set_callback(numa_strict_param, numa_strict_callback);
+	doca_argp_param_set_type(numa_strict_param, DOCA_ARGP_TYPE_BOOLEAN);
+	result = doca_argp_register_param(numa_strict_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register RSS rebalancing period param */
+	result = doca_argp_param_create(&rebalance_ms_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(rebalance_ms_param, "rebalance-ms");
+	doca_argp_param_set_arguments(rebalance_ms_param, "<msec>");
+	doca_argp_param_set_description(rebalance_ms_param, "Set time between two RX queues load samples moving RSS buckets, 0 to never rebalance");
+	doca_argp_param_set_callback(rebalance_ms_param, rebalance_ms_callback);
+	doca_argp_param_set_type(rebalance_ms_param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(rebalance_ms_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register RSS rebalancing threshold param */
+	result = doca_argp_param_create(&rebalance_threshold_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(rebalance_threshold_param, "rebalance-threshold");
+	doca_argp_param_set_arguments(rebalance_threshold_param, "<percent>");
+	doca_argp_param_set_description(rebalance_threshold_param, "Set load gap between the busiest and idlest RX queues moving a bucket, in percents of the average");
+	doca_argp_param_set_callback(rebalance_threshold_param, rebalance_threshold_callback);
+	doca_argp_param_set_type(rebalance_threshold_param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(rebalance_threshold_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register latency sampling param */
+	result = doca_argp_param_create(&latency_sample_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(latency_sample_param, "latency-sample");
+	doca_argp_param_set_arguments(latency_sample_param, "<num>");
+	doca_argp_param_set_description(latency_sample_param, "Set latency sampling, one packet in num is timed, default is 64, 1 for every packet, 0 for none");
+	doca_argp_param_set_callback(latency_sample_param, latency_sample_callback);
+	doca_argp_param_set_type(latency_sample_param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(latency_sample_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register latency trace file param */
+	result = doca_argp_param_create(&latency_trace_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(latency_trace_param, "latency-trace");
+	doca_argp_param_set_arguments(latency_trace_param, "<path>");
+	doca_argp_param_set_description(latency_trace_param, "Set binary trace file of the timed packets, decoded offline by simple_fwd_trace_decode, empty for none");
+	doca_argp_param_set_callback(latency_trace_param, latency_trace_callback);
+	doca_argp_param_set_type(latency_trace_param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(latency_trace_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register latency trace records param */
+	result = doca_argp_param_create(&latency_trace_records_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(latency_trace_records_param, "latency-trace-records");
+	doca_argp_param_set_arguments(latency_trace_records_param, "<num>");
+	doca_argp_param_set_description(latency_trace_records_param, "Set records kept per lcore in the latency trace, the latest ones, a power of 2");
+	doca_argp_param_set_callback(latency_trace_records_param, latency_trace_records_callback);
+	doca_argp_param_set_type(latency_trace_records_param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(latency_trace_records_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	/* Create and register hardware timestamp param */
+	result = doca_argp_param_create(&hw_timestamp_param);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create ARGP param: %s", doca_error_get_descr(result));
+		return result;
+	}
+	doca_argp_param_set_long_name(hw_timestamp_param, "hw-timestamp");
+	doca_argp_param_set_description(hw_timestamp_param, "Set timing of the packets from their NIC RX timestamp, on the ports supporting it");
+	doca_argp_param_set_callback(hw_timestamp_param, hw_timestamp_callback);
+	doca_argp_param_set_type(hw_timestamp_param, DOCA_ARGP_TYPE_BOOLEAN);
+	result = doca_argp_register_param(hw_timestamp_param);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to register program param: %s", doca_error_get_descr(result));
 		return result;
@@ -498,28 +2506,185 @@ doca_error_t register_simple_fwd_params(void)
 	return DOCA_SUCCESS;
 }
 
-void simple_fwd_map_queue(uint16_t nb_queues, uint16_t nb_tx)
+/*
+ * Gives a role to an lcore, which has to be an enabled worker without a role yet
+ *
+ * @lcore_id [in]: lcore identifier
+ * @role [in]: role of the lcore
+ * @return: 0 on success and negative value otherwise
+ */
+static int vnf_lcore_claim(unsigned int lcore_id, int role)
+{
+	if (lcore_id >= RTE_MAX_LCORE || !rte_lcore_is_enabled(lcore_id) || lcore_id == rte_get_main_lcore()) {
+		DOCA_LOG_ERR("Lcore %u is not an enabled worker lcore", lcore_id);
+		return -1;
+	}
+	if (core_params_arr[lcore_id].used != IDLE) {
+		DOCA_LOG_ERR("Lcore %u is given more than one role", lcore_id);
+		return -1;
+	}
+	core_params_arr[lcore_id].used = role;
+	return 0;
+}
+
+/*
+ * Gives a role to the next free worker lcores
+ *
+ * @lcores [out]: lcores given the role
+ * @nb_lcores [in]: maximal number of lcores to give the role to, 0 for all the free ones
+ * @role [in]: role of the lcores
+ * @return: number of lcores given the role
+ */
+static uint16_t vnf_lcore_claim_free(uint16_t *lcores, uint16_t nb_lcores, int role)
 {
+	unsigned int lcore_id;
+	uint16_t n = 0;
 
-	int i;
-	memset(core_params_arr, 0, sizeof(core_params_arr));
-	for (i = 1; i <= nb_queues; i++) {
-        int queue_idx = i % nb_queues;
-		if (!rte_lcore_is_enabled(i))
+	RTE_LCORE_FOREACH_WORKER(lcore_id) {
+		if (nb_lcores != 0 && n == nb_lcores)
+			break;
+		if (core_params_arr[lcore_id].used != IDLE)
 			continue;
-		core_params_arr[i].ports[0] = 0;
-		core_params_arr[i].ports[1] = 1;
-		core_params_arr[i].queues[0] = queue_idx;
-		core_params_arr[i].queues[1] = queue_idx;
-		core_params_arr[i].used = RX;
+		core_params_arr[lcore_id].used = role;
+		lcores[n++] = lcore_id;
 	}
+	return n;
+}
 
-    for (i = nb_queues + 1; i <= nb_queues + nb_tx; i++) {
-        if (!rte_lcore_is_enabled(i))
-            continue;
-        core_params_arr[i].used = TX;
-    }
+/*
+ * Checks that an lcore is on the NUMA node of the ports it polls and sends to
+ *
+ * @lcore_id [in]: lcore identifier
+ * @strict [in]: whether or not a remote lcore is an error
+ * @return: 0 on success and negative value otherwise
+ */
+static int vnf_lcore_check_numa(unsigned int lcore_id, bool strict)
+{
+	int port_id, socket_id;
+
+	for (port_id = 0; port_id < NUM_OF_PORTS; port_id++) {
+		socket_id = rte_eth_dev_socket_id(port_id);
+		if (socket_id < 0 || socket_id == (int)rte_lcore_to_socket_id(lcore_id))
+			continue;
+		if (strict) {
+			DOCA_LOG_ERR("Lcore %u is on socket %u, remote to port %d on socket %d", lcore_id,
+				     rte_lcore_to_socket_id(lcore_id), port_id, socket_id);
+			return -1;
+		}
+		DOCA_LOG_WARN("Lcore %u is on socket %u, remote to port %d on socket %d, performance will not be optimal",
+			      lcore_id, rte_lcore_to_socket_id(lcore_id), port_id, socket_id);
+	}
+	return 0;
+}
+
+int simple_fwd_map_queue(uint16_t nb_queues, const struct simple_fwd_topology *topo, bool rate_limiter, bool rtc)
+{
+	uint16_t rx_lcores[RTE_MAX_LCORE], tx_lcores[RTE_MAX_LCORE];
+	uint16_t nb_rx = topo->nb_rx, nb_tx = topo->nb_tx;
+	int rate_limiter_lcore = topo->rate_limiter;
+	uint16_t rl_lcore;
+	int i, j;
+
+	memset(core_params_arr, 0, sizeof(core_params_arr));
+	memset(tx_queues_arr, 0, sizeof(tx_queues_arr));
+	if (rate_limiter_lcore >= 0)
+		rate_limiter = true;
+
+	/* explicit roles first, the defaulted ones only take the lcores left */
+	memcpy(rx_lcores, topo->rx, nb_rx * sizeof(rx_lcores[0]));
+	memcpy(tx_lcores, topo->tx, nb_tx * sizeof(tx_lcores[0]));
+	for (i = 0; i < nb_rx; i++) {
+		if (vnf_lcore_claim(rx_lcores[i], RX) != 0)
+			return -1;
+	}
+	for (i = 0; i < nb_tx; i++) {
+		if (vnf_lcore_claim(tx_lcores[i], TX) != 0)
+			return -1;
+	}
+	if (rate_limiter && rate_limiter_lcore >= 0 && vnf_lcore_claim(rate_limiter_lcore, RATE_LIMITER) != 0)
+		return -1;
+	if (nb_rx == 0)
+		nb_rx = vnf_lcore_claim_free(rx_lcores, nb_queues, RX);
+	if (nb_tx == 0) {
+		nb_tx = vnf_lcore_claim_free(tx_lcores, 0, TX);
+		/* the last free worker goes to the rate limiter rather than to the TX lcores */
+		if (rate_limiter && rate_limiter_lcore < 0 && nb_tx > 1) {
+			rate_limiter_lcore = tx_lcores[--nb_tx];
+			core_params_arr[rate_limiter_lcore].used = RATE_LIMITER;
+		}
+	}
+	if (rate_limiter && rate_limiter_lcore < 0) {
+		if (vnf_lcore_claim_free(&rl_lcore, 1, RATE_LIMITER) == 0) {
+			DOCA_LOG_ERR("Classes are shaped but no lcore is left for the rate limiter");
+			return -1;
+		}
+		rate_limiter_lcore = rl_lcore;
+	}
+
+	if (nb_queues > SIMPLE_FWD_RSS_MAX_QUEUES) {
+		DOCA_LOG_ERR("Invalid number of queues %u, should be at most %d", nb_queues, SIMPLE_FWD_RSS_MAX_QUEUES);
+		return -1;
+	}
+	if (nb_rx == 0 || nb_rx > nb_queues) {
+		DOCA_LOG_ERR("Invalid number of RX lcores %u, should be in [1, %u]", nb_rx, nb_queues);
+		return -1;
+	}
+	if (nb_rx < nb_queues)
+		DOCA_LOG_WARN("Only %u RX lcores for %u queues, queues %u to %u are not polled", nb_rx, nb_queues, nb_rx,
+			      nb_queues - 1);
+	if (nb_tx == 0) {
+		DOCA_LOG_ERR("No lcore is left for TX");
+		return -1;
+	}
 
+	rx_polled_mask = 0;
+	for (i = 0; i < nb_rx; i++) {
+		if (vnf_lcore_check_numa(rx_lcores[i], topo->numa_strict) != 0)
+			return -1;
+		rx_polled_mask |= 1ULL << i;
+		core_params_arr[rx_lcores[i]].ports[0] = 0;
+		core_params_arr[rx_lcores[i]].ports[1] = 1;
+		core_params_arr[rx_lcores[i]].queues[0] = i;
+		core_params_arr[rx_lcores[i]].queues[1] = i;
+		/* run to completion lcores send on the TX queue matching their RX queue */
+		if (rtc)
+			vnf_tx_queue_use(rx_lcores[i], i);
+		DOCA_LOG_INFO("Core %u polls RX queue %d", rx_lcores[i], i);
+	}
+
+	/* each TX lcore has a home rings set, shared only when TX lcores outnumber MAX_TX_SHARDS */
+	nb_tx_shards = RTE_MIN(nb_tx, MAX_TX_SHARDS);
+	memset(tx_shards, 0, sizeof(tx_shards));
+	tx_steal = nb_tx_shards > 1 && nb_tx == nb_tx_shards;
+
+	/* TX lcores are spread over the TX queues, a queue is only shared when lcores outnumber queues */
+	for (i = 0; i < nb_tx; i++) {
+		int tx_queue_idx = i % nb_queues;
+
+		if (vnf_lcore_check_numa(tx_lcores[i], topo->numa_strict) != 0)
+			return -1;
+		core_params_arr[tx_lcores[i]].tx_shard = i % nb_tx_shards;
+		vnf_tx_queue_use(tx_lcores[i], tx_queue_idx);
+		/* lcores helping a shard send on its home TX queues, behind the packets the home lcore sent */
+		if (i < nb_tx_shards) {
+			for (j = 0; j < NUM_OF_PORTS; j++)
+				tx_shards[i].tx_queues[j] = tx_queue_idx;
+		}
+		DOCA_LOG_INFO("Core %u sends on TX queue %d, home shard %d", tx_lcores[i], tx_queue_idx,
+			      core_params_arr[tx_lcores[i]].tx_shard);
+	}
+	for (i = 0; i < nb_queues; i++) {
+		if (tx_queues_arr[0][i].shared)
+			DOCA_LOG_WARN("TX queue %d is shared by %u lcores, sends on it are serialized", i,
+				      tx_queues_arr[0][i].nb_users);
+	}
+
+	if (rate_limiter) {
+		if (vnf_lcore_check_numa(rate_limiter_lcore, topo->numa_strict) != 0)
+			return -1;
+		DOCA_LOG_INFO("Core %d refills the shapers", rate_limiter_lcore);
+	}
+	return 0;
 }
 
 void simple_fwd_destroy(struct app_vnf *vnf)
@@ -528,21 +2693,59 @@ void simple_fwd_destroy(struct app_vnf *vnf)
 }
 
 
-int init_ring_buffers(struct rte_ring *rx_ring_buffers[NUM_OF_PORTS][NUM_QOS_LEVELS]) {
-    for(int p = 0; p < NUM_OF_PORTS; p++) {
-        for (int i = 0; i < NUM_QOS_LEVELS; i++) {
-            char ring_name[32];
-            snprintf(ring_name, sizeof(ring_name), "rx_ring_p%d_q%d", p, i);
-
-            rx_ring_buffers[p][i] = rte_ring_create(
-                    ring_name,
-                    1024,
-                    rte_socket_id(),
-                    0  // MP/MC 模式
-            );
+/*
+ * Selects the QoS rings flags from the configured synchronization mode and the lcores topology.
+ * RX lcores are the producers, TX lcores the consumers, and RX lcores also dequeue when dropping
+ * from the head of a full ring and idle TX lcores steal from other shards, so the consumer side is
+ * always multi consumer.
+ *
+ * @app_config [in]: application configuration
+ * @return: flags to create the rings with
+ */
+static unsigned int vnf_ring_flags(struct simple_fwd_config *app_config)
+{
+	unsigned int nb_rx = 0;
+	unsigned int i;
+
+	switch (app_config->ring_sync) {
+	case SIMPLE_FWD_RING_SYNC_RTS:
+		return RING_F_MP_RTS_ENQ | RING_F_MC_RTS_DEQ;
+	case SIMPLE_FWD_RING_SYNC_HTS:
+		return RING_F_MP_HTS_ENQ | RING_F_MC_HTS_DEQ;
+	case SIMPLE_FWD_RING_SYNC_MT:
+		return 0;
+	default:
+		break;
+	}
+	for (i = 0; i < RTE_MAX_LCORE; i++) {
+		if (core_params_arr[i].used == RX)
+			nb_rx++;
+	}
+	return nb_rx == 1 ? RING_F_SP_ENQ : 0;
+}
 
-            if (rx_ring_buffers[p][i] == NULL) {
-                rte_exit(EXIT_FAILURE, "Failed to create ring %d: %s\n", i, rte_strerror(rte_errno));
+int init_ring_buffers(struct rte_ring *rx_ring_buffers[MAX_TX_SHARDS][NUM_OF_PORTS][NUM_QOS_LEVELS],
+                      struct simple_fwd_config *app_config) {
+    unsigned int flags = vnf_ring_flags(app_config);
+
+    DOCA_LOG_INFO("QoS rings flags 0x%x, %u shards", flags, nb_tx_shards);
+    for (int s = 0; s < nb_tx_shards; s++) {
+        for(int p = 0; p < NUM_OF_PORTS; p++) {
+            for (int i = 0; i < NUM_QOS_LEVELS; i++) {
+                char ring_name[32];
+                snprintf(ring_name, sizeof(ring_name), "rx_ring_s%d_p%d_q%d", s, p, i);
+
+                /* the rings of a port are written by its RX lcores, keep them on its node */
+                rx_ring_buffers[s][p][i] = rte_ring_create(
+                        ring_name,
+                        1024,
+                        rte_eth_dev_socket_id(p) < 0 ? (int)rte_socket_id() : rte_eth_dev_socket_id(p),
+                        flags
+                );
+
+                if (rx_ring_buffers[s][p][i] == NULL) {
+                    rte_exit(EXIT_FAILURE, "Failed to create ring %d: %s\n", i, rte_strerror(rte_errno));
+                }
             }
         }
     }
@@ -26,11 +26,34 @@
 #ifndef SIMPLE_FWD_VNF_CORE_H_
 #define SIMPLE_FWD_VNF_CORE_H_
 
+#include <limits.h>
+
 #include <dpdk_utils.h>
 
 #include "app_vnf.h"
+#include "simple_fwd_pkt.h"
+#include "simple_fwd_qos.h"
+
+#define NUM_QOS_LEVELS SIMPLE_FWD_QOS_NB_TC
+#define MAX_TX_SHARDS 8 /* Maximum number of QoS ring sets, each one served by its home TX lcores */
+
+/* Synchronization mode of the producers and consumers of the QoS rings */
+enum simple_fwd_ring_sync {
+	SIMPLE_FWD_RING_SYNC_AUTO, /* Single producer when one RX lcore feeds the rings, MT otherwise */
+	SIMPLE_FWD_RING_SYNC_MT,   /* Multi producer/consumer with CAS on the head */
+	SIMPLE_FWD_RING_SYNC_RTS,  /* Relaxed tail sync, for lcores that may be preempted */
+	SIMPLE_FWD_RING_SYNC_HTS,  /* Head/tail sync, fully serialized producers and consumers */
+};
 
-#define NUM_QOS_LEVELS 8
+/* Roles of the lcores, a role left empty is given the next free worker lcores */
+struct simple_fwd_topology {
+	uint16_t nb_rx;		    /* Number of RX lcores, 0 for one per queue from the first free worker */
+	uint16_t rx[RTE_MAX_LCORE]; /* RX lcores, each one polls the queue of its index on every port */
+	uint16_t nb_tx;		    /* Number of TX lcores, 0 for all the remaining free workers */
+	uint16_t tx[RTE_MAX_LCORE]; /* TX lcores, scheduling the QoS rings */
+	int rate_limiter;	    /* Rate limiter lcore, -1 for the next free worker */
+	bool numa_strict;	    /* Whether or not lcores remote to the ports fail the mapping */
+};
 
 /* Simple FWD VNF application configuration */
 struct simple_fwd_config {
@@ -41,6 +64,22 @@ struct simple_fwd_config {
 	uint64_t stats_timer; /* The time between periodic stats prints */
 	bool is_hairpin;      /* Number of hairpin queues */
 	bool age_thread;      /* Whther or not to use a dedicated thread to handle aged flows */
+	enum simple_fwd_parse_level parse_level; /* Minimal RX parse depth, raised by the stages in use */
+	bool frag_reassembly;			 /* Whether or not to reassemble IPv4 fragments on the RX lcores */
+	enum simple_fwd_ring_sync ring_sync;	 /* Synchronization mode of the QoS rings */
+	struct simple_fwd_qos_cfg qos;		 /* Traffic classification of the received packets */
+	uint32_t rtc_classes;			 /* Classes sent by the RX lcores, bypassing the rings and TX lcores */
+	uint16_t tx_min_burst;			 /* Packets buffered by a TX lcore before sending them */
+	uint32_t tx_flush_us;			 /* Maximal time a packet waits for a TX burst to fill */
+	uint32_t idle_polls;			 /* Empty polls before an lcore backs off, 0 to always busy poll */
+	uint32_t idle_sleep_us;			 /* Maximal back-off sleep, bounding the wake-up latency */
+	struct simple_fwd_topology topology;	 /* Roles of the lcores */
+	uint32_t rebalance_ms;			 /* Time between two RX queues load samples, 0 to never rebalance */
+	uint32_t rebalance_threshold;		 /* Load gap moving an RSS bucket, percents of the average */
+	uint32_t latency_sample;		 /* One packet in latency_sample is timed, 0 for none */
+	bool hw_timestamp;			 /* Whether or not to time the packets from their NIC RX timestamp */
+	char latency_trace[PATH_MAX];		 /* Binary trace file of the timed packets, empty for none */
+	uint32_t latency_trace_records;		 /* Records kept per lcore in the trace, a power of 2 */
 };
 
 /* Simple FWD VNF parameters to be passed when starting processing packets */
@@ -57,6 +96,17 @@ struct simple_fwd_process_pkts_params {
  */
 doca_error_t register_simple_fwd_params(void);
 
+/*
+ * Prepares the datapath on the main lcore, once the lcores are mapped and before they are launched:
+ * registers the mbuf dynamic field, chains the stages of the RX pipeline and allocates the state of
+ * every lcore, so the lcores only look it up
+ *
+ * @app_config [in]: application configuration
+ * @vnf [in]: application adding its stages to the RX pipeline
+ * @return: 0 on success and negative value otherwise
+ */
+int simple_fwd_process_pkts_init(struct simple_fwd_config *app_config, struct app_vnf *vnf);
+
 /*
  * Process received packets, mainly retrieving packet's key, then checking if there is an entry found
  * matching the generated key, in the entries table.
@@ -76,11 +126,19 @@ int simple_fwd_process_pkts(void *process_pkts_params);
 void simple_fwd_process_pkts_stop(void);
 
 /*
- * Maps queues to cores/lcores and vice versa
+ * Maps queues to cores/lcores and vice versa, following the configured topology. RX lcores get one
+ * RX queue each, TX lcores are spread round robin over the TX queues, which are created as many as
+ * the RX ones, and over the TX shards. Lcores remote to the ports are reported, or rejected in
+ * strict NUMA mode.
  *
  * @nb_queues [in]: number of queues to map
+ * @topo [in]: roles of the lcores
+ * @rate_limiter [in]: whether or not classes are shaped at startup, a rate limiter lcore set in the
+ *                    topology is mapped anyway so that classes can be shaped at runtime
+ * @rtc [in]: whether or not the RX lcores send packets themselves, on the TX queue of their RX queue
+ * @return: 0 on success and negative value otherwise
  */
-void simple_fwd_map_queue(uint16_t nb_queues, uint16_t nb_tx);
+int simple_fwd_map_queue(uint16_t nb_queues, const struct simple_fwd_topology *topo, bool rate_limiter, bool rtc);
 
 /*
  * Destroys all allocated resources used by the application
@@ -89,6 +147,15 @@ void simple_fwd_map_queue(uint16_t nb_queues, uint16_t nb_tx);
  */
 void simple_fwd_destroy(struct app_vnf *vnf);
 
-int init_ring_buffers(struct rte_ring *rx_ring_buffers[NUM_OF_PORTS][NUM_QOS_LEVELS]);
+/*
+ * Creates the QoS rings, one set per TX shard, with a synchronization mode matching the lcores
+ * mapped by simple_fwd_map_queue(), which has to be called first
+ *
+ * @rx_ring_buffers [out]: the created rings, per shard, port and traffic class
+ * @app_config [in]: application configuration
+ * @return: 0 on success and negative value otherwise
+ */
+int init_ring_buffers(struct rte_ring *rx_ring_buffers[MAX_TX_SHARDS][NUM_OF_PORTS][NUM_QOS_LEVELS],
+		      struct simple_fwd_config *app_config);
 
 #endif /* SIMPLE_FWD_VNF_CORE_H_ */